@@ -0,0 +1,263 @@
+/* facility/src/batch.c */
+
+/* Batch mode: Reduce one expression per line of a file, spreading the lines
+ * over a pool of worker threads. Every worker has its own interpreter context
+ * (see context.h), and so its own heap; the workers share nothing except the
+ * queue of line numbers and the table of results, which the main thread
+ * prints in input order as soon as each result becomes available. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "batch.h"
+#include "beta-reduction.h"
+#include "parser.h"
+#include "printer.h"
+#include "task-scheduler.h"
+#include "trace.h"
+
+typedef struct {
+	char ** lines;
+	char ** results;
+	int numLines;
+	TASK_SCHEDULER * scheduler; /* For parallel reduction; may be NULL */
+	BOOL enableDeltaReduction;
+	int numGcThreads;
+	REDUCTION_LIMITS limits; /* For each line separately */
+	TRACE_RECORDER * trace; /* Shared by the workers; may be NULL */
+	LC_CONTEXT * statsCtx; /* Collects the workers' counts; may be NULL */
+	int nextLine; /* The next line to be claimed by a worker */
+	pthread_mutex_t mutex;
+	pthread_cond_t resultReady;
+} BATCH_JOB;
+
+char * readFile(char * filename) {
+	FILE * fp = fopen(filename, "rb");
+
+	if (fp == NULL) {
+		fprintf(stderr, "readFile() : Cannot open '%s'\n", filename);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+
+	const long size = ftell(fp);
+
+	if (size < 0) {
+		/* E.g. a pipe, which cannot seek */
+		fprintf(stderr, "readFile() : Cannot get the size of '%s'\n", filename);
+		fclose(fp);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_SET);
+
+	char * buf = (char *)malloc((size + 1) * sizeof(char));
+
+	if (buf == NULL) {
+		fprintf(stderr, "readFile() : Cannot allocate %ld bytes for '%s'\n", size + 1, filename);
+		fclose(fp);
+		return NULL;
+	}
+
+	if (fread(buf, sizeof(char), size, fp) != (size_t)size) {
+		fprintf(stderr, "readFile() : Error reading '%s'\n", filename);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+
+	buf[size] = '\0';
+	fclose(fp);
+
+	return buf;
+}
+
+int countLines(char * text) {
+	int n = 1;
+
+	for (; *text != '\0'; ++text) {
+
+		if (*text == '\n') {
+			++n;
+		}
+	}
+
+	return n;
+}
+
+int splitIntoLines(char * text, char ** lines) {
+	/* Replaces each line ending in text with a null character and records
+	the start of each line that is not blank. Returns the number of such lines. */
+	int n = 0;
+	char * line = text;
+
+	while (line != NULL && *line != '\0') {
+		char * eol = strchr(line, '\n');
+
+		if (eol != NULL) {
+			*eol = '\0';
+
+			if (eol > line && eol[-1] == '\r') {
+				eol[-1] = '\0';
+			}
+		}
+
+		if (line[strspn(line, " \t")] != '\0') {
+			lines[n++] = line;
+		}
+
+		line = (eol != NULL) ? eol + 1 : NULL;
+	}
+
+	return n;
+}
+
+static char * reduceLineToString(LC_CONTEXT * ctx, char * str, REDUCTION_LIMITS * limits) {
+	const int maxDepth = 50;
+	char * result = NULL;
+	size_t resultSize = 0;
+	ReductionStatus status = rsOK;
+	FILE * fp = open_memstream(&result, &resultSize);
+	LC_EXPR * parseTree = parse(ctx, str);
+
+	if (parseTree == NULL) {
+		fprintf(fp, "Error: Could not parse '%s'", str);
+	} else {
+		LC_EXPR * reducedExpr = betaReduceWithLimits(ctx, parseTree, maxDepth, brsDefault, limits, &status);
+
+		if (reducedExpr == NULL && status == rsCycleDetected) {
+			fprintf(fp, "Error: Diverges (cycle of length %d)", ctx->cycleLength);
+		} else if (reducedExpr == NULL) {
+			fprintf(fp, "Error: %s", getReductionStatusMessage(status));
+		} else {
+			fprintExpr(ctx, fp, reducedExpr);
+		}
+	}
+
+	fclose(fp);
+	freeAllStructs(ctx); /* Empty this worker's heap */
+
+	return result;
+}
+
+static void * batchWorker(void * arg) {
+	BATCH_JOB * job = (BATCH_JOB *)arg;
+	LC_CONTEXT * ctx = createContext();
+
+	ctx->scheduler = job->scheduler;
+	ctx->enableDeltaReduction = job->enableDeltaReduction;
+	ctx->numGcThreads = job->numGcThreads;
+	ctx->trace = job->trace;
+
+	for (;;) {
+		pthread_mutex_lock(&job->mutex);
+
+		const int i = job->nextLine++;
+
+		pthread_mutex_unlock(&job->mutex);
+
+		if (i >= job->numLines) {
+			break;
+		}
+
+		char * result = reduceLineToString(ctx, job->lines[i], &job->limits);
+
+		pthread_mutex_lock(&job->mutex);
+		job->results[i] = result;
+		pthread_cond_broadcast(&job->resultReady);
+		pthread_mutex_unlock(&job->mutex);
+	}
+
+	if (job->statsCtx != NULL) {
+		pthread_mutex_lock(&job->mutex);
+		mergeChildContext(job->statsCtx, ctx);
+		pthread_mutex_unlock(&job->mutex);
+	}
+
+	freeContext(ctx);
+
+	return NULL;
+}
+
+BOOL runBatch(char * filename, int numThreads, int numReductionThreads, int numGcThreads, BOOL enableDeltaReduction, REDUCTION_LIMITS * limits, TRACE_RECORDER * trace, LC_CONTEXT * statsCtx) {
+	char * text = readFile(filename);
+	int i;
+
+	if (text == NULL) {
+		return FALSE;
+	}
+
+	BATCH_JOB job;
+
+	job.lines = (char **)malloc(countLines(text) * sizeof(char *));
+	job.numLines = splitIntoLines(text, job.lines);
+	job.results = (char **)calloc(job.numLines + 1, sizeof(char *));
+	job.nextLine = 0;
+	job.scheduler = (numReductionThreads > 0) ? createTaskScheduler(numReductionThreads, (statsCtx != NULL) ? &statsCtx->taskSchedulerCounts : NULL) : NULL;
+	job.enableDeltaReduction = enableDeltaReduction;
+	job.numGcThreads = numGcThreads;
+	job.limits = *limits;
+	job.trace = trace;
+	job.statsCtx = statsCtx;
+	pthread_mutex_init(&job.mutex, NULL);
+	pthread_cond_init(&job.resultReady, NULL);
+
+	if (numThreads <= 0) {
+		numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	if (numThreads > job.numLines) {
+		numThreads = job.numLines;
+	}
+
+	pthread_t * threads = (pthread_t *)malloc((numThreads + 1) * sizeof(pthread_t));
+
+	for (i = 0; i < numThreads; ++i) {
+		pthread_create(&threads[i], NULL, batchWorker, &job);
+	}
+
+	/* Print the results in input order as they arrive */
+
+	for (i = 0; i < job.numLines; ++i) {
+		pthread_mutex_lock(&job.mutex);
+
+		while (job.results[i] == NULL) {
+			pthread_cond_wait(&job.resultReady, &job.mutex);
+		}
+
+		pthread_mutex_unlock(&job.mutex);
+
+		printf("%s\n", job.results[i]);
+		free(job.results[i]);
+		job.results[i] = NULL;
+	}
+
+	for (i = 0; i < numThreads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if (job.scheduler != NULL) {
+		freeTaskScheduler(job.scheduler);
+	}
+
+	pthread_cond_destroy(&job.resultReady);
+	pthread_mutex_destroy(&job.mutex);
+	free(threads);
+	free(job.results);
+	free(job.lines);
+	free(text);
+
+	return TRUE;
+}
+
+/* **** The End **** */
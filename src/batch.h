@@ -0,0 +1,8 @@
+/* facility/src/batch.h */
+
+char * readFile(char * filename);
+int countLines(char * text);
+int splitIntoLines(char * text, char ** lines);
+BOOL runBatch(char * filename, int numThreads, int numReductionThreads, int numGcThreads, BOOL enableDeltaReduction, REDUCTION_LIMITS * limits, struct TRACE_RECORDER_STRUCT * trace, LC_CONTEXT * statsCtx);
+
+/* **** The End **** */
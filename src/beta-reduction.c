@@ -3,92 +3,213 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 /* #include <ctype.h> */
 /* #include <assert.h> */
 
 #include "boolean.h"
 
 #include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 
 #include "beta-reduction.h"
 #include "string-set.h"
 #include "eta-reduction.h"
+#include "combinator.h"
+#include "explicit-substitution.h"
+#include "g-machine.h"
+#include "normalization-by-evaluation.h"
 #include "create-and-destroy.h"
+#include "delta-reduction.h"
+#include "interaction-net.h"
+#include "task-scheduler.h"
+#include "trace.h"
+
+/* Reading the clock costs more than a reduction step, so the time limit is
+checked only on every callsPerClockCheck'th call to betaReduce() */
+/* const int callsPerClockCheck = 1024; */
+#define callsPerClockCheck 1024
+
+typedef struct {
+	TASK task; /* Must be the first member */
+	LC_CONTEXT ctx; /* The task allocates from the heap of this child context */
+	LC_EXPR * expr;
+	int maxDepth;
+	BetaReductionStrategy strategy;
+	LC_EXPR * result;
+} REDUCTION_TASK;
+
+typedef struct BINDER_SCOPE_STRUCT {
+	char * name;
+	struct BINDER_SCOPE_STRUCT * next; /* The enclosing binder */
+} BINDER_SCOPE;
+
+static int getBinderDistance(BINDER_SCOPE * scope, char * name) {
+	/* The de Bruijn index of the variable, or -1 if it is free */
+	int i;
+
+	for (i = 0; scope != NULL; scope = scope->next, ++i) {
+
+		if (!strcmp(scope->name, name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
 
-static int generatedVariableNumber = 0;
+/* **** The capture check **** */
 
-static STRING_SET * getSetOfAllVariableNames(LC_EXPR * expr) {
+static BOOL hasFreeVariable(LC_EXPR * expr, BINDER_SCOPE * scope) {
+	BINDER_SCOPE innerScope;
+
+	if (__atomic_load_n(&expr->closedness, __ATOMIC_RELAXED) == lcClosedness_Closed) {
+		return FALSE;
+	}
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
-			return addStringToSet(expr->name, NULL);
+			return getBinderDistance(scope, expr->name) < 0;
 
 		case lcExpressionType_LambdaExpr:
-			return addStringToSet(expr->name, getSetOfAllVariableNames(expr->expr));
+			innerScope.name = expr->name;
+			innerScope.next = scope;
+
+			return hasFreeVariable(expr->expr, &innerScope);
 
 		case lcExpressionType_FunctionCall:
-			return unionOfStringSets(getSetOfAllVariableNames(expr->expr), getSetOfAllVariableNames(expr->expr2), TRUE);
+		case lcExpressionType_Iteration:
+			return hasFreeVariable(expr->expr, scope) || hasFreeVariable(expr->expr2, scope);
 
 		default:
 			break;
 	}
 
-	return NULL;
+	return FALSE;
 }
 
-static BOOL containsBoundVariableNamed(LC_EXPR * expr, char * varName) {
+static BOOL isClosedExpr(LC_EXPR * expr) {
+	/* Nodes are never modified once they have been created, so the answer
+	is kept in the node. Substitution shares the argument, so the same
+	(often closed) argument is asked about again and again. Parallel tasks
+	may race to store the same value, hence the atomics. */
+	unsigned char closedness = __atomic_load_n(&expr->closedness, __ATOMIC_RELAXED);
+
+	if (closedness == lcClosedness_Unknown) {
+		closedness = hasFreeVariable(expr, NULL) ? lcClosedness_Open : lcClosedness_Closed;
+		__atomic_store_n(&expr->closedness, closedness, __ATOMIC_RELAXED);
+	}
+
+	return closedness == lcClosedness_Closed;
+}
+
+static STRING_SET * addFreeVariableNames(LC_CONTEXT * ctx, LC_EXPR * expr, BINDER_SCOPE * scope, STRING_SET * set) {
+	BINDER_SCOPE innerScope;
+
+	if (__atomic_load_n(&expr->closedness, __ATOMIC_RELAXED) == lcClosedness_Closed) {
+		return set;
+	}
 
 	switch (expr->type) {
+		case lcExpressionType_Variable:
+			return (getBinderDistance(scope, expr->name) < 0) ? addStringToSet(ctx, expr->name, set) : set;
+
 		case lcExpressionType_LambdaExpr:
-			return !strcmp(expr->name, varName) || containsBoundVariableNamed(expr->expr, varName);
+			innerScope.name = expr->name;
+			innerScope.next = scope;
+
+			return addFreeVariableNames(ctx, expr->expr, &innerScope, set);
 
 		case lcExpressionType_FunctionCall:
-			return containsBoundVariableNamed(expr->expr, varName) || containsBoundVariableNamed(expr->expr2, varName);
+		case lcExpressionType_Iteration:
+			return addFreeVariableNames(ctx, expr->expr2, scope, addFreeVariableNames(ctx, expr->expr, scope, set));
 
-		/* case lcExpressionType_Variable: */
 		default:
 			break;
 	}
 
-	return FALSE;
+	return set;
 }
 
-static LC_EXPR * substituteForUnboundVariable(LC_EXPR * expr, char * varName, LC_EXPR * replacementExpr) {
+static BOOL occursFree(LC_EXPR * expr, char * varName) {
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
-			return !strcmp(expr->name, varName) ? replacementExpr : expr;
+			return !strcmp(expr->name, varName);
 
 		case lcExpressionType_LambdaExpr:
-			return !strcmp(expr->name, varName) ? expr : createLambdaExpr(expr->name, substituteForUnboundVariable(expr->expr, varName, replacementExpr));
+			return strcmp(expr->name, varName) && occursFree(expr->expr, varName);
 
 		case lcExpressionType_FunctionCall:
-			return createFunctionCall(substituteForUnboundVariable(expr->expr, varName, replacementExpr), substituteForUnboundVariable(expr->expr2, varName, replacementExpr));
+		case lcExpressionType_Iteration:
+			return occursFree(expr->expr, varName) || occursFree(expr->expr2, varName);
 
 		default:
 			break;
 	}
 
-	return NULL;
+	return FALSE;
 }
 
-static LC_EXPR * renameBoundVariable(LC_EXPR * expr, char * newName, char * oldName) {
-	/* Also known as α-conversion (alpha conversion) */
+static LC_EXPR * substituteForUnboundVariable(LC_CONTEXT * ctx, LC_EXPR * expr, char * varName, LC_EXPR * replacementExpr, STRING_SET * freeNamesOfReplacement) {
+	/* Path copying: only the nodes above an occurrence of varName are
+	rebuilt; every subtree in which nothing changed is shared with expr.
+	A lambda that binds one of freeNamesOfReplacement (NULL if replacementExpr
+	is closed) is renamed, but only if varName occurs under it, which is the
+	only case in which it could capture anything. */
+	LC_EXPR * newExpr;
+	LC_EXPR * newExpr2;
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
+			return !strcmp(expr->name, varName) ? replacementExpr : expr;
+
+		case lcExpressionType_IntegerLiteral:
 			return expr;
 
 		case lcExpressionType_LambdaExpr:
 
-			if (strcmp(expr->name, oldName)) {
-				return createLambdaExpr(expr->name, renameBoundVariable(expr->expr, newName, oldName));
+			if (!strcmp(expr->name, varName)) {
+				return expr;
 			}
 
-			return createLambdaExpr(newName, substituteForUnboundVariable(expr->expr, oldName, createVariable(newName)));
+			if (stringSetContains(freeNamesOfReplacement, expr->name) && occursFree(expr->expr, varName)) {
+				/* α-conversion happens here. No lambda binds the new name,
+				and it is not free in the body or in the replacement, so
+				renaming to it cannot capture anything. */
+				char buf[maxStringValueLength];
+
+				do {
+					generateNewVariableName(ctx, buf, maxStringValueLength);
+				} while (stringSetContains(freeNamesOfReplacement, buf) || occursFree(expr->expr, buf));
+
+				if (ctx->trace != NULL) {
+					recordTraceEvent(ctx, teAlpha, expr, NULL);
+				}
+
+				newExpr = substituteForUnboundVariable(ctx, expr->expr, expr->name, createVariable(ctx, buf), NULL);
+
+				return createLambdaExpr(ctx, buf, substituteForUnboundVariable(ctx, newExpr, varName, replacementExpr, freeNamesOfReplacement));
+			}
+
+			newExpr = substituteForUnboundVariable(ctx, expr->expr, varName, replacementExpr, freeNamesOfReplacement);
+
+			return (newExpr == expr->expr) ? expr : createLambdaExpr(ctx, expr->name, newExpr);
 
 		case lcExpressionType_FunctionCall:
-			return createFunctionCall(renameBoundVariable(expr->expr, newName, oldName), renameBoundVariable(expr->expr2, newName, oldName));
+			newExpr = substituteForUnboundVariable(ctx, expr->expr, varName, replacementExpr, freeNamesOfReplacement);
+			newExpr2 = substituteForUnboundVariable(ctx, expr->expr2, varName, replacementExpr, freeNamesOfReplacement);
+
+			return (newExpr == expr->expr && newExpr2 == expr->expr2) ? expr : createFunctionCallOrIteration(ctx, newExpr, newExpr2);
+
+		case lcExpressionType_Iteration:
+			/* The whole spine is substituted at once: f is replaced once, not k times */
+			newExpr = substituteForUnboundVariable(ctx, expr->expr, varName, replacementExpr, freeNamesOfReplacement);
+			newExpr2 = substituteForUnboundVariable(ctx, expr->expr2, varName, replacementExpr, freeNamesOfReplacement);
+
+			return (newExpr == expr->expr && newExpr2 == expr->expr2) ? expr : createIteration(ctx, newExpr, newExpr2, expr->value);
 
 		default:
 			break;
@@ -113,65 +234,34 @@ static LC_EXPR * renameBoundVariable(LC_EXPR * expr, char * newName, char * oldN
 	return FALSE;
 } */
 
-static void generateNewVariableName(char * buf, int bufSize) {
+void generateNewVariableName(LC_CONTEXT * ctx, char * buf, int bufSize) {
+	/* Parallel tasks share their root context's counter, so that the names
+	that they generate are distinct. */
+	const int n = __atomic_add_fetch(&ctx->root->generatedVariableNumber, 1, __ATOMIC_RELAXED);
+
 	memset(buf, 0, bufSize);
-	++generatedVariableNumber;
-	sprintf(buf, "v%d", generatedVariableNumber);
+	sprintf(buf, "v%d", n);
 }
 
-static LC_EXPR * betaReduceCore(LC_EXPR * lambdaExpression, LC_EXPR * arg) {
+static LC_EXPR * betaReduceCore(LC_CONTEXT * ctx, LC_EXPR * lambdaExpression, LC_EXPR * arg) {
 	/* Rename variables as necessary (α-conversion) */
 
-	/* My idea for an algorithm:
-	1) Build a set of all (unbound?) variables in the body;
-	I.e. Create an array of the names of all unbound variables in arg: */
-
-	STRING_SET * allVarNames = getSetOfAllVariableNames(arg);
-	STRING_SET * allVarNamesUnboundInArg = NULL;
-	STRING_SET * ss;
-
-	for (ss = allVarNames; ss != NULL; ss = ss->next) {
+	++ctx->numBetaReductions;
 
-		if (containsUnboundVariableNamed(arg, ss->str, NULL)) {
-			allVarNamesUnboundInArg = addStringToSet(ss->str, allVarNamesUnboundInArg);
-		}
-	}
-
-	freeStringSet(allVarNames);
-	allVarNames = NULL;
-
-	/*
-	// 2) for each var v in the set:
-	//   - If v occurs as a bound variable in the callee, then:
-	//     - Generate a new variable name w that does not occur in the callee;
-	//     - In the callee, replace all bound occurrences of v with w.
-
-	// The variable renaming here prevents unbound variables in arg from
-	// becoming unintentionally bound when the substitution (into the Lambda
-	// expression's body) is performed.
-	*/
-
-	for (ss = allVarNamesUnboundInArg; ss != NULL; ss = ss->next) {
-
-		if (containsBoundVariableNamed(lambdaExpression, ss->str)) {
-			char buf[maxStringValueLength];
-
-			generateNewVariableName(buf, maxStringValueLength);
-
-			/* α-conversion happens here: */
-			lambdaExpression = renameBoundVariable(lambdaExpression, buf, ss->str);
-		}
+	if (ctx->trace != NULL) {
+		recordTraceEvent(ctx, teBeta, lambdaExpression, arg);
 	}
 
-	freeStringSet(allVarNamesUnboundInArg);
-	allVarNamesUnboundInArg = NULL;
+	/* Capture is possible only if a variable that is free in arg is bound
+	in the body. A closed arg, which is by far the most common case with
+	Church numerals, needs no check at all; otherwise the substitution
+	renames just the lambdas that would capture something. */
+	STRING_SET * freeNamesOfArg = isClosedExpr(arg) ? NULL : addFreeVariableNames(ctx, arg, NULL, NULL);
+	LC_EXPR * result = substituteForUnboundVariable(ctx, lambdaExpression->expr, lambdaExpression->name, arg, freeNamesOfArg);
 
-	/* Substitution:
-	Replace all unbound occurrences of Lambda expression's formal parameter
-	(lambdaExpression.arg) in the Lambda expression's body
-	(lambdaExpression.body) with an actual parameter (arg) : */
+	freeStringSet(ctx, freeNamesOfArg);
 
-	return substituteForUnboundVariable(lambdaExpression->expr, lambdaExpression->name, arg);
+	return result;
 }
 
 /* static LC_EXPR * betaReduceFunctionCall_CallByName(LC_EXPR * expr, int maxDepth) {
@@ -213,7 +303,274 @@ static LC_EXPR * betaReduceCore(LC_EXPR * lambdaExpression, LC_EXPR * arg) {
 		.betaReduce(options);
 } */
 
-static LC_EXPR * betaReduceFunctionCall_NormalOrder(LC_EXPR * expr, int maxDepth) {
+BOOL hasHeadRedex(LC_EXPR * expr) {
+	/* Is the head of expr's spine a lambda that is applied to something? */
+	BOOL isApplied = FALSE;
+
+	for (; expr->type == lcExpressionType_FunctionCall || expr->type == lcExpressionType_Iteration; expr = expr->expr) {
+		isApplied = TRUE;
+	}
+
+	return isApplied && expr->type == lcExpressionType_LambdaExpr;
+}
+
+static LC_EXPR * contractHeadRedex(LC_CONTEXT * ctx, LC_EXPR * expr) {
+	/* The recursion is as deep as the number of arguments on the spine.
+	An Iteration (f (f ... (f x))) is (f y), where y is the rest of its spine. */
+	LC_EXPR * arg = (expr->type == lcExpressionType_Iteration) ? createIteration(ctx, expr->expr, expr->expr2, expr->value - 1) : expr->expr2;
+
+	if (expr->expr->type == lcExpressionType_LambdaExpr) {
+		return betaReduceCore(ctx, expr->expr, arg);
+	}
+
+	return createFunctionCall(ctx, contractHeadRedex(ctx, expr->expr), arg);
+}
+
+LC_EXPR * betaReduceHead(LC_CONTEXT * ctx, LC_EXPR * expr, long * numStepsLeft) {
+	/* Contract the redex at the head of expr's spine until there is none, or
+	until *numStepsLeft runs out. The result is a lambda, or a variable (or
+	a literal) applied to arguments that have not been reduced at all. See
+	fprintNormalFormStreaming(). */
+
+	while (*numStepsLeft > 0 && hasHeadRedex(expr)) {
+		expr = contractHeadRedex(ctx, expr);
+		--*numStepsLeft;
+	}
+
+	return expr;
+}
+
+static long getMonotonicMilliseconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static BOOL exprHasAtLeastNNodes(LC_EXPR * expr, int * n) {
+	/* Counts down *n for each node visited; stops as soon as it reaches 0. */
+
+	if (--*n <= 0) {
+		return TRUE;
+	}
+
+	return (expr->expr != NULL && exprHasAtLeastNNodes(expr->expr, n)) ||
+		(expr->expr2 != NULL && exprHasAtLeastNNodes(expr->expr2, n));
+}
+
+static void runReductionTask(TASK * task, int workerIndex) {
+	REDUCTION_TASK * reductionTask = (REDUCTION_TASK *)task;
+
+	reductionTask->ctx.workerIndex = workerIndex;
+	reductionTask->result = betaReduce(&reductionTask->ctx, reductionTask->expr, reductionTask->maxDepth, reductionTask->strategy);
+}
+
+static LC_EXPR * betaReduceArgument(LC_CONTEXT * ctx, LC_EXPR * arg, int maxDepth, BetaReductionStrategy strategy) {
+	/* A cycle found in arg may be thrown away with it; see betaReduceContractum() */
+	++ctx->argumentDepth;
+	arg = betaReduce(ctx, arg, maxDepth, strategy);
+	--ctx->argumentDepth;
+
+	return arg;
+}
+
+static LC_EXPR * betaReduceFunctionCallParts(LC_CONTEXT * ctx, LC_EXPR * callee, LC_EXPR * arg, int maxDepth, BetaReductionStrategy strategy) {
+	/* Reduce callee and arg independently, and build (callee' arg').
+	If a scheduler is available and arg is large enough, arg is reduced as
+	a separate task that another worker may steal while we reduce callee. */
+	int n = ctx->parallelThreshold;
+
+	if (ctx->scheduler == NULL || !exprHasAtLeastNNodes(arg, &n)) {
+		return createFunctionCallOrIteration(ctx, betaReduce(ctx, callee, maxDepth, strategy), betaReduceArgument(ctx, arg, maxDepth, strategy));
+	}
+
+	const int workerIndex = (ctx->workerIndex >= 0) ? ctx->workerIndex : getExternalWorkerIndex(ctx->scheduler);
+	REDUCTION_TASK reductionTask;
+
+	reductionTask.task.run = runReductionTask;
+	initChildContext(&reductionTask.ctx, ctx);
+	reductionTask.ctx.argumentDepth = ctx->argumentDepth + 1;
+	reductionTask.expr = arg;
+	reductionTask.maxDepth = maxDepth;
+	reductionTask.strategy = strategy;
+	reductionTask.result = NULL;
+
+	if (!spawnTask(ctx->scheduler, workerIndex, &reductionTask.task)) {
+		return createFunctionCallOrIteration(ctx, betaReduce(ctx, callee, maxDepth, strategy), betaReduceArgument(ctx, arg, maxDepth, strategy));
+	}
+
+	LC_EXPR * reducedCallee = betaReduce(ctx, callee, maxDepth, strategy);
+
+	joinTask(ctx->scheduler, workerIndex, &reductionTask.task);
+	mergeChildContext(ctx, &reductionTask.ctx);
+
+	return createFunctionCallOrIteration(ctx, reducedCallee, reductionTask.result);
+}
+
+/* **** Cycle detection **** */
+
+/* When limits.detectCycles is set, every contractum that normal order goes
+on to reduce is fingerprinted before its reduction starts. Reduction is
+deterministic, so if a contractum is α-equivalent to one whose reduction
+encloses it, that reduction can never finish. If the contractum is in head
+position, outside every argument, the whole term diverges, as
+(\x.(x x) \x.(x x)) does, and reduction unwinds with rsCycleDetected
+instead of using up its whole budget. But normal order also reduces the
+arguments in a callee before the callee is applied, and an argument may
+yet be thrown away: (\u.(u (\x.(x x) \x.(x x))) \w.c) reduces to c. So a
+contractum inside an argument is left as it is, and recorded; the term only
+diverges if the contractum is still part of the result. Only the
+cycleDetectionWindow innermost enclosing contracta are compared, so a cycle
+must be shorter than that to be found. */
+
+static unsigned long mixFingerprint(unsigned long h, unsigned long value) {
+	h ^= value + 0x9e3779b97f4a7c15UL + (h << 6) + (h >> 2);
+
+	return h;
+}
+
+static unsigned long getFingerprint(LC_EXPR * expr, BINDER_SCOPE * scope) {
+	/* Bound variables are hashed by their de Bruijn indices, so α-equivalent
+	terms have the same fingerprint */
+	BINDER_SCOPE innerScope;
+	unsigned long h;
+	char * p;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+			h = (unsigned long)getBinderDistance(scope, expr->name);
+
+			if (h != (unsigned long)-1) {
+				return mixFingerprint(1, h);
+			}
+
+			for (h = 2, p = expr->name; *p != '\0'; ++p) {
+				h = mixFingerprint(h, (unsigned char)*p);
+			}
+
+			return h;
+
+		case lcExpressionType_LambdaExpr:
+			innerScope.name = expr->name;
+			innerScope.next = scope;
+
+			return mixFingerprint(3, getFingerprint(expr->expr, &innerScope));
+
+		case lcExpressionType_FunctionCall:
+			return mixFingerprint(mixFingerprint(4, getFingerprint(expr->expr, scope)), getFingerprint(expr->expr2, scope));
+
+		case lcExpressionType_IntegerLiteral:
+			return mixFingerprint(5, (unsigned long)expr->value);
+
+		case lcExpressionType_Iteration:
+			h = mixFingerprint(mixFingerprint(6, (unsigned long)expr->value), getFingerprint(expr->expr, scope));
+
+			return mixFingerprint(h, getFingerprint(expr->expr2, scope));
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+static BOOL areAlphaEquivalent(LC_EXPR * expr1, BINDER_SCOPE * scope1, LC_EXPR * expr2, BINDER_SCOPE * scope2) {
+	BINDER_SCOPE innerScope1;
+	BINDER_SCOPE innerScope2;
+
+	if (expr1->type != expr2->type) {
+		return FALSE;
+	}
+
+	switch (expr1->type) {
+		case lcExpressionType_Variable: {
+			const int distance = getBinderDistance(scope1, expr1->name);
+
+			return distance == getBinderDistance(scope2, expr2->name) &&
+				(distance >= 0 || !strcmp(expr1->name, expr2->name));
+		}
+
+		case lcExpressionType_LambdaExpr:
+			innerScope1.name = expr1->name;
+			innerScope1.next = scope1;
+			innerScope2.name = expr2->name;
+			innerScope2.next = scope2;
+
+			return areAlphaEquivalent(expr1->expr, &innerScope1, expr2->expr, &innerScope2);
+
+		case lcExpressionType_FunctionCall:
+			return areAlphaEquivalent(expr1->expr, scope1, expr2->expr, scope2) &&
+				areAlphaEquivalent(expr1->expr2, scope1, expr2->expr2, scope2);
+
+		case lcExpressionType_IntegerLiteral:
+			return expr1->value == expr2->value;
+
+		case lcExpressionType_Iteration:
+			return expr1->value == expr2->value &&
+				areAlphaEquivalent(expr1->expr, scope1, expr2->expr, scope2) &&
+				areAlphaEquivalent(expr1->expr2, scope1, expr2->expr2, scope2);
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+static LC_EXPR * betaReduceContractum(LC_CONTEXT * ctx, LC_EXPR * contractum, int maxDepth, BetaReductionStrategy strategy) {
+
+	if (!ctx->limits.detectCycles) {
+		return betaReduce(ctx, contractum, maxDepth, strategy);
+	}
+
+	const unsigned long fingerprint = getFingerprint(contractum, NULL);
+	const int depth = ctx->numActiveContracta;
+	int i;
+
+	for (i = 1; i <= cycleDetectionWindow && i <= depth; ++i) {
+		CYCLE_DETECTOR_ENTRY * entry = &ctx->activeContracta[(depth - i) % cycleDetectionWindow];
+
+		if (entry->depth == depth - i && entry->fingerprint == fingerprint &&
+			areAlphaEquivalent(entry->expr, NULL, contractum, NULL)) {
+			if (ctx->argumentDepth > 0 && ctx->numDivergentContracta < maxDivergentContracta) {
+				/* Applications of a variable around the redex may be merged into
+				an Iteration by the caller, so the part below them is recorded */
+				LC_EXPR * redexPart = contractum;
+
+				while ((redexPart->type == lcExpressionType_FunctionCall || redexPart->type == lcExpressionType_Iteration) &&
+					redexPart->expr->type == lcExpressionType_Variable) {
+					redexPart = redexPart->expr2;
+				}
+
+				ctx->divergentContracta[ctx->numDivergentContracta].expr = redexPart;
+				ctx->divergentContracta[ctx->numDivergentContracta].cycleLength = i;
+				++ctx->numDivergentContracta;
+			} else {
+				/* In head position, or no room to wait and see */
+				ctx->status = rsCycleDetected;
+				ctx->cycleLength = i;
+			}
+
+			return contractum;
+		}
+	}
+
+	CYCLE_DETECTOR_ENTRY * entry = &ctx->activeContracta[depth % cycleDetectionWindow];
+
+	entry->expr = contractum;
+	entry->fingerprint = fingerprint;
+	entry->depth = depth;
+	++ctx->numActiveContracta;
+
+	LC_EXPR * result = betaReduce(ctx, contractum, maxDepth, strategy);
+
+	--ctx->numActiveContracta;
+
+	return result;
+}
+
+static LC_EXPR * betaReduceFunctionCall_NormalOrder(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
 	/* normal - leftmost outermost; the most popular reduction strategy */
 
 	if (maxDepth <= 0) {
@@ -223,7 +580,7 @@ static LC_EXPR * betaReduceFunctionCall_NormalOrder(LC_EXPR * expr, int maxDepth
 	/* First, evaluate this.callee; if it does not evaluate
 	to a LCLambdaExpression, then return. */
 	/* TODO? : Should we replace expr->expr with etaReduce(expr->expr) here? */
-	LC_EXPR * evaluatedCallee = betaReduce(expr->expr, maxDepth, brsNormalOrder);
+	LC_EXPR * evaluatedCallee = betaReduce(ctx, expr->expr, maxDepth, brsNormalOrder);
 
 	if (evaluatedCallee->type != lcExpressionType_LambdaExpr) {
 		/* The result is App(e1’’, nor e2),
@@ -231,19 +588,16 @@ static LC_EXPR * betaReduceFunctionCall_NormalOrder(LC_EXPR * expr, int maxDepth
 		and e1’ = nor e1 = evaluatedCallee
 		and e1 = this.callee */
 
-		return createFunctionCall(
-			betaReduce(evaluatedCallee, maxDepth, brsNormalOrder),
-			/* Note: Simply using 'this.arg' (i.e. expr->expr2) as
-			the second argument fails. */
-			betaReduce(expr->expr2, maxDepth, brsNormalOrder)
-		);
+		/* Note: Simply using 'this.arg' (i.e. expr->expr2) as
+		the second argument fails. */
+		return betaReduceFunctionCallParts(ctx, evaluatedCallee, expr->expr2, maxDepth, brsNormalOrder);
 	}
 
 	/* Next, substitute this.arg (expr->expr2) in for the argument
 	in the evaluated callee. */
 
-	return betaReduce(
-		betaReduceCore(evaluatedCallee, expr->expr2),
+	return betaReduceContractum(ctx,
+		betaReduceCore(ctx, evaluatedCallee, expr->expr2),
 		maxDepth,
 		brsNormalOrder
 	);
@@ -283,7 +637,7 @@ static LC_EXPR * betaReduceFunctionCall_NormalOrder(LC_EXPR * expr, int maxDepth
 		.betaReduce(options);
 } */
 
-static LC_EXPR * betaReduceFunctionCall_ThAWHackForYCombinator(LC_EXPR * expr, int maxDepth) {
+static LC_EXPR * betaReduceFunctionCall_ThAWHackForYCombinator(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
 
 	if (maxDepth <= 0) {
 		return expr; // This is needed to prevent unbounded recursion.
@@ -298,7 +652,7 @@ static LC_EXPR * betaReduceFunctionCall_ThAWHackForYCombinator(LC_EXPR * expr, i
 
 	/* First, evaluate this.callee; if it does not evaluate
 	to a LCLambdaExpression, then return. */
-	LC_EXPR * evaluatedCallee = betaReduce(etaReduce(expr->expr), maxDepth, brsThAWHackForYCombinator);
+	LC_EXPR * evaluatedCallee = betaReduce(ctx, etaReduce(ctx, expr->expr), maxDepth, brsThAWHackForYCombinator);
 
 	if (evaluatedCallee->type != lcExpressionType_LambdaExpr) {
 		/* The result is App(e1’’, nor e2),
@@ -306,41 +660,121 @@ static LC_EXPR * betaReduceFunctionCall_ThAWHackForYCombinator(LC_EXPR * expr, i
 		and e1’ = nor e1 = evaluatedCallee
 		and e1 = this.callee */
 
-		return createFunctionCall(
+		return createFunctionCallOrIteration(ctx,
 			evaluatedCallee,
 			/* Note: Simply using 'this.arg' (i.e. expr->expr2) as
 			the second argument fails. */
-			betaReduce(expr->expr2, maxDepth, brsThAWHackForYCombinator)
+			betaReduceArgument(ctx, expr->expr2, maxDepth, brsThAWHackForYCombinator)
 		);
 	}
 
 	/* Next, substitute this.arg (expr->expr2) in for the argument
 	in the evaluated callee. */
 
-	return betaReduce(
-		betaReduceCore(evaluatedCallee, expr->expr2),
+	return betaReduceContractum(ctx,
+		betaReduceCore(ctx, evaluatedCallee, expr->expr2),
 		maxDepth,
 		brsThAWHackForYCombinator
 	);
 }
 
-LC_EXPR * betaReduce(LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy) {
+/* **** Iterations **** */
+
+/* const long maxIterationSteps = 1L << 24; */
+#define maxIterationSteps (1L << 24)
+
+static LC_EXPR * betaReduceIteration(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy) {
+	/* (f (f ... (f x))) is reduced one application of f at a time, as
+	(f y) would be, but in a loop instead of by recursion on y: while f
+	reduces to a lambda, the redex is contracted; while it reduces to the
+	same neutral term, its applications are counted and y is reduced next.
+	So a Church numeral applied to a Church numeral is reduced in O(1)
+	stack, and its result is again a single Iteration. Contraction keeps f
+	in the rest of the spine, so the lambda that f reduces to is kept too,
+	instead of reducing f again for each of its applications. */
+	LC_EXPR * lambdaHead = NULL;
+	LC_EXPR * reducedLambdaHead = NULL;
+	LC_EXPR * neutralHead = NULL;
+	long numNeutralApplications = 0;
+	long numStepsLeft = maxIterationSteps;
+
+	while (expr->type == lcExpressionType_Iteration && ctx->status == rsOK && numStepsLeft-- > 0) {
+		LC_EXPR * reducedHead = reducedLambdaHead;
+
+		if (expr->expr != lambdaHead) {
+			reducedHead = betaReduce(ctx, (strategy == brsThAWHackForYCombinator) ? etaReduce(ctx, expr->expr) : expr->expr, maxDepth, strategy);
+		}
+
+		if (reducedHead->type == lcExpressionType_LambdaExpr) {
+			lambdaHead = expr->expr;
+			reducedLambdaHead = reducedHead;
+			expr = betaReduceCore(ctx, reducedHead, createIteration(ctx, expr->expr, expr->expr2, expr->value - 1));
+		} else if (neutralHead == NULL || reducedHead == neutralHead ||
+			(reducedHead->type == lcExpressionType_Variable && neutralHead->type == lcExpressionType_Variable &&
+			!strcmp(reducedHead->name, neutralHead->name))) {
+			neutralHead = reducedHead;
+			numNeutralApplications += expr->value;
+			expr = expr->expr2;
+		} else {
+			break;
+		}
+	}
+
+	/* After a neutral head, the rest of the spine is its argument */
+	expr = (neutralHead == NULL) ? betaReduce(ctx, expr, maxDepth, strategy) : betaReduceArgument(ctx, expr, maxDepth, strategy);
+
+	return (neutralHead == NULL) ? expr : createIteration(ctx, neutralHead, expr, numNeutralApplications);
+}
+
+LC_EXPR * betaReduce(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy) {
 	/* β-reduction (beta-reduction) : In the call (\\x.body arg), replace all
 	free occurrences of x in body with arg. Rename free variables in arg where
 	necessary to prevent them from becoming bound inside body. */
 
 	/* BetaReductionStrategy strategy = brsDefault; */
 
+	/* Stop if a resource limit has been hit; see betaReduceWithLimits() */
+
+	if (ctx->status != rsOK) {
+		return expr;
+	} else if (ctx->limits.maxMilliseconds > 0 && ++ctx->numCallsSinceClockCheck >= callsPerClockCheck) {
+		ctx->numCallsSinceClockCheck = 0;
+
+		if (getMonotonicMilliseconds() > ctx->deadline) {
+			ctx->status = rsTimeLimitExceeded;
+			return expr;
+		}
+	}
+
+	if (ctx->trace != NULL) {
+		ctx->traceStrategy = strategy;
+	}
+
+	/* Different engines altogether: they reduce the whole term at once */
+
+	if (strategy == brsInteractionNet) {
+		return reduceWithInteractionNet(ctx, expandIterations(ctx, expr), maxDepth);
+	} else if (strategy == brsCombinator) {
+		return reduceWithCombinators(ctx, expandIterations(ctx, expr), maxDepth);
+	} else if (strategy == brsExplicitSubstitution) {
+		return reduceWithExplicitSubstitutions(ctx, expandIterations(ctx, expr), maxDepth);
+	} else if (strategy == brsGMachine) {
+		return reduceWithGMachine(ctx, expandIterations(ctx, expr), maxDepth);
+	} else if (strategy == brsNormalizationByEvaluation) {
+		return normalizeByEvaluation(ctx, expr, maxDepth);
+	}
+
 	if (maxDepth <= 0) {
 		return expr;
 	}
 
 	--maxDepth;
 
-	expr = etaReduce(expr);
+	expr = etaReduce(ctx, expr);
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
+		case lcExpressionType_IntegerLiteral:
 			return expr;
 
 		case lcExpressionType_LambdaExpr:
@@ -351,19 +785,44 @@ LC_EXPR * betaReduce(LC_EXPR * expr, int maxDepth, BetaReductionStrategy strateg
 					return expr;
 
 				default:
-					return createLambdaExpr(expr->name, betaReduce(expr->expr, maxDepth, strategy));
+					break;
 			}
 
+			LC_EXPR * reducedBody = betaReduce(ctx, expr->expr, maxDepth, strategy);
+
+			return (reducedBody == expr->expr) ? expr : createLambdaExpr(ctx, expr->name, reducedBody);
+
 			break;
 
 		case lcExpressionType_FunctionCall:
 
+			if (ctx->enableDeltaReduction) {
+				LC_EXPR * deltaReducedExpr = deltaReduceFunctionCall(ctx, expr, maxDepth, strategy);
+
+				if (deltaReducedExpr != NULL) {
+					return deltaReducedExpr;
+				}
+			}
+
 			switch (strategy) {
 				case brsNormalOrder:
-					return betaReduceFunctionCall_NormalOrder(expr, maxDepth);
+					return betaReduceFunctionCall_NormalOrder(ctx, expr, maxDepth);
+
+				case brsThAWHackForYCombinator:
+					return betaReduceFunctionCall_ThAWHackForYCombinator(ctx, expr, maxDepth);
+
+				default:
+					return NULL;
+			}
+
+			return NULL;
+
+		case lcExpressionType_Iteration:
 
+			switch (strategy) {
+				case brsNormalOrder:
 				case brsThAWHackForYCombinator:
-					return betaReduceFunctionCall_ThAWHackForYCombinator(expr, maxDepth);
+					return betaReduceIteration(ctx, expr, maxDepth, strategy);
 
 				default:
 					return NULL;
@@ -378,4 +837,53 @@ LC_EXPR * betaReduce(LC_EXPR * expr, int maxDepth, BetaReductionStrategy strateg
 	return NULL;
 }
 
+LC_EXPR * betaReduceWithLimits(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy, REDUCTION_LIMITS * limits, ReductionStatus * status) {
+	/* Reduce expr within the given limits on live nodes, allocations and
+	time, and optionally stop if it diverges (ctx->cycleLength is then the
+	length of the cycle). If a limit is hit, the reduction unwinds without doing any more
+	work, the nodes that it created are freed, *status says which limit it
+	was, and NULL is returned. Other nodes in the heap are left alone. */
+	MEMMGR_RECORD * oldHead = ctx->memmgrRecords;
+	int i;
+
+	ctx->limits = *limits;
+	ctx->status = rsOK;
+	ctx->root->numLimitedAllocations = 0;
+	ctx->root->numLimitedLiveNodes = ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees;
+	ctx->deadline = getMonotonicMilliseconds() + limits->maxMilliseconds;
+	ctx->numCallsSinceClockCheck = 0;
+	ctx->numActiveContracta = 0;
+	ctx->cycleLength = 0;
+	ctx->argumentDepth = 0;
+	ctx->numDivergentContracta = 0;
+
+	LC_EXPR * result = betaReduce(ctx, expr, maxDepth, strategy);
+
+	if (ctx->status == rsOK && ctx->numDivergentContracta > 0) {
+		/* Did a recurring contractum survive into the result? */
+		markExprTree(ctx, result);
+
+		for (i = 0; i < ctx->numDivergentContracta && ctx->status == rsOK; ++i) {
+
+			if (ctx->divergentContracta[i].expr->mark != 0) {
+				ctx->status = rsCycleDetected;
+				ctx->cycleLength = ctx->divergentContracta[i].cycleLength;
+			}
+		}
+	}
+
+	ctx->numDivergentContracta = 0;
+
+	*status = ctx->status;
+	memset(&ctx->limits, 0, sizeof(REDUCTION_LIMITS));
+	ctx->status = rsOK;
+
+	if (*status != rsOK) {
+		freeStructsAllocatedSince(ctx, oldHead);
+		return NULL;
+	}
+
+	return result;
+}
+
 /* **** The End **** */
@@ -9,9 +9,18 @@ typedef enum {
 	brsHeadSpine,
 	brsHybridNormalOrder,
 	brsThAWHackForYCombinator,
+	brsInteractionNet, /* Lamping's optimal reduction; see interaction-net.c */
+	brsCombinator, /* SKI combinator graph reduction; see combinator.c */
+	brsExplicitSubstitution, /* Lazy substitution in the λσ-calculus; see explicit-substitution.c */
+	brsGMachine, /* Lambda-lifted supercombinators compiled to G-machine code; see g-machine.c */
+	brsNormalizationByEvaluation, /* Evaluation into closures, then read-back; see normalization-by-evaluation.c */
 	brsDefault = brsNormalOrder
 } BetaReductionStrategy;
 
-LC_EXPR * betaReduce(LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy);
+void generateNewVariableName(LC_CONTEXT * ctx, char * buf, int bufSize);
+LC_EXPR * betaReduce(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy);
+BOOL hasHeadRedex(LC_EXPR * expr);
+LC_EXPR * betaReduceHead(LC_CONTEXT * ctx, LC_EXPR * expr, long * numStepsLeft);
+LC_EXPR * betaReduceWithLimits(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy, REDUCTION_LIMITS * limits, ReductionStatus * status);
 
 /* **** The End **** */
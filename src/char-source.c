@@ -4,57 +4,193 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHAR_SOURCE_ENABLE_SIMD
+#endif
+
 #include "boolean.h"
 
 #include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 
 #include "char-source.h"
 
-static int numMallocs = 0;
-static int numFrees = 0;
+void printCharSourceMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Char sources", &ctx->charSourceCounts);
+}
+
+// **** Character scanners ****
+
+/* A scanner returns the index of the first character at or after i that
+satisfies its predicate, or len if there is no such character.
+The delimiters are the whitespace characters, '(', ')', '.' and '\\'. */
+
+static BOOL isWhiteSpace(char c) {
+	return c == ' ' || c == '\t' ? TRUE : FALSE;
+}
+
+static BOOL isDelimiter(char c) {
+	return isWhiteSpace(c) || c == '(' || c == ')' || c == '.' || c == '\\' ? TRUE : FALSE;
+}
+
+static int findNonWhiteSpace_Scalar(char * str, int i, int len) {
+
+	while (i < len && isWhiteSpace(str[i])) {
+		++i;
+	}
+
+	return i;
+}
+
+static int findDelimiter_Scalar(char * str, int i, int len) {
+
+	while (i < len && !isDelimiter(str[i])) {
+		++i;
+	}
+
+	return i;
+}
+
+#ifdef CHAR_SOURCE_ENABLE_SIMD
+
+__attribute__((target("sse2")))
+static int findNonWhiteSpace_SSE2(char * str, int i, int len) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
 
-void printCharSourceMemMgrReport() {
-	printf("  Char sources: %d mallocs, %d frees", numMallocs, numFrees);
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+		const unsigned int mask = ~(unsigned int)_mm_movemask_epi8(ws) & 0xFFFFu;
 
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
 	}
 
-	printf("\n");
+	return findNonWhiteSpace_Scalar(str, i, len);
+}
+
+__attribute__((target("sse2")))
+static int findDelimiter_SSE2(char * str, int i, int len) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i lparen = _mm_set1_epi8('(');
+	const __m128i rparen = _mm_set1_epi8(')');
+	const __m128i dot = _mm_set1_epi8('.');
+	const __m128i backslash = _mm_set1_epi8('\\');
+
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		__m128i d = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+
+		d = _mm_or_si128(d, _mm_or_si128(_mm_cmpeq_epi8(v, lparen), _mm_cmpeq_epi8(v, rparen)));
+		d = _mm_or_si128(d, _mm_or_si128(_mm_cmpeq_epi8(v, dot), _mm_cmpeq_epi8(v, backslash)));
+
+		const unsigned int mask = (unsigned int)_mm_movemask_epi8(d);
+
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return findDelimiter_Scalar(str, i, len);
+}
+
+__attribute__((target("avx2")))
+static int findNonWhiteSpace_AVX2(char * str, int i, int len) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+
+	for (; i + 32 <= len; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+		const __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab));
+		const unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(ws);
+
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return findNonWhiteSpace_SSE2(str, i, len);
+}
+
+__attribute__((target("avx2")))
+static int findDelimiter_AVX2(char * str, int i, int len) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i lparen = _mm256_set1_epi8('(');
+	const __m256i rparen = _mm256_set1_epi8(')');
+	const __m256i dot = _mm256_set1_epi8('.');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+
+	for (; i + 32 <= len; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+		__m256i d = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab));
+
+		d = _mm256_or_si256(d, _mm256_or_si256(_mm256_cmpeq_epi8(v, lparen), _mm256_cmpeq_epi8(v, rparen)));
+		d = _mm256_or_si256(d, _mm256_or_si256(_mm256_cmpeq_epi8(v, dot), _mm256_cmpeq_epi8(v, backslash)));
+
+		const unsigned int mask = (unsigned int)_mm256_movemask_epi8(d);
+
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return findDelimiter_SSE2(str, i, len);
+}
+
+#endif
+
+static void selectScanners(CharSource * cs) {
+	/* Choose the widest implementation that this CPU supports. */
+	cs->findNonWhiteSpace = findNonWhiteSpace_Scalar;
+	cs->findDelimiter = findDelimiter_Scalar;
+
+#ifdef CHAR_SOURCE_ENABLE_SIMD
+	if (__builtin_cpu_supports("avx2")) {
+		cs->findNonWhiteSpace = findNonWhiteSpace_AVX2;
+		cs->findDelimiter = findDelimiter_AVX2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		cs->findNonWhiteSpace = findNonWhiteSpace_SSE2;
+		cs->findDelimiter = findDelimiter_SSE2;
+	}
+#endif
 }
 
 // **** CharSource functions ****
 
-CharSource * createCharSource(char * str) {
-	CharSource * cs = (CharSource *)malloc(sizeof(CharSource));
+CharSource * createCharSource(LC_CONTEXT * ctx, char * str) {
+	CharSource * cs = (CharSource *)countedRealloc(&ctx->charSourceCounts, NULL, sizeof(CharSource));
 
-	++numMallocs;
+	cs->ctx = ctx;
 
 	/* TODO? : Clone the string? */
 	cs->str = str;
 
 	cs->len = strlen(str);
 	cs->i = 0;
+	selectScanners(cs);
 
 	return cs;
 }
 
 void freeCharSource(CharSource * cs) {
+	LC_CONTEXT * ctx = cs->ctx;
+
 	cs->str = NULL; /* Note bene: We don't call free() here */
-	free(cs);
-	++numFrees;
+	cs->ctx = NULL;
+	countedFree(&ctx->charSourceCounts, cs);
 }
 
 int getNextChar(CharSource * cs) {
+	cs->i = cs->findNonWhiteSpace(cs->str, cs->i, cs->len);
 
-	while (cs->i < cs->len) {
-		const int c = (int)cs->str[cs->i];
-
-		++cs->i;
-
-		if (c != (int)' ') {
-			return c;
-		}
+	if (cs->i < cs->len) {
+		return (int)cs->str[cs->i++];
 	}
 
 	return EOF;
@@ -71,15 +207,8 @@ static BOOL isEOF(CharSource * cs) {
 	return cs->i >= cs->len;
 }
 
-static BOOL isWhiteSpace(char c) {
-	return c == ' ' || c == '\t' ? TRUE : FALSE;
-}
-
 static void skipWhiteSpace(CharSource * cs) {
-
-	while (cs->i < cs->len && isWhiteSpace(cs->str[cs->i])) {
-		++cs->i;
-	}
+	cs->i = cs->findNonWhiteSpace(cs->str, cs->i, cs->len);
 }
 
 int getIdentifier(CharSource * cs, char * dstBuf, int dstBufSize) {
@@ -91,22 +220,15 @@ int getIdentifier(CharSource * cs, char * dstBuf, int dstBufSize) {
 		return 0;
 	}
 
-	if (cs->str[cs->i] == '(' || cs->str[cs->i] == ')' || cs->str[cs->i] == '.') {
+	if (isDelimiter(cs->str[cs->i])) {
+		/* A single-character token: '(', ')', '.' or '\\' */
 		memcpy(dstBuf, &cs->str[cs->i++], 1);
 		return 1;
 	}
 
 	const int start = cs->i;
 
-	while (cs->i < cs->len) {
-		const char c = cs->str[cs->i];
-
-		if (isWhiteSpace(c) || c == '(' || c == ')' || c == '.' /* || c == '\0' */) {
-			break;
-		}
-
-		++cs->i;
-	}
+	cs->i = cs->findDelimiter(cs->str, cs->i, cs->len);
 
 	const int end = cs->i;
 	const int len = end - start;
@@ -1,18 +1,22 @@
 /* atrocity/src/char-source.h */
 
 typedef struct {
+	LC_CONTEXT * ctx;
 	char * str;
 	int len;
 	int i;
+	/* Scanners chosen at runtime (SSE2, AVX2 or scalar); see char-source.c */
+	int (*findNonWhiteSpace)(char * str, int i, int len);
+	int (*findDelimiter)(char * str, int i, int len);
 } CharSource;
 
-CharSource * createCharSource(char * str);
+CharSource * createCharSource(LC_CONTEXT * ctx, char * str);
 void freeCharSource(CharSource * cs);
 int getNextChar(CharSource * cs);
 void rewindOneChar(CharSource * cs);
 int getIdentifier(CharSource * cs, char * dstBuf, int dstBufSize);
 BOOL consumeStr(CharSource * cs, char * str);
 
-void printCharSourceMemMgrReport();
+void printCharSourceMemMgrReport(LC_CONTEXT * ctx);
 
 /* **** The End **** */
@@ -0,0 +1,417 @@
+/* facility/src/combinator.c */
+
+/* An alternative reduction engine based on combinators (κ-reduction).
+ *
+ * The term is compiled by bracket abstraction into a graph built from
+ * applications, free variables and Turner's combinators:
+ *
+ *	I x      -> x
+ *	K x y    -> x
+ *	S f g x  -> ((f x) (g x))
+ *	B f g x  -> (f (g x))
+ *	C f g x  -> ((f x) g)
+ *
+ * The graph is then reduced by unwinding the spine of applications, and
+ * each redex is overwritten in place by its contractum, so a shared redex
+ * is reduced only once. There are no bound variables in a combinator graph,
+ * so reduction never needs α-conversion.
+ *
+ * The read-back reduces to weak head normal form. If the head is a free
+ * variable, it reads back the arguments. If the head is a combinator that
+ * is still missing arguments, it applies the graph to a fresh variable (one
+ * that is not free in the input) and abstracts over that variable. The result is then η-reduced, like the
+ * input to betaReduce(). */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "combinator.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+
+/* const long maxCombinatorSteps = 1L << 22; */
+#define maxCombinatorSteps (1L << 22)
+/* const int maxCombinatorReadBackDepth = 50000; */
+#define maxCombinatorReadBackDepth 50000
+
+typedef enum {
+	combNodeType_Application,
+	combNodeType_Variable,
+	combNodeType_Indirection, /* A redex that has been reduced to left */
+	combNodeType_I,
+	combNodeType_K,
+	combNodeType_S,
+	combNodeType_B,
+	combNodeType_C
+} CombNodeType;
+
+typedef struct {
+	CombNodeType type;
+	int left; /* For applications and indirections */
+	int right; /* For applications */
+	char name[maxStringValueLength]; /* For variables */
+} COMB_NODE;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	COMB_NODE * nodes;
+	int numNodes;
+	int capacity;
+	int * stack; /* The spine; holds application nodes */
+	int stackSize;
+	int stackCapacity;
+	long numSteps;
+	BOOL failed;
+	LC_EXPR * term; /* The input, whose free variables must not be captured */
+} COMB_GRAPH;
+
+/* **** Allocation **** */
+
+void printCombinatorMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Combinators", &ctx->combinatorCounts);
+}
+
+static void * combRealloc(COMB_GRAPH * graph, void * ptr, size_t size) {
+	return countedRealloc(&graph->ctx->combinatorCounts, ptr, size);
+}
+
+static void combFree(COMB_GRAPH * graph, void * ptr) {
+	countedFree(&graph->ctx->combinatorCounts, ptr);
+}
+
+static int createNode(COMB_GRAPH * graph, CombNodeType type, int left, int right) {
+
+	if (graph->numNodes == graph->capacity) {
+		graph->capacity = (graph->capacity == 0) ? 256 : 2 * graph->capacity;
+		graph->nodes = (COMB_NODE *)combRealloc(graph, graph->nodes, graph->capacity * sizeof(COMB_NODE));
+	}
+
+	const int n = graph->numNodes++;
+	COMB_NODE * node = &graph->nodes[n];
+
+	node->type = type;
+	node->left = left;
+	node->right = right;
+	memset(node->name, 0, maxStringValueLength);
+
+	return n;
+}
+
+static int createVariableNode(COMB_GRAPH * graph, char * name) {
+	const int n = createNode(graph, combNodeType_Variable, -1, -1);
+
+	strcpy(graph->nodes[n].name, name);
+
+	return n;
+}
+
+static int createApplication(COMB_GRAPH * graph, int left, int right) {
+	return createNode(graph, combNodeType_Application, left, right);
+}
+
+static int getArity(CombNodeType type) {
+
+	switch (type) {
+		case combNodeType_I:
+			return 1;
+
+		case combNodeType_K:
+			return 2;
+
+		case combNodeType_S:
+		case combNodeType_B:
+		case combNodeType_C:
+			return 3;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+/* **** Compilation from LC_EXPR by bracket abstraction **** */
+
+static BOOL occursIn(COMB_GRAPH * graph, char * name, int n) {
+	/* The compiled graph is still a tree here */
+	COMB_NODE * node = &graph->nodes[n];
+
+	switch (node->type) {
+		case combNodeType_Variable:
+			return !strcmp(node->name, name);
+
+		case combNodeType_Application:
+			return occursIn(graph, name, node->left) || occursIn(graph, name, node->right);
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+static int abstractVariable(COMB_GRAPH * graph, char * name, int n) {
+	/* [x] e, with Turner's optimizations:
+	[x] x = I
+	[x] e = (K e) if x does not occur in e
+	[x] (e x) = e if x does not occur in e
+	[x] (e1 e2) = ((B e1) [x] e2) if x does not occur in e1
+	[x] (e1 e2) = ((C [x] e1) e2) if x does not occur in e2
+	[x] (e1 e2) = ((S [x] e1) [x] e2) otherwise */
+
+	if (!occursIn(graph, name, n)) {
+		return createApplication(graph, createNode(graph, combNodeType_K, -1, -1), n);
+	} else if (graph->nodes[n].type == combNodeType_Variable) {
+		return createNode(graph, combNodeType_I, -1, -1);
+	}
+
+	/* n is an application in which x occurs */
+	const int e1 = graph->nodes[n].left;
+	const int e2 = graph->nodes[n].right;
+	const BOOL occursInE1 = occursIn(graph, name, e1);
+
+	if (!occursInE1) {
+
+		if (graph->nodes[e2].type == combNodeType_Variable) {
+			return e1; /* e2 is x */
+		}
+
+		return createApplication(graph,
+			createApplication(graph, createNode(graph, combNodeType_B, -1, -1), e1),
+			abstractVariable(graph, name, e2)
+		);
+	}
+
+	const int abstractedE1 = abstractVariable(graph, name, e1);
+
+	if (!occursIn(graph, name, e2)) {
+		return createApplication(graph,
+			createApplication(graph, createNode(graph, combNodeType_C, -1, -1), abstractedE1),
+			e2
+		);
+	}
+
+	return createApplication(graph,
+		createApplication(graph, createNode(graph, combNodeType_S, -1, -1), abstractedE1),
+		abstractVariable(graph, name, e2)
+	);
+}
+
+static int compileExpr(COMB_GRAPH * graph, LC_EXPR * expr) {
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+			return createVariableNode(graph, expr->name);
+
+		case lcExpressionType_LambdaExpr:
+			return abstractVariable(graph, expr->name, compileExpr(graph, expr->expr));
+
+		case lcExpressionType_FunctionCall:
+			return createApplication(graph, compileExpr(graph, expr->expr), compileExpr(graph, expr->expr2));
+
+		default:
+			break;
+	}
+
+	/* E.g. an integer literal */
+	graph->failed = TRUE;
+
+	return createNode(graph, combNodeType_I, -1, -1);
+}
+
+/* **** Graph reduction **** */
+
+static int followIndirections(COMB_GRAPH * graph, int n) {
+
+	while (graph->nodes[n].type == combNodeType_Indirection) {
+		n = graph->nodes[n].left;
+	}
+
+	return n;
+}
+
+static void pushSpine(COMB_GRAPH * graph, int n) {
+
+	if (graph->stackSize == graph->stackCapacity) {
+		graph->stackCapacity = (graph->stackCapacity == 0) ? 64 : 2 * graph->stackCapacity;
+		graph->stack = (int *)combRealloc(graph, graph->stack, graph->stackCapacity * sizeof(int));
+	}
+
+	graph->stack[graph->stackSize++] = n;
+}
+
+static int reduceToWeakHeadNormalForm(COMB_GRAPH * graph, int n, int base) {
+	/* Unwinds the spine of n onto the stack above base, reducing as it goes.
+	Returns the head; stack[base] is the outermost application, and the top
+	of the stack is the application of the head to its first argument. */
+	graph->stackSize = base;
+
+	while (!graph->failed) {
+		n = followIndirections(graph, n);
+
+		const CombNodeType type = graph->nodes[n].type;
+
+		if (type == combNodeType_Application) {
+			pushSpine(graph, n);
+			graph->nodes[n].left = followIndirections(graph, graph->nodes[n].left);
+			n = graph->nodes[n].left;
+			continue;
+		}
+
+		const int arity = getArity(type);
+
+		if (arity == 0 || graph->stackSize - base < arity) {
+			return n; /* A free variable, or a partial application */
+		}
+
+		const int top = graph->stackSize - 1;
+		const int redex = graph->stack[top - (arity - 1)];
+		/* Skip indirections here, so that chains of them do not build up */
+		const int x = followIndirections(graph, graph->nodes[graph->stack[top]].right);
+		const int y = (arity > 1) ? followIndirections(graph, graph->nodes[graph->stack[top - 1]].right) : -1;
+		const int z = (arity > 2) ? followIndirections(graph, graph->nodes[graph->stack[top - 2]].right) : -1;
+		int left;
+		int right;
+
+		switch (type) {
+			case combNodeType_I:
+			case combNodeType_K:
+
+				if (x == redex) {
+					/* The redex reduces to itself, as in (Ω = ((S I) I) ((S I) I)) */
+					graph->failed = TRUE;
+					return n;
+				}
+
+				graph->nodes[redex].type = combNodeType_Indirection;
+				graph->nodes[redex].left = x;
+				break;
+
+			case combNodeType_S:
+				left = createApplication(graph, x, z);
+				right = createApplication(graph, y, z);
+				graph->nodes[redex].left = left;
+				graph->nodes[redex].right = right;
+				break;
+
+			case combNodeType_B:
+				right = createApplication(graph, y, z);
+				graph->nodes[redex].left = x;
+				graph->nodes[redex].right = right;
+				break;
+
+			case combNodeType_C:
+				left = createApplication(graph, x, z);
+				graph->nodes[redex].left = left;
+				graph->nodes[redex].right = y;
+				break;
+
+			default:
+				break;
+		}
+
+		graph->stackSize -= arity;
+		n = redex;
+
+		if (++graph->numSteps > maxCombinatorSteps) {
+			graph->failed = TRUE;
+		}
+	}
+
+	return n;
+}
+
+/* **** Read-back to LC_EXPR **** */
+
+static LC_EXPR * readBack(COMB_GRAPH * graph, int n, int depth) {
+	const int base = graph->stackSize;
+	int i;
+
+	if (depth > maxCombinatorReadBackDepth) {
+		graph->failed = TRUE;
+	}
+
+	const int head = reduceToWeakHeadNormalForm(graph, n, base);
+
+	if (graph->failed) {
+		graph->stackSize = base;
+		return NULL;
+	}
+
+	if (graph->nodes[head].type != combNodeType_Variable) {
+		/* A combinator that is missing some arguments: η-expand */
+		char buf[maxStringValueLength];
+
+		graph->stackSize = base;
+
+		do {
+			generateNewVariableName(graph->ctx, buf, maxStringValueLength);
+		} while (containsUnboundVariableNamed(graph->ctx, graph->term, buf, NULL));
+
+		LC_EXPR * body = readBack(graph, createApplication(graph, n, createVariableNode(graph, buf)), depth + 1);
+
+		return (body == NULL) ? NULL : createLambdaExpr(graph->ctx, buf, body);
+	}
+
+	/* A free variable applied to zero or more arguments. The stack may grow
+	(and move) while we read back the arguments, so index it afresh. */
+	const int numArgs = graph->stackSize - base;
+	LC_EXPR * result = createVariable(graph->ctx, graph->nodes[head].name);
+
+	for (i = numArgs - 1; i >= 0 && result != NULL; --i) {
+		const int arg = graph->nodes[graph->stack[base + i]].right;
+		const int savedStackSize = graph->stackSize;
+
+		LC_EXPR * argExpr = readBack(graph, arg, depth + 1);
+
+		graph->stackSize = savedStackSize;
+		result = (argExpr == NULL) ? NULL : createFunctionCall(graph->ctx, result, argExpr);
+	}
+
+	graph->stackSize = base;
+
+	return result;
+}
+
+/* **** The engine **** */
+
+LC_EXPR * reduceWithCombinators(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
+	COMB_GRAPH graph;
+
+	if (ctx->enableDeltaReduction) {
+		/* Bracket abstraction has no combinators for literals or primitives */
+		return betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	memset(&graph, 0, sizeof(COMB_GRAPH));
+	graph.ctx = ctx;
+	graph.term = expr;
+
+	const int root = compileExpr(&graph, expr);
+	LC_EXPR * result = graph.failed ? NULL : readBack(&graph, root, 0);
+
+	if (result == NULL) {
+		fprintf(stderr, "reduceWithCombinators() : %s after %ld steps; using normal order instead\n",
+			(graph.numSteps > maxCombinatorSteps) ? "Too many steps" : "Cannot read back the result",
+			graph.numSteps);
+		result = betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	} else {
+		result = etaReduce(ctx, result);
+	}
+
+	combFree(&graph, graph.stack);
+	combFree(&graph, graph.nodes);
+
+	return result;
+}
+
+/* **** The End **** */
@@ -0,0 +1,6 @@
+/* facility/src/combinator.h */
+
+void printCombinatorMemMgrReport(LC_CONTEXT * ctx);
+LC_EXPR * reduceWithCombinators(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth);
+
+/* **** The End **** */
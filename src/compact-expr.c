@@ -0,0 +1,452 @@
+/* facility/src/compact-expr.c */
+
+/* A compact alternative to LC_EXPR. An LC_EXPR is a separately malloc'ed
+ * node of 40 bytes, with a 16-byte MEMMGR_RECORD (and two malloc
+ * headers) to keep track of it. Here the nodes live in one array and refer
+ * to each other by 32-bit index; the type and the GC mark are packed into
+ * the low bits of a header word, and the name is replaced by the ID of an
+ * interned string. A node is 12 bytes, so about four times as many fit in
+ * the cache, and the heap is freed in one go.
+ *
+ * Code is meant to reach the nodes only through the accessors below, which
+ * mirror the fields of LC_EXPR (expr->expr becomes getCompactExpr(heap,
+ * expr), and so on). The array may move as it grows, so never hold a
+ * COMPACT_NODE pointer across a create call; the indices stay valid.
+ *
+ * getCompactDeBruijnIndex() is de-bruijn.c ported to this layout: bound
+ * variables are compared by name ID rather than with strcmp(). */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "compact-expr.h"
+#include "create-and-destroy.h"
+
+/* const unsigned int compactTypeMask = 7; */
+#define compactTypeMask 7
+/* const unsigned int compactMarkBit = 8; */
+#define compactMarkBit 8
+/* const int compactNameIdShift = 4; */
+#define compactNameIdShift 4
+/* const unsigned int maxCompactNameId = (1U << 28) - 1; */
+#define maxCompactNameId ((1U << 28) - 1)
+
+/* The type of a node on the free list */
+/* const int compactExpressionType_Free = 7; */
+#define compactExpressionType_Free 7
+
+typedef struct {
+	unsigned int * ids; /* The name IDs of the enclosing binders, innermost last */
+	int size;
+	int capacity;
+} COMPACT_BINDER_STACK;
+
+void printCompactExprMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Compact expressions", &ctx->compactExprCounts);
+}
+
+/* **** The heap **** */
+
+COMPACT_HEAP * createCompactHeap(LC_CONTEXT * ctx) {
+	COMPACT_HEAP * heap = (COMPACT_HEAP *)countedRealloc(&ctx->compactExprCounts, NULL, sizeof(COMPACT_HEAP));
+
+	memset(heap, 0, sizeof(COMPACT_HEAP));
+	heap->ctx = ctx;
+	heap->numNodes = 1; /* Skip the null index */
+	heap->numNames = 1; /* Skip the null name ID */
+
+	return heap;
+}
+
+void freeCompactHeap(COMPACT_HEAP * heap) {
+	LC_CONTEXT * ctx = heap->ctx;
+
+	countedFree(&ctx->compactExprCounts, heap->nodes);
+	countedFree(&ctx->compactExprCounts, heap->names);
+	countedFree(&ctx->compactExprCounts, heap->nameTable);
+	countedFree(&ctx->compactExprCounts, heap);
+}
+
+static COMPACT_EXPR allocateCompactNode(COMPACT_HEAP * heap, int type, unsigned int nameId, COMPACT_EXPR expr, COMPACT_EXPR expr2) {
+	COMPACT_EXPR result;
+
+	if (heap->freeList != 0) {
+		result = heap->freeList;
+		heap->freeList = heap->nodes[result].expr;
+		--heap->numFreeNodes;
+	} else {
+
+		if (heap->numNodes >= heap->capacity) {
+			heap->capacity = (heap->capacity == 0) ? 1024 : 2 * heap->capacity;
+			heap->nodes = (COMPACT_NODE *)countedRealloc(&heap->ctx->compactExprCounts, heap->nodes, heap->capacity * sizeof(COMPACT_NODE));
+		}
+
+		result = heap->numNodes++;
+	}
+
+	COMPACT_NODE * node = &heap->nodes[result];
+
+	node->header = (nameId << compactNameIdShift) | (unsigned int)type;
+	node->expr = expr;
+	node->expr2 = expr2;
+
+	return result;
+}
+
+/* **** Interned names **** */
+
+static unsigned int hashName(char * name) {
+	/* FNV-1a */
+	unsigned int h = 2166136261U;
+
+	for (; *name != '\0'; ++name) {
+		h = (h ^ (unsigned char)*name) * 16777619U;
+	}
+
+	return h;
+}
+
+static unsigned int * findNameTableSlot(COMPACT_HEAP * heap, char * name) {
+	/* Returns the slot holding the ID of name, or the empty slot where it belongs */
+	unsigned int i = hashName(name) & (heap->nameTableCapacity - 1);
+
+	while (heap->nameTable[i] != 0 && strcmp(heap->names[heap->nameTable[i]], name)) {
+		i = (i + 1) & (heap->nameTableCapacity - 1);
+	}
+
+	return &heap->nameTable[i];
+}
+
+static void growNameTable(COMPACT_HEAP * heap) {
+	unsigned int id;
+
+	countedFree(&heap->ctx->compactExprCounts, heap->nameTable);
+
+	heap->nameTableCapacity = (heap->nameTableCapacity == 0) ? 256 : 2 * heap->nameTableCapacity;
+	heap->nameTable = (unsigned int *)countedCalloc(&heap->ctx->compactExprCounts, heap->nameTableCapacity, sizeof(unsigned int));
+
+	for (id = 1; id < heap->numNames; ++id) {
+		*findNameTableSlot(heap, heap->names[id]) = id;
+	}
+}
+
+unsigned int internName(COMPACT_HEAP * heap, char * name) {
+	/* Returns the ID of name, adding it to the table if necessary */
+
+	if (strlen(name) >= maxStringValueLength - 1) {
+		fprintf(stderr, "internName() : The name '%s' is too long.\n", name);
+		return 0;
+	}
+
+	if (2 * heap->numNames >= heap->nameTableCapacity) {
+		growNameTable(heap);
+	}
+
+	unsigned int * slot = findNameTableSlot(heap, name);
+
+	if (*slot != 0) {
+		return *slot;
+	} else if (heap->numNames > maxCompactNameId) {
+		fprintf(stderr, "internName() : Too many names\n");
+		return 0;
+	}
+
+	if (heap->numNames >= heap->namesCapacity) {
+		heap->namesCapacity = (heap->namesCapacity == 0) ? 128 : 2 * heap->namesCapacity;
+		heap->names = (char (*)[maxStringValueLength])countedRealloc(&heap->ctx->compactExprCounts, heap->names, heap->namesCapacity * maxStringValueLength);
+	}
+
+	memset(heap->names[heap->numNames], 0, maxStringValueLength);
+	strcpy(heap->names[heap->numNames], name);
+	*slot = heap->numNames;
+
+	return heap->numNames++;
+}
+
+/* **** Accessors **** */
+
+int getCompactType(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	return (int)(heap->nodes[expr].header & compactTypeMask);
+}
+
+unsigned int getCompactNameId(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	return heap->nodes[expr].header >> compactNameIdShift;
+}
+
+char * getCompactName(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	/* Returns "" for a node without a name */
+	return heap->names[getCompactNameId(heap, expr)];
+}
+
+COMPACT_EXPR getCompactExpr(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	return heap->nodes[expr].expr;
+}
+
+COMPACT_EXPR getCompactExpr2(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	return heap->nodes[expr].expr2;
+}
+
+long getCompactValue(COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+	const unsigned long u = ((unsigned long)heap->nodes[expr].expr2 << 32) | heap->nodes[expr].expr;
+
+	return (long)u;
+}
+
+/* **** Create functions **** */
+
+COMPACT_EXPR createCompactVariable(COMPACT_HEAP * heap, char * name) {
+	const unsigned int nameId = internName(heap, name);
+
+	return (nameId == 0) ? 0 : allocateCompactNode(heap, lcExpressionType_Variable, nameId, 0, 0);
+}
+
+COMPACT_EXPR createCompactLambdaExpr(COMPACT_HEAP * heap, char * argName, COMPACT_EXPR body) {
+	const unsigned int nameId = internName(heap, argName);
+
+	return (nameId == 0) ? 0 : allocateCompactNode(heap, lcExpressionType_LambdaExpr, nameId, body, 0);
+}
+
+COMPACT_EXPR createCompactFunctionCall(COMPACT_HEAP * heap, COMPACT_EXPR expr, COMPACT_EXPR expr2) {
+	return allocateCompactNode(heap, lcExpressionType_FunctionCall, 0, expr, expr2);
+}
+
+COMPACT_EXPR createCompactIntegerLiteral(COMPACT_HEAP * heap, long value) {
+	const unsigned long u = (unsigned long)value;
+
+	return allocateCompactNode(heap, lcExpressionType_IntegerLiteral, 0, (COMPACT_EXPR)u, (COMPACT_EXPR)(u >> 32));
+}
+
+/* **** Conversions **** */
+
+COMPACT_EXPR toCompactExpr(COMPACT_HEAP * heap, LC_EXPR * expr) {
+	COMPACT_EXPR e1;
+	COMPACT_EXPR e2;
+	long i;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+			return createCompactVariable(heap, expr->name);
+
+		case lcExpressionType_LambdaExpr:
+			return createCompactLambdaExpr(heap, expr->name, toCompactExpr(heap, expr->expr));
+
+		case lcExpressionType_FunctionCall:
+			e1 = toCompactExpr(heap, expr->expr);
+
+			return createCompactFunctionCall(heap, e1, toCompactExpr(heap, expr->expr2));
+
+		case lcExpressionType_Iteration:
+			/* Expanded, with f shared by its applications */
+			e1 = toCompactExpr(heap, expr->expr);
+			e2 = toCompactExpr(heap, expr->expr2);
+
+			for (i = 0; i < expr->value; ++i) {
+				e2 = createCompactFunctionCall(heap, e1, e2);
+			}
+
+			return e2;
+
+		case lcExpressionType_IntegerLiteral:
+			return createCompactIntegerLiteral(heap, expr->value);
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+LC_EXPR * fromCompactExpr(LC_CONTEXT * ctx, COMPACT_HEAP * heap, COMPACT_EXPR expr) {
+
+	switch (getCompactType(heap, expr)) {
+		case lcExpressionType_Variable:
+			return createVariable(ctx, getCompactName(heap, expr));
+
+		case lcExpressionType_LambdaExpr:
+			return createLambdaExpr(ctx, getCompactName(heap, expr), fromCompactExpr(ctx, heap, getCompactExpr(heap, expr)));
+
+		case lcExpressionType_FunctionCall:
+			return createFunctionCall(ctx,
+				fromCompactExpr(ctx, heap, getCompactExpr(heap, expr)),
+				fromCompactExpr(ctx, heap, getCompactExpr2(heap, expr)));
+
+		case lcExpressionType_IntegerLiteral:
+			return createIntegerLiteral(ctx, getCompactValue(heap, expr));
+
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+/* **** Garbage collection **** */
+
+void collectCompactGarbage(COMPACT_HEAP * heap, COMPACT_EXPR exprTreesToMark[]) {
+	/* exprTreesToMark is terminated by 0. Mark iteratively, visiting each
+	node once even if it is shared, then sweep the unmarked nodes onto the
+	free list. */
+	COMPACT_EXPR * stack = NULL;
+	int stackSize = 0;
+	int stackCapacity = 0;
+	COMPACT_EXPR e;
+	int i;
+
+	for (i = 0; exprTreesToMark[i] != 0; ++i) {
+
+		if (stackSize == stackCapacity) {
+			stackCapacity = (stackCapacity == 0) ? 256 : 2 * stackCapacity;
+			stack = (COMPACT_EXPR *)countedRealloc(&heap->ctx->compactExprCounts, stack, stackCapacity * sizeof(COMPACT_EXPR));
+		}
+
+		stack[stackSize++] = exprTreesToMark[i];
+
+		while (stackSize > 0) {
+			e = stack[--stackSize];
+
+			const unsigned int header = heap->nodes[e].header;
+			const int type = (int)(header & compactTypeMask);
+
+			if (header & compactMarkBit) {
+				continue;
+			}
+
+			heap->nodes[e].header = header | compactMarkBit;
+
+			if (type != lcExpressionType_LambdaExpr && type != lcExpressionType_FunctionCall) {
+				continue;
+			}
+
+			if (stackSize + 2 > stackCapacity) {
+				stackCapacity = 2 * stackCapacity;
+				stack = (COMPACT_EXPR *)countedRealloc(&heap->ctx->compactExprCounts, stack, stackCapacity * sizeof(COMPACT_EXPR));
+			}
+
+			if (type == lcExpressionType_FunctionCall) {
+				stack[stackSize++] = heap->nodes[e].expr2;
+			}
+
+			stack[stackSize++] = heap->nodes[e].expr;
+		}
+	}
+
+	countedFree(&heap->ctx->compactExprCounts, stack);
+
+	/* Sweep, from the top down, so that the free list is in increasing order */
+	heap->freeList = 0;
+	heap->numFreeNodes = 0;
+
+	for (e = heap->numNodes - 1; e > 0; --e) {
+		COMPACT_NODE * node = &heap->nodes[e];
+
+		if (node->header & compactMarkBit) {
+			node->header &= ~compactMarkBit;
+		} else {
+			node->header = compactExpressionType_Free;
+			node->expr = heap->freeList;
+			node->expr2 = 0;
+			heap->freeList = e;
+			++heap->numFreeNodes;
+		}
+	}
+}
+
+unsigned int getNumLiveCompactNodes(COMPACT_HEAP * heap) {
+	return heap->numNodes - 1 - heap->numFreeNodes;
+}
+
+/* **** de Bruijn indices (see de-bruijn.c) **** */
+
+static int compactDeBruijnAppendString(char * buf, int bufSize, int i, char * str) {
+	int newi = i + strlen(str);
+
+	if (newi >= bufSize) {
+		fprintf(stderr, "compactDeBruijnAppendString() error: Not enough buffer space to append '%s' to '%s'\n", str, buf);
+
+		return i;
+	}
+
+	strcpy(buf + i, str);
+
+	return newi;
+}
+
+static int getCompactDeBruijnIndexLocal(COMPACT_HEAP * heap, COMPACT_EXPR expr, char * buf, int bufSize, int i, COMPACT_BINDER_STACK * binders) {
+	const unsigned int nameId = getCompactNameId(heap, expr);
+	char numBuf[24];
+	int n;
+
+	switch (getCompactType(heap, expr)) {
+		case lcExpressionType_Variable:
+
+			for (n = binders->size - 1; n >= 0 && binders->ids[n] != nameId; --n) {
+			}
+
+			if (n >= 0) {
+				n = binders->size - n;
+
+				if (n < 1000 && bufSize - i > 3) {
+					sprintf(buf + i, "%d", n);
+					i = strlen(buf);
+				} else {
+					fprintf(stderr, "getCompactDeBruijnIndexLocal() error: Not enough buffer space to append number '%d' to '%s'\n", n, buf);
+				}
+			} else {
+				i = compactDeBruijnAppendString(buf, bufSize, i, getCompactName(heap, expr));
+			}
+
+			break;
+
+		case lcExpressionType_LambdaExpr:
+			i = compactDeBruijnAppendString(buf, bufSize, i, "λ");
+
+			if (binders->size == binders->capacity) {
+				binders->capacity = (binders->capacity == 0) ? 64 : 2 * binders->capacity;
+				binders->ids = (unsigned int *)countedRealloc(&heap->ctx->compactExprCounts, binders->ids, binders->capacity * sizeof(unsigned int));
+			}
+
+			binders->ids[binders->size++] = nameId;
+			i = getCompactDeBruijnIndexLocal(heap, getCompactExpr(heap, expr), buf, bufSize, i, binders);
+			--binders->size;
+			break;
+
+		case lcExpressionType_FunctionCall:
+			i = compactDeBruijnAppendString(buf, bufSize, i, "(");
+			i = getCompactDeBruijnIndexLocal(heap, getCompactExpr(heap, expr), buf, bufSize, i, binders);
+			i = compactDeBruijnAppendString(buf, bufSize, i, " ");
+			i = getCompactDeBruijnIndexLocal(heap, getCompactExpr2(heap, expr), buf, bufSize, i, binders);
+			i = compactDeBruijnAppendString(buf, bufSize, i, ")");
+			break;
+
+		case lcExpressionType_IntegerLiteral:
+			snprintf(numBuf, sizeof(numBuf), "#%ld", getCompactValue(heap, expr));
+			i = compactDeBruijnAppendString(buf, bufSize, i, numBuf);
+			break;
+
+		default:
+			break;
+	}
+
+	return i;
+}
+
+int getCompactDeBruijnIndex(COMPACT_HEAP * heap, COMPACT_EXPR expr, char * buf, int bufSize) {
+	COMPACT_BINDER_STACK binders = { NULL, 0, 0 };
+
+	memset(buf, 0, bufSize);
+
+	const int result = getCompactDeBruijnIndexLocal(heap, expr, buf, bufSize, 0, &binders);
+
+	countedFree(&heap->ctx->compactExprCounts, binders.ids);
+
+	return result;
+}
+
+/* **** The End **** */
@@ -0,0 +1,56 @@
+/* facility/src/compact-expr.h */
+
+/* A compact alternative layout for Lambda calculus expressions; see
+ * compact-expr.c */
+
+typedef unsigned int COMPACT_EXPR; /* An index into heap->nodes; 0 is null */
+
+typedef struct {
+	unsigned int header; /* Bits 0-2: type; bit 3: mark; bits 4-31: name ID */
+	COMPACT_EXPR expr; /* Used for LambdaExpr and FunctionCall */
+	COMPACT_EXPR expr2; /* Used for FunctionCall */
+} COMPACT_NODE; /* 12 bytes. An IntegerLiteral keeps its value in expr and expr2. */
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	COMPACT_NODE * nodes; /* nodes[0] is unused, so that 0 can be null */
+	unsigned int numNodes; /* Including nodes[0] and the free nodes */
+	unsigned int capacity;
+	COMPACT_EXPR freeList; /* Linked through expr */
+	unsigned int numFreeNodes;
+
+	/* The interned names, indexed by name ID; ID 0 is unused */
+	char (* names)[maxStringValueLength];
+	unsigned int numNames; /* Including ID 0 */
+	unsigned int namesCapacity;
+	unsigned int * nameTable; /* Open addressing: name IDs, or 0 if empty */
+	unsigned int nameTableCapacity; /* A power of 2 */
+} COMPACT_HEAP;
+
+void printCompactExprMemMgrReport(LC_CONTEXT * ctx);
+
+COMPACT_HEAP * createCompactHeap(LC_CONTEXT * ctx);
+void freeCompactHeap(COMPACT_HEAP * heap);
+unsigned int internName(COMPACT_HEAP * heap, char * name);
+
+int getCompactType(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+unsigned int getCompactNameId(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+char * getCompactName(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+COMPACT_EXPR getCompactExpr(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+COMPACT_EXPR getCompactExpr2(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+long getCompactValue(COMPACT_HEAP * heap, COMPACT_EXPR expr);
+
+COMPACT_EXPR createCompactVariable(COMPACT_HEAP * heap, char * name);
+COMPACT_EXPR createCompactLambdaExpr(COMPACT_HEAP * heap, char * argName, COMPACT_EXPR body);
+COMPACT_EXPR createCompactFunctionCall(COMPACT_HEAP * heap, COMPACT_EXPR expr, COMPACT_EXPR expr2);
+COMPACT_EXPR createCompactIntegerLiteral(COMPACT_HEAP * heap, long value);
+
+COMPACT_EXPR toCompactExpr(COMPACT_HEAP * heap, LC_EXPR * expr);
+LC_EXPR * fromCompactExpr(LC_CONTEXT * ctx, COMPACT_HEAP * heap, COMPACT_EXPR expr);
+
+void collectCompactGarbage(COMPACT_HEAP * heap, COMPACT_EXPR exprTreesToMark[]);
+unsigned int getNumLiveCompactNodes(COMPACT_HEAP * heap);
+
+int getCompactDeBruijnIndex(COMPACT_HEAP * heap, COMPACT_EXPR expr, char * buf, int bufSize);
+
+/* **** The End **** */
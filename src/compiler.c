@@ -0,0 +1,729 @@
+/* facility/src/compiler.c */
+
+/* Ahead-of-time compilation of lambda terms to C (facility -c out.c file).
+ *
+ * Each line of the input file is parsed and closure-converted: every lambda
+ * becomes a C function of its argument and of an environment that holds the
+ * values of the lambda's free variables, and every argument that is itself
+ * an application becomes a thunk, a function of an environment that is
+ * called when the argument's value is first needed and then remembered
+ * (call-by-need, so a discarded argument such as Ω costs nothing). The
+ * functions are lifted to the top level of the output, after a small
+ * runtime (runtimeSource below) that allocates closures and thunks, applies
+ * them, and reads a value back to a printable lambda term: applying a
+ * closure to a fresh variable gives its body, which is read back in turn
+ * (normalization by evaluation). The result is η-reduced, like the
+ * interpreter's.
+ *
+ * The output needs nothing but the C library:
+ *
+ *	$ ./facility -c out.c expressions.txt
+ *	$ gcc -O2 -o out out.c
+ *	$ ./out
+ *
+ * prints the normal form of each line, one per line, as ./facility -b does
+ * (up to the names of the bound variables). A term with no normal form makes
+ * the program run until it runs out of memory or stack. δ-reduction is not
+ * supported. See tools/aot-bench.sh for a comparison with the interpreter. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+#include "create-and-destroy.h"
+
+#include "batch.h"
+#include "compiler.h"
+#include "parser.h"
+
+typedef struct {
+	char * buf;
+	int len;
+	int capacity;
+} CODE_BUFFER;
+
+typedef struct {
+	char * name;
+	char cExpr[32]; /* "arg" or "env[i]" */
+} SCOPE_ENTRY;
+
+typedef struct {
+	SCOPE_ENTRY * entries; /* The innermost binding of a name is the last */
+	int size;
+} SCOPE;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	FILE * fp;
+	int numFunctions;
+	char ** freeVariableNames;
+	int numFreeVariables;
+	int freeVariablesCapacity;
+	char ** boundNames; /* A stack, while looking for captured variables */
+	int numBoundNames;
+	int boundNamesCapacity;
+	BOOL failed;
+} COMPILER;
+
+static const char * runtimeSource[] = {
+	"/* The runtime of a program compiled by facility -c; see compiler.c */",
+	"",
+	"#include <stdlib.h>",
+	"#include <stdio.h>",
+	"#include <string.h>",
+	"",
+	"typedef struct RT_VALUE_STRUCT RT_VALUE;",
+	"typedef RT_VALUE * (* RT_CODE)(RT_VALUE ** env, RT_VALUE * arg);",
+	"",
+	"typedef enum {",
+	"\trtClosure, /* A lambda: code and the values of its free variables */",
+	"\trtThunk, /* An argument, evaluated when it is first needed */",
+	"\trtNeutral /* A variable, applied to zero or more arguments */",
+	"} RtValueType;",
+	"",
+	"struct RT_VALUE_STRUCT {",
+	"\tRtValueType type;",
+	"\tRT_CODE code; /* Of a closure or thunk */",
+	"\tconst char * name; /* Of a closure's variable, or of a free variable */",
+	"\tint level; /* Of a bound variable, during the read-back; -1 if free */",
+	"\tRT_VALUE * fn; /* The value of a forced thunk, or the callee of a neutral application */",
+	"\tRT_VALUE * arg; /* The argument of a neutral application */",
+	"\tRT_VALUE * env[]; /* Of a closure or thunk */",
+	"};",
+	"",
+	"typedef enum {",
+	"\trtVariable,",
+	"\trtLambda,",
+	"\trtApplication",
+	"} RtTermType;",
+	"",
+	"typedef struct RT_TERM_STRUCT {",
+	"\tRtTermType type;",
+	"\tint level; /* Of a variable or lambda; -1 for a free variable */",
+	"\tconst char * name;",
+	"\tstruct RT_TERM_STRUCT * t1; /* The body of a lambda, or the callee */",
+	"\tstruct RT_TERM_STRUCT * t2; /* The argument */",
+	"} RT_TERM;",
+	"",
+	"/* Nothing is freed before the program exits */",
+	"#define rtChunkSize (1 << 20)",
+	"",
+	"static char * rtChunk = NULL;",
+	"static size_t rtChunkUsed = rtChunkSize;",
+	"static RT_VALUE ** rtFreeVariables;",
+	"static int rtNumFreeVariables;",
+	"",
+	"static void * rtAlloc(size_t size) {",
+	"\tvoid * ptr;",
+	"",
+	"\tsize = (size + 15) & ~(size_t)15;",
+	"",
+	"\tif (size > rtChunkSize / 16) {",
+	"\t\tptr = malloc(size);",
+	"\t} else {",
+	"",
+	"\t\tif (rtChunkUsed + size > rtChunkSize) {",
+	"\t\t\trtChunk = (char *)malloc(rtChunkSize);",
+	"\t\t\trtChunkUsed = 0;",
+	"\t\t}",
+	"",
+	"\t\tptr = (rtChunk != NULL) ? rtChunk + rtChunkUsed : NULL;",
+	"\t\trtChunkUsed += size;",
+	"\t}",
+	"",
+	"\tif (ptr == NULL) {",
+	"\t\tfprintf(stderr, \"rtAlloc() : Out of memory\\n\");",
+	"\t\texit(1);",
+	"\t}",
+	"",
+	"\treturn ptr;",
+	"}",
+	"",
+	"static RT_VALUE * rtCreateValue(RtValueType type, RT_CODE code, const char * name, int level, int numEnv) {",
+	"\tRT_VALUE * v = (RT_VALUE *)rtAlloc(sizeof(RT_VALUE) + numEnv * sizeof(RT_VALUE *));",
+	"",
+	"\tv->type = type;",
+	"\tv->code = code;",
+	"\tv->name = name;",
+	"\tv->level = level;",
+	"\tv->fn = NULL;",
+	"\tv->arg = NULL;",
+	"",
+	"\treturn v;",
+	"}",
+	"",
+	"static RT_VALUE * rtCreateClosure(RT_CODE code, const char * name, int numEnv, RT_VALUE ** env) {",
+	"\tRT_VALUE * v = rtCreateValue(rtClosure, code, name, -1, numEnv);",
+	"\tint i;",
+	"",
+	"\tfor (i = 0; i < numEnv; ++i) {",
+	"\t\tv->env[i] = env[i];",
+	"\t}",
+	"",
+	"\treturn v;",
+	"}",
+	"",
+	"static RT_VALUE * rtCreateThunk(RT_CODE code, int numEnv, RT_VALUE ** env) {",
+	"\tRT_VALUE * v = rtCreateValue(rtThunk, code, NULL, -1, numEnv);",
+	"\tint i;",
+	"",
+	"\tfor (i = 0; i < numEnv; ++i) {",
+	"\t\tv->env[i] = env[i];",
+	"\t}",
+	"",
+	"\treturn v;",
+	"}",
+	"",
+	"static RT_VALUE * rtForce(RT_VALUE * v) {",
+	"",
+	"\tif (v->type != rtThunk) {",
+	"\t\treturn v;",
+	"\t}",
+	"",
+	"\tif (v->fn == NULL) {",
+	"\t\tv->fn = rtForce(v->code(v->env, NULL));",
+	"\t}",
+	"",
+	"\treturn v->fn;",
+	"}",
+	"",
+	"static RT_VALUE * rtApply(RT_VALUE * f, RT_VALUE * a) {",
+	"\tf = rtForce(f);",
+	"",
+	"\tif (f->type == rtClosure) {",
+	"\t\treturn f->code(f->env, a);",
+	"\t}",
+	"",
+	"\tRT_VALUE * v = rtCreateValue(rtNeutral, NULL, NULL, -1, 0);",
+	"",
+	"\tv->fn = f;",
+	"\tv->arg = a;",
+	"",
+	"\treturn v;",
+	"}",
+	"",
+	"/* **** The read-back: normalization by evaluation **** */",
+	"",
+	"static RT_TERM * rtCreateTerm(RtTermType type, int level, const char * name, RT_TERM * t1, RT_TERM * t2) {",
+	"\tRT_TERM * t = (RT_TERM *)rtAlloc(sizeof(RT_TERM));",
+	"",
+	"\tt->type = type;",
+	"\tt->level = level;",
+	"\tt->name = name;",
+	"\tt->t1 = t1;",
+	"\tt->t2 = t2;",
+	"",
+	"\treturn t;",
+	"}",
+	"",
+	"static int rtOccurs(RT_TERM * t, int level) {",
+	"",
+	"\tswitch (t->type) {",
+	"\t\tcase rtVariable:",
+	"\t\t\treturn t->level == level;",
+	"",
+	"\t\tcase rtLambda:",
+	"\t\t\treturn rtOccurs(t->t1, level);",
+	"",
+	"\t\tdefault:",
+	"\t\t\treturn rtOccurs(t->t1, level) || rtOccurs(t->t2, level);",
+	"\t}",
+	"}",
+	"",
+	"static RT_TERM * rtReadBack(RT_VALUE * v, int level) {",
+	"\tv = rtForce(v);",
+	"",
+	"\tif (v->type == rtClosure) {",
+	"\t\tRT_VALUE * x = rtCreateValue(rtNeutral, NULL, v->name, level, 0);",
+	"\t\tRT_TERM * body = rtReadBack(v->code(v->env, x), level + 1);",
+	"",
+	"\t\t/* η-reduction: λx.(f x) is f if x does not occur in f */",
+	"",
+	"\t\tif (body->type == rtApplication && body->t2->type == rtVariable &&",
+	"\t\t\tbody->t2->level == level && !rtOccurs(body->t1, level)) {",
+	"\t\t\treturn body->t1;",
+	"\t\t}",
+	"",
+	"\t\treturn rtCreateTerm(rtLambda, level, v->name, body, NULL);",
+	"\t} else if (v->fn == NULL) {",
+	"\t\treturn rtCreateTerm(rtVariable, v->level, v->name, NULL, NULL);",
+	"\t}",
+	"",
+	"\tRT_TERM * callee = rtReadBack(v->fn, level);",
+	"",
+	"\treturn rtCreateTerm(rtApplication, -1, NULL, callee, rtReadBack(v->arg, level));",
+	"}",
+	"",
+	"static int rtIsNameTaken(const char * name, const char ** names, int level, const char ** freeNames, int numFreeNames) {",
+	"\tint i;",
+	"",
+	"\tfor (i = 0; i < level; ++i) {",
+	"",
+	"\t\tif (!strcmp(names[i], name)) {",
+	"\t\t\treturn 1;",
+	"\t\t}",
+	"\t}",
+	"",
+	"\tfor (i = 0; i < numFreeNames; ++i) {",
+	"",
+	"\t\tif (!strcmp(freeNames[i], name)) {",
+	"\t\t\treturn 1;",
+	"\t\t}",
+	"\t}",
+	"",
+	"\treturn 0;",
+	"}",
+	"",
+	"static int rtCollectFreeNames(RT_TERM * t, const char ** freeNames, int numFreeNames) {",
+	"\t/* freeNames has room for all rtNumFreeVariables names */",
+	"\tint i;",
+	"",
+	"\tswitch (t->type) {",
+	"\t\tcase rtVariable:",
+	"",
+	"\t\t\tif (t->level >= 0) {",
+	"\t\t\t\tbreak;",
+	"\t\t\t}",
+	"",
+	"\t\t\tfor (i = 0; i < numFreeNames && strcmp(freeNames[i], t->name); ++i) {",
+	"\t\t\t}",
+	"",
+	"\t\t\tif (i == numFreeNames) {",
+	"\t\t\t\tfreeNames[numFreeNames++] = t->name;",
+	"\t\t\t}",
+	"",
+	"\t\t\tbreak;",
+	"",
+	"\t\tcase rtLambda:",
+	"\t\t\treturn rtCollectFreeNames(t->t1, freeNames, numFreeNames);",
+	"",
+	"\t\tdefault:",
+	"\t\t\tnumFreeNames = rtCollectFreeNames(t->t1, freeNames, numFreeNames);",
+	"\t\t\treturn rtCollectFreeNames(t->t2, freeNames, numFreeNames);",
+	"\t}",
+	"",
+	"\treturn numFreeNames;",
+	"}",
+	"",
+	"static void rtPrintTerm(RT_TERM * t, const char ** names, int level, const char ** freeNames, int numFreeNames) {",
+	"\t/* names[i] is the name chosen for the lambda at level i. A lambda keeps",
+	"\tits own name unless that could capture a variable. */",
+	"\tstatic int numGeneratedNames = 0;",
+	"",
+	"\tswitch (t->type) {",
+	"\t\tcase rtVariable:",
+	"\t\t\tfputs((t->level < 0) ? t->name : names[t->level], stdout);",
+	"\t\t\tbreak;",
+	"",
+	"\t\tcase rtLambda:",
+	"",
+	"\t\t\tif (rtIsNameTaken(t->name, names, level, freeNames, numFreeNames)) {",
+	"\t\t\t\tchar * buf = (char *)rtAlloc(16);",
+	"",
+	"\t\t\t\tdo {",
+	"\t\t\t\t\tsprintf(buf, \"v%d\", ++numGeneratedNames);",
+	"\t\t\t\t} while (rtIsNameTaken(buf, names, level, freeNames, numFreeNames));",
+	"",
+	"\t\t\t\tnames[level] = buf;",
+	"\t\t\t} else {",
+	"\t\t\t\tnames[level] = t->name;",
+	"\t\t\t}",
+	"",
+	"\t\t\tprintf(\"λ%s.\", names[level]);",
+	"\t\t\trtPrintTerm(t->t1, names, level + 1, freeNames, numFreeNames);",
+	"\t\t\tbreak;",
+	"",
+	"\t\tdefault:",
+	"\t\t\tputchar('(');",
+	"\t\t\trtPrintTerm(t->t1, names, level, freeNames, numFreeNames);",
+	"\t\t\tputchar(' ');",
+	"\t\t\trtPrintTerm(t->t2, names, level, freeNames, numFreeNames);",
+	"\t\t\tputchar(')');",
+	"\t\t\tbreak;",
+	"\t}",
+	"}",
+	"",
+	"static int rtGetDepth(RT_TERM * t) {",
+	"",
+	"\tswitch (t->type) {",
+	"\t\tcase rtVariable:",
+	"\t\t\treturn 0;",
+	"",
+	"\t\tcase rtLambda:",
+	"\t\t\treturn 1 + rtGetDepth(t->t1);",
+	"",
+	"\t\tdefault: {",
+	"\t\t\tconst int d1 = rtGetDepth(t->t1);",
+	"\t\t\tconst int d2 = rtGetDepth(t->t2);",
+	"",
+	"\t\t\treturn (d1 > d2) ? d1 : d2;",
+	"\t\t}",
+	"\t}",
+	"}",
+	"",
+	"static void rtPrintResult(RT_VALUE * v) {",
+	"\tRT_TERM * t = rtReadBack(v, 0);",
+	"\tconst char ** names = (const char **)rtAlloc((rtGetDepth(t) + 1) * sizeof(const char *));",
+	"\tconst char ** freeNames = (const char **)rtAlloc((rtNumFreeVariables + 1) * sizeof(const char *));",
+	"\tconst int numFreeNames = rtCollectFreeNames(t, freeNames, 0);",
+	"",
+	"\trtPrintTerm(t, names, 0, freeNames, numFreeNames);",
+	"\tputchar('\\n');",
+	"}",
+	"",
+	"static void rtInit(const char ** freeVariableNames, int numFreeVariables) {",
+	"\tint i;",
+	"",
+	"\trtNumFreeVariables = numFreeVariables;",
+	"\trtFreeVariables = (RT_VALUE **)rtAlloc((numFreeVariables + 1) * sizeof(RT_VALUE *));",
+	"",
+	"\tfor (i = 0; i < numFreeVariables; ++i) {",
+	"\t\trtFreeVariables[i] = rtCreateValue(rtNeutral, NULL, freeVariableNames[i], -1, 0);",
+	"\t}",
+	"}",
+	"",
+	"/* **** The compiled program **** */",
+	NULL
+};
+
+void printCompilerMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Compiler", &ctx->compilerCounts);
+}
+
+static void * compilerRealloc(COMPILER * compiler, void * ptr, size_t size) {
+	return countedRealloc(&compiler->ctx->compilerCounts, ptr, size);
+}
+
+static void compilerFree(COMPILER * compiler, void * ptr) {
+	countedFree(&compiler->ctx->compilerCounts, ptr);
+}
+
+/* **** Code buffers **** */
+
+static void appendCode(COMPILER * compiler, CODE_BUFFER * cb, char * format, ...) {
+	va_list args;
+
+	va_start(args, format);
+
+	const int n = vsnprintf(NULL, 0, format, args);
+
+	va_end(args);
+
+	if (cb->len + n + 1 > cb->capacity) {
+
+		while (cb->len + n + 1 > cb->capacity) {
+			cb->capacity = (cb->capacity == 0) ? 256 : 2 * cb->capacity;
+		}
+
+		cb->buf = (char *)compilerRealloc(compiler, cb->buf, cb->capacity);
+	}
+
+	va_start(args, format);
+	vsnprintf(cb->buf + cb->len, n + 1, format, args);
+	va_end(args);
+	cb->len += n;
+}
+
+/* **** Closure conversion **** */
+
+static int lookUpScope(SCOPE * scope, char * name) {
+	int i;
+
+	for (i = scope->size - 1; i >= 0; --i) {
+
+		if (!strcmp(scope->entries[i].name, name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static int getFreeVariableIndex(COMPILER * compiler, char * name) {
+	int i;
+
+	for (i = 0; i < compiler->numFreeVariables; ++i) {
+
+		if (!strcmp(compiler->freeVariableNames[i], name)) {
+			return i;
+		}
+	}
+
+	if (compiler->numFreeVariables == compiler->freeVariablesCapacity) {
+		compiler->freeVariablesCapacity = (compiler->freeVariablesCapacity == 0) ? 16 : 2 * compiler->freeVariablesCapacity;
+		compiler->freeVariableNames = (char **)compilerRealloc(compiler, compiler->freeVariableNames, compiler->freeVariablesCapacity * sizeof(char *));
+	}
+
+	compiler->freeVariableNames[compiler->numFreeVariables] = name;
+
+	return compiler->numFreeVariables++;
+}
+
+static BOOL isBoundName(COMPILER * compiler, char * name) {
+	int i;
+
+	for (i = 0; i < compiler->numBoundNames; ++i) {
+
+		if (!strcmp(compiler->boundNames[i], name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void findCapturedVariables(COMPILER * compiler, LC_EXPR * expr, SCOPE * scope, int * captured, int * numCaptured) {
+	/* Adds to captured[] the index in scope of each variable that occurs
+	free in expr and is bound in scope, each once */
+	int i;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+
+			if (!isBoundName(compiler, expr->name)) {
+				const int index = lookUpScope(scope, expr->name);
+
+				if (index < 0) {
+					break;
+				}
+
+				for (i = 0; i < *numCaptured && captured[i] != index; ++i) {
+				}
+
+				if (i == *numCaptured) {
+					captured[(*numCaptured)++] = index;
+				}
+			}
+
+			break;
+
+		case lcExpressionType_LambdaExpr:
+
+			if (compiler->numBoundNames == compiler->boundNamesCapacity) {
+				compiler->boundNamesCapacity = (compiler->boundNamesCapacity == 0) ? 64 : 2 * compiler->boundNamesCapacity;
+				compiler->boundNames = (char **)compilerRealloc(compiler, compiler->boundNames, compiler->boundNamesCapacity * sizeof(char *));
+			}
+
+			compiler->boundNames[compiler->numBoundNames++] = expr->name;
+			findCapturedVariables(compiler, expr->expr, scope, captured, numCaptured);
+			--compiler->numBoundNames;
+			break;
+
+		case lcExpressionType_FunctionCall:
+			findCapturedVariables(compiler, expr->expr, scope, captured, numCaptured);
+			findCapturedVariables(compiler, expr->expr2, scope, captured, numCaptured);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void compileExpr(COMPILER * compiler, LC_EXPR * expr, SCOPE * scope, CODE_BUFFER * cb);
+
+static void compileFunction(COMPILER * compiler, LC_EXPR * expr, SCOPE * scope, CODE_BUFFER * cb) {
+	/* Lift expr, a lambda or (for a thunk) an application, to a C function
+	of an environment, and append the code that creates its closure or
+	thunk in scope to cb */
+	const BOOL isLambda = expr->type == lcExpressionType_LambdaExpr;
+	const int n = compiler->numFunctions++;
+	int * captured = (int *)compilerRealloc(compiler, NULL, (scope->size + 1) * sizeof(int));
+	int numCaptured = 0;
+	SCOPE innerScope;
+	CODE_BUFFER body = { NULL, 0, 0 };
+	int i;
+
+	findCapturedVariables(compiler, expr, scope, captured, &numCaptured);
+
+	innerScope.entries = (SCOPE_ENTRY *)compilerRealloc(compiler, NULL, (numCaptured + 1) * sizeof(SCOPE_ENTRY));
+	innerScope.size = 0;
+
+	for (i = 0; i < numCaptured; ++i) {
+		SCOPE_ENTRY * entry = &innerScope.entries[innerScope.size++];
+
+		entry->name = scope->entries[captured[i]].name;
+		sprintf(entry->cExpr, "env[%d]", i);
+	}
+
+	if (isLambda) {
+		innerScope.entries[innerScope.size].name = expr->name;
+		strcpy(innerScope.entries[innerScope.size++].cExpr, "arg");
+	}
+
+	compileExpr(compiler, isLambda ? expr->expr : expr, &innerScope, &body);
+
+	/* The inner functions have been written out already */
+	fprintf(compiler->fp, "static RT_VALUE * %s_%d(RT_VALUE ** env, RT_VALUE * arg) {\n\t(void)env;\n\t(void)arg;\n\treturn %s;\n}\n\n",
+		isLambda ? "lambda" : "thunk", n, (body.buf != NULL) ? body.buf : "NULL");
+
+	if (isLambda) {
+		appendCode(compiler, cb, "rtCreateClosure(lambda_%d, \"%s\", %d, ", n, expr->name, numCaptured);
+	} else {
+		appendCode(compiler, cb, "rtCreateThunk(thunk_%d, %d, ", n, numCaptured);
+	}
+
+	if (numCaptured == 0) {
+		appendCode(compiler, cb, "NULL)");
+	} else {
+		appendCode(compiler, cb, "(RT_VALUE *[]){ ");
+
+		for (i = 0; i < numCaptured; ++i) {
+			appendCode(compiler, cb, (i > 0) ? ", %s" : "%s", scope->entries[captured[i]].cExpr);
+		}
+
+		appendCode(compiler, cb, " })");
+	}
+
+	compilerFree(compiler, body.buf);
+	compilerFree(compiler, innerScope.entries);
+	compilerFree(compiler, captured);
+}
+
+static void compileExpr(COMPILER * compiler, LC_EXPR * expr, SCOPE * scope, CODE_BUFFER * cb) {
+	int index;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+			index = lookUpScope(scope, expr->name);
+
+			if (index >= 0) {
+				appendCode(compiler, cb, "%s", scope->entries[index].cExpr);
+			} else {
+				appendCode(compiler, cb, "rtFreeVariables[%d]", getFreeVariableIndex(compiler, expr->name));
+			}
+
+			break;
+
+		case lcExpressionType_LambdaExpr:
+			compileFunction(compiler, expr, scope, cb);
+			break;
+
+		case lcExpressionType_FunctionCall:
+			appendCode(compiler, cb, "rtApply(");
+			compileExpr(compiler, expr->expr, scope, cb);
+			appendCode(compiler, cb, ", ");
+
+			if (expr->expr2->type == lcExpressionType_FunctionCall) {
+				/* Delay the argument */
+				compileFunction(compiler, expr->expr2, scope, cb);
+			} else {
+				compileExpr(compiler, expr->expr2, scope, cb);
+			}
+
+			appendCode(compiler, cb, ")");
+			break;
+
+		default:
+
+			if (!compiler->failed) {
+				fprintf(stderr, "compileExpr() : Integer literals and δ-reduction are not supported\n");
+			}
+
+			compiler->failed = TRUE;
+			appendCode(compiler, cb, "NULL");
+			break;
+	}
+}
+
+/* **** The output file **** */
+
+BOOL compileToC(LC_CONTEXT * ctx, LC_EXPR * exprs[], int numExprs, FILE * fp) {
+	/* Write a C program that prints the normal forms of exprs[0 .. numExprs - 1] */
+	COMPILER compiler;
+	SCOPE emptyScope = { NULL, 0 };
+	int i;
+
+	memset(&compiler, 0, sizeof(COMPILER));
+	compiler.ctx = ctx;
+	compiler.fp = fp;
+
+	fprintf(fp, "/* Generated by facility -c; compile with: gcc -O2 -o program thisfile.c */\n\n");
+
+	for (i = 0; runtimeSource[i] != NULL; ++i) {
+		fprintf(fp, "%s\n", runtimeSource[i]);
+	}
+
+	fprintf(fp, "\n");
+
+	for (i = 0; i < numExprs; ++i) {
+		CODE_BUFFER cb = { NULL, 0, 0 };
+
+		compileExpr(&compiler, exprs[i], &emptyScope, &cb);
+		fprintf(fp, "static RT_VALUE * program_%d(void) {\n\treturn %s;\n}\n\n", i, cb.buf);
+		compilerFree(&compiler, cb.buf);
+	}
+
+	fprintf(fp, "int main(void) {\n\tstatic const char * freeVariableNames[] = { ");
+
+	for (i = 0; i < compiler.numFreeVariables; ++i) {
+		fprintf(fp, "\"%s\", ", compiler.freeVariableNames[i]);
+	}
+
+	fprintf(fp, "NULL };\n\n\trtInit(freeVariableNames, %d);\n\n", compiler.numFreeVariables);
+
+	for (i = 0; i < numExprs; ++i) {
+		fprintf(fp, "\trtPrintResult(program_%d());\n", i);
+	}
+
+	fprintf(fp, "\n\treturn 0;\n}\n");
+
+	compilerFree(&compiler, compiler.boundNames);
+	compilerFree(&compiler, compiler.freeVariableNames);
+
+	return !compiler.failed;
+}
+
+BOOL compileFileToC(char * inputFilename, char * outputFilename) {
+	/* Compile each line of the input file that is not blank */
+	char * text = readFile(inputFilename);
+	BOOL result = FALSE;
+	int i;
+
+	if (text == NULL) {
+		return FALSE;
+	}
+
+	LC_CONTEXT * ctx = createContext();
+	char ** lines = (char **)malloc(countLines(text) * sizeof(char *));
+	const int numLines = splitIntoLines(text, lines);
+	LC_EXPR ** exprs = (LC_EXPR **)malloc((numLines + 1) * sizeof(LC_EXPR *));
+	FILE * fp = NULL;
+
+
+	for (i = 0; i < numLines; ++i) {
+		exprs[i] = parse(ctx, lines[i]);
+
+		if (exprs[i] == NULL) {
+			fprintf(stderr, "compileFileToC() : Cannot parse line %d of '%s'\n", i + 1, inputFilename);
+			break;
+		}
+
+		exprs[i] = expandIterations(ctx, exprs[i]); /* The generated code knows only plain applications */
+	}
+
+	if (i == numLines) {
+		fp = fopen(outputFilename, "w");
+
+		if (fp == NULL) {
+			fprintf(stderr, "compileFileToC() : Cannot open '%s'\n", outputFilename);
+		} else {
+			result = compileToC(ctx, exprs, numLines, fp);
+			fclose(fp);
+		}
+	}
+
+	free(exprs);
+	free(lines);
+	freeContext(ctx);
+	free(text);
+
+	return result;
+}
+
+/* **** The End **** */
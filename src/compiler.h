@@ -0,0 +1,7 @@
+/* facility/src/compiler.h */
+
+void printCompilerMemMgrReport(LC_CONTEXT * ctx);
+BOOL compileToC(LC_CONTEXT * ctx, LC_EXPR * exprs[], int numExprs, FILE * fp);
+BOOL compileFileToC(char * inputFilename, char * outputFilename);
+
+/* **** The End **** */
@@ -0,0 +1,178 @@
+/* facility/src/context.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "telemetry.h"
+
+LC_CONTEXT * createContext() {
+	/* The context itself is not counted: it holds the counters. */
+	LC_CONTEXT * ctx = (LC_CONTEXT *)malloc(sizeof(LC_CONTEXT));
+
+	memset(ctx, 0, sizeof(LC_CONTEXT));
+	ctx->memmgrRecords = NULL;
+	ctx->root = ctx;
+	ctx->scheduler = NULL;
+	ctx->workerIndex = -1;
+	ctx->parallelThreshold = defaultParallelThreshold;
+	ctx->enableDeltaReduction = FALSE;
+	ctx->trace = NULL;
+
+	return ctx;
+}
+
+void freeContext(LC_CONTEXT * ctx) {
+	freeAllStructs(ctx);
+	free(ctx);
+}
+
+void initChildContext(LC_CONTEXT * child, LC_CONTEXT * parent) {
+	/* A child context has an empty heap of its own, but shares its parent's
+	root (and so its generated variable names) and scheduler. */
+	memset(child, 0, sizeof(LC_CONTEXT));
+	child->memmgrRecords = NULL;
+	child->root = parent->root;
+	child->scheduler = parent->scheduler;
+	child->workerIndex = -1;
+	child->parallelThreshold = parent->parallelThreshold;
+	child->enableDeltaReduction = parent->enableDeltaReduction;
+	child->numGcThreads = parent->numGcThreads;
+	child->uncapGcThreads = parent->uncapGcThreads;
+	child->limits = parent->limits;
+	child->status = parent->status;
+	child->deadline = parent->deadline;
+	child->trace = parent->trace;
+	child->traceStrategy = parent->traceStrategy;
+}
+
+void mergeChildContext(LC_CONTEXT * parent, LC_CONTEXT * child) {
+	/* Move the child's heap and counts into its parent */
+	int i;
+
+	adoptMemMgrRecords(parent, child);
+	mergeMemoryTelemetry(parent, child);
+	parent->numBetaReductions += child->numBetaReductions;
+
+	if (parent->status == rsOK) {
+		parent->status = child->status;
+		parent->cycleLength = child->cycleLength;
+	}
+
+	for (i = 0; i < child->numDivergentContracta; ++i) {
+
+		if (parent->numDivergentContracta < maxDivergentContracta) {
+			parent->divergentContracta[parent->numDivergentContracta++] = child->divergentContracta[i];
+		} else if (parent->status == rsOK) {
+			/* No room to wait and see; assume that it is kept */
+			parent->status = rsCycleDetected;
+			parent->cycleLength = child->divergentContracta[i].cycleLength;
+		}
+	}
+
+	memset(child, 0, sizeof(LC_CONTEXT));
+}
+
+void printMemMgrCounts(char * description, MEMMGR_COUNTS * counts) {
+	printf("  %s: %d mallocs, %d frees", description, counts->numMallocs, counts->numFrees);
+
+	if (counts->numMallocs > counts->numFrees) {
+		printf(" : **** LEAKAGE ****");
+	}
+
+	printf("\n");
+}
+
+/* **** Counted allocation **** */
+
+/* Each block starts with its size, so that the bytes can be counted when it
+is resized or freed. counts may be NULL, for allocations that are not
+counted. */
+
+typedef union {
+	size_t size;
+	max_align_t alignment;
+} ALLOCATION_HEADER;
+
+void * countedRealloc(MEMMGR_COUNTS * counts, void * ptr, size_t size) {
+	/* realloc(), or malloc() if ptr is NULL */
+	ALLOCATION_HEADER * header = (ptr != NULL) ? (ALLOCATION_HEADER *)ptr - 1 : NULL;
+	const size_t oldSize = (header != NULL) ? header->size : 0;
+
+	header = (ALLOCATION_HEADER *)realloc(header, sizeof(ALLOCATION_HEADER) + size);
+	header->size = size;
+
+	if (counts != NULL) {
+
+		if (ptr == NULL) {
+			++counts->numMallocs;
+		}
+
+		if (size > oldSize) {
+			counts->numBytesAllocated += size - oldSize;
+		} else {
+			counts->numBytesFreed += oldSize - size;
+		}
+	}
+
+	return header + 1;
+}
+
+void * countedCalloc(MEMMGR_COUNTS * counts, size_t n, size_t size) {
+	void * ptr = countedRealloc(counts, NULL, n * size);
+
+	memset(ptr, 0, n * size);
+
+	return ptr;
+}
+
+void countedFree(MEMMGR_COUNTS * counts, void * ptr) {
+	/* Like free(), ptr may be NULL */
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	ALLOCATION_HEADER * header = (ALLOCATION_HEADER *)ptr - 1;
+
+	if (counts != NULL) {
+		++counts->numFrees;
+		counts->numBytesFreed += header->size;
+	}
+
+	free(header);
+}
+
+char * getReductionStatusMessage(ReductionStatus status) {
+
+	switch (status) {
+		case rsOK:
+			return "OK";
+
+		case rsLiveNodeLimitExceeded:
+			return "The limit on live nodes was exceeded";
+
+		case rsAllocationLimitExceeded:
+			return "The limit on allocations was exceeded";
+
+		case rsTimeLimitExceeded:
+			return "The time limit was exceeded";
+
+		case rsCycleDetected:
+			return "The term diverges: it recurs up to α-equivalence";
+
+		default:
+			break;
+	}
+
+	return "Unknown status";
+}
+
+/* **** The End **** */
@@ -0,0 +1,151 @@
+/* facility/src/context.h */
+
+/* An interpreter context holds all of the mutable state of one interpreter:
+ * its heap, its generated variable names and its allocation counters.
+ * Every function that allocates takes the context as its first parameter, so
+ * independent contexts can be used on separate threads without locking. */
+
+/* const int defaultParallelThreshold = 64; */
+#define defaultParallelThreshold 64
+
+typedef struct {
+	int numMallocs;
+	int numFrees;
+	/* Kept by countedRealloc() and countedFree(); the subsystems whose
+	allocations all have the same size leave these at 0 (see telemetry.c) */
+	long numBytesAllocated; /* Growing a block counts the growth */
+	long numBytesFreed; /* Shrinking a block counts the shrinkage */
+} MEMMGR_COUNTS;
+
+typedef enum {
+	rsOK,
+	rsLiveNodeLimitExceeded,
+	rsAllocationLimitExceeded,
+	rsTimeLimitExceeded,
+	rsCycleDetected /* The term diverges; see detectCycles below */
+} ReductionStatus;
+
+typedef struct {
+	int maxLiveNodes; /* The number of LC_EXPR nodes in the heap */
+	int maxAllocations; /* The number of LC_EXPR nodes created */
+	int maxMilliseconds; /* Wall-clock time */
+	BOOL detectCycles; /* Stop when a contractum recurs; see beta-reduction.c */
+} REDUCTION_LIMITS; /* Zero means no limit */
+
+/* const int cycleDetectionWindow = 16; */
+#define cycleDetectionWindow 16
+
+typedef struct {
+	LC_EXPR * expr; /* A contractum that is being reduced */
+	unsigned long fingerprint; /* Of expr, up to α-equivalence */
+	int depth; /* The number of contracta that enclose it */
+} CYCLE_DETECTOR_ENTRY;
+
+/* const int maxDivergentContracta = 16; */
+#define maxDivergentContracta 16
+
+typedef struct {
+	LC_EXPR * expr; /* A contractum inside an argument, left unreduced because it recurs */
+	int cycleLength;
+} DIVERGENT_CONTRACTUM;
+
+/* const int numPauseHistogramBuckets = 24; */
+#define numPauseHistogramBuckets 24
+
+typedef struct {
+	int numCollections; /* Calls to collectGarbage() and freeAllStructs() */
+	long markNanoseconds; /* In total */
+	long sweepNanoseconds;
+	long maxMarkNanoseconds;
+	long maxSweepNanoseconds;
+	/* Bucket i counts the pauses of less than 2^i microseconds; the last
+	bucket counts the rest */
+	int markPauseHistogram[numPauseHistogramBuckets];
+	int sweepPauseHistogram[numPauseHistogramBuckets];
+} GC_TELEMETRY;
+
+struct LC_CONTEXT_STRUCT {
+	MEMMGR_RECORD * memmgrRecords; /* The heap of LC_EXPR nodes */
+	int generatedVariableNumber; /* Only the root context's counter is used */
+	LC_CONTEXT * root; /* The context that this one is a child of, or itself */
+
+	/* Parallel reduction (see beta-reduction.c and task-scheduler.h).
+	If scheduler is NULL, reduction is sequential. Otherwise, independent
+	subterms of at least parallelThreshold nodes are reduced as separate
+	tasks, each allocating from the heap of its own child context. */
+	struct TASK_SCHEDULER_STRUCT * scheduler;
+	int workerIndex; /* The worker running this context, or -1 */
+	int parallelThreshold;
+
+	BOOL enableDeltaReduction; /* Integer literals and primitives; see delta-reduction.c */
+
+	/* The number of threads that collect garbage on a big heap; 0 or 1
+	means the calling thread alone. See memory-manager.c. */
+	int numGcThreads;
+	BOOL uncapGcThreads; /* Use numGcThreads even if there are fewer CPUs (for the tests) */
+
+	/* Per-evaluation resource limits; see betaReduceWithLimits(). A child
+	context inherits its parent's limits and deadline, and its nodes are
+	counted against them on the root context, with atomic updates, so the
+	parallel tasks of one evaluation share a single budget. */
+	REDUCTION_LIMITS limits;
+	ReductionStatus status; /* Once this is not rsOK, reduction unwinds */
+	int numLimitedAllocations; /* Only the root context's: LC_EXPR nodes created since the start */
+	int numLimitedLiveNodes; /* Only the root context's: LC_EXPR nodes in the heaps of it and its children */
+	long deadline; /* In milliseconds, on the monotonic clock */
+	int numCallsSinceClockCheck;
+
+	/* The innermost contracta whose reduction is in progress, indexed by
+	depth modulo cycleDetectionWindow, and the length of the cycle found */
+	CYCLE_DETECTOR_ENTRY activeContracta[cycleDetectionWindow];
+	int numActiveContracta;
+	int cycleLength;
+
+	/* The number of arguments that enclose the reduction in progress. A
+	cycle found inside an argument only makes the term diverge if the
+	argument is kept, so it is recorded in divergentContracta instead. */
+	int argumentDepth;
+	DIVERGENT_CONTRACTUM divergentContracta[maxDivergentContracta];
+	int numDivergentContracta;
+
+	struct TRACE_RECORDER_STRUCT * trace; /* NULL unless tracing; see trace.c */
+	int traceStrategy; /* The strategy of the innermost betaReduce(), if tracing */
+
+	/* Memory telemetry; see telemetry.c. Each MEMMGR_COUNTS below must also
+	be listed in the registry there. */
+	int peakLiveNodes; /* The most LC_EXPR nodes in the heap at once; an upper bound once children are merged */
+	long numBetaReductions; /* By betaReduceCore() and normalizeByEvaluation(); the other engines do not count */
+	GC_TELEMETRY gcTelemetry;
+
+	MEMMGR_COUNTS mainCounts;
+	MEMMGR_COUNTS memMgrCounts;
+	MEMMGR_COUNTS gcCounts;
+	MEMMGR_COUNTS createAndDestroyCounts;
+	MEMMGR_COUNTS charSourceCounts;
+	MEMMGR_COUNTS stringSetCounts;
+	MEMMGR_COUNTS stringListCounts;
+	MEMMGR_COUNTS interactionNetCounts;
+	MEMMGR_COUNTS combinatorCounts;
+	MEMMGR_COUNTS explicitSubstitutionCounts;
+	MEMMGR_COUNTS gMachineCounts;
+	MEMMGR_COUNTS nbeCounts;
+	MEMMGR_COUNTS printerCounts;
+	MEMMGR_COUNTS compactExprCounts;
+	MEMMGR_COUNTS flatExprCounts;
+	MEMMGR_COUNTS compilerCounts;
+	MEMMGR_COUNTS traceCounts;
+	MEMMGR_COUNTS taskSchedulerCounts;
+};
+
+LC_CONTEXT * createContext();
+void freeContext(LC_CONTEXT * ctx);
+void initChildContext(LC_CONTEXT * child, LC_CONTEXT * parent);
+void mergeChildContext(LC_CONTEXT * parent, LC_CONTEXT * child);
+
+void printMemMgrCounts(char * description, MEMMGR_COUNTS * counts);
+void * countedRealloc(MEMMGR_COUNTS * counts, void * ptr, size_t size);
+void * countedCalloc(MEMMGR_COUNTS * counts, size_t n, size_t size);
+void countedFree(MEMMGR_COUNTS * counts, void * ptr);
+char * getReductionStatusMessage(ReductionStatus status);
+
+/* **** The End **** */
@@ -10,23 +10,36 @@
 
 #include "types.h"
 #include "memory-manager.h"
+#include "context.h"
 
-static int numMallocs = 0;
-static int numFrees = 0;
+void printCreateAndDestroyMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Create and destroy", &ctx->createAndDestroyCounts);
+}
+
+static BOOL hasNodeLimits(LC_CONTEXT * ctx) {
+	return ctx->limits.maxAllocations > 0 || ctx->limits.maxLiveNodes > 0;
+}
 
-void printCreateAndDestroyMemMgrReport() {
-	printf("  Create and destroy: %d mallocs, %d frees", numMallocs, numFrees);
+static void checkAllocationLimits(LC_CONTEXT * ctx) {
+	/* See betaReduceWithLimits(). The counts are the root's, so that they
+	cover every task of a parallel reduction. */
+	const int numAllocations = __atomic_add_fetch(&ctx->root->numLimitedAllocations, 1, __ATOMIC_RELAXED);
+	const int numLiveNodes = __atomic_add_fetch(&ctx->root->numLimitedLiveNodes, 1, __ATOMIC_RELAXED);
 
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
+	if (ctx->status != rsOK) {
+		return;
 	}
 
-	printf("\n");
+	if (ctx->limits.maxAllocations > 0 && numAllocations > ctx->limits.maxAllocations) {
+		ctx->status = rsAllocationLimitExceeded;
+	} else if (ctx->limits.maxLiveNodes > 0 && numLiveNodes > ctx->limits.maxLiveNodes) {
+		ctx->status = rsLiveNodeLimitExceeded;
+	}
 }
 
 // **** Create and Free functions ****
 
-static LC_EXPR * createExpr(int type, char * name, LC_EXPR * expr, LC_EXPR * expr2) {
+static LC_EXPR * createExpr(LC_CONTEXT * ctx, int type, char * name, LC_EXPR * expr, LC_EXPR * expr2) {
 
 	if (name != NULL && strlen(name) >= maxStringValueLength - 1) {
 		fprintf(stderr, "createExpr() : The name '%s' is too long.\n", name);
@@ -35,8 +48,9 @@ static LC_EXPR * createExpr(int type, char * name, LC_EXPR * expr, LC_EXPR * exp
 
 	LC_EXPR * newExpr = (LC_EXPR *)malloc(sizeof(LC_EXPR));
 
-	++numMallocs;
+	++ctx->createAndDestroyCounts.numMallocs;
 	newExpr->mark = 0;
+	newExpr->closedness = lcClosedness_Unknown;
 	newExpr->type = type;
 	memset(newExpr->name, 0, maxStringValueLength);
 
@@ -46,22 +60,125 @@ static LC_EXPR * createExpr(int type, char * name, LC_EXPR * expr, LC_EXPR * exp
 
 	newExpr->expr = expr;
 	newExpr->expr2 = expr2;
+	newExpr->value = 0;
 
-	addItemToMemMgrRecords(newExpr);
+	addItemToMemMgrRecords(ctx, newExpr);
+
+	const int numLiveNodes = ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees;
+
+	if (numLiveNodes > ctx->peakLiveNodes) {
+		ctx->peakLiveNodes = numLiveNodes;
+	}
+
+	if (hasNodeLimits(ctx)) {
+		checkAllocationLimits(ctx);
+	}
 
 	return newExpr;
 }
 
-LC_EXPR * createVariable(char * name) {
-	return createExpr(lcExpressionType_Variable, name, NULL, NULL);
+LC_EXPR * createVariable(LC_CONTEXT * ctx, char * name) {
+	return createExpr(ctx, lcExpressionType_Variable, name, NULL, NULL);
+}
+
+LC_EXPR * createLambdaExpr(LC_CONTEXT * ctx, char * argName, LC_EXPR * body) {
+	return createExpr(ctx, lcExpressionType_LambdaExpr, argName, body, NULL);
+}
+
+LC_EXPR * createFunctionCall(LC_CONTEXT * ctx, LC_EXPR * expr, LC_EXPR * expr2) {
+	return createExpr(ctx, lcExpressionType_FunctionCall, NULL, expr, expr2);
+}
+
+LC_EXPR * createIntegerLiteral(LC_CONTEXT * ctx, long value) {
+	LC_EXPR * newExpr = createExpr(ctx, lcExpressionType_IntegerLiteral, NULL, NULL, NULL);
+
+	newExpr->value = value;
+
+	return newExpr;
+}
+
+/* An Iteration is the spine (f (f ... (f x))) of a Church numeral, stored in one node
+however long it is, so that a numeral in the millions costs O(1) memory. */
+
+static BOOL isSameFunction(LC_EXPR * f1, LC_EXPR * f2) {
+	/* Two occurrences of a variable in the same spine have the same binding */
+	return f1 == f2 || (f1->type == lcExpressionType_Variable && f2->type == lcExpressionType_Variable && !strcmp(f1->name, f2->name));
+}
+
+LC_EXPR * createIteration(LC_CONTEXT * ctx, LC_EXPR * f, LC_EXPR * x, long n) {
+	/* f applied n times to x; an x that is itself a spine of f is absorbed */
+
+	for (;;) {
+
+		if (x->type == lcExpressionType_Iteration && isSameFunction(x->expr, f)) {
+			n += x->value;
+		} else if (x->type == lcExpressionType_FunctionCall && isSameFunction(x->expr, f)) {
+			++n;
+		} else {
+			break;
+		}
+
+		x = x->expr2;
+	}
+
+	if (n <= 0) {
+		return x;
+	} else if (n == 1) {
+		return createFunctionCall(ctx, f, x);
+	}
+
+	LC_EXPR * newExpr = createExpr(ctx, lcExpressionType_Iteration, NULL, f, x);
+
+	newExpr->value = n;
+
+	return newExpr;
 }
 
-LC_EXPR * createLambdaExpr(char * argName, LC_EXPR * body) {
-	return createExpr(lcExpressionType_LambdaExpr, argName, body, NULL);
+LC_EXPR * createFunctionCallOrIteration(LC_CONTEXT * ctx, LC_EXPR * expr, LC_EXPR * expr2) {
+	/* createFunctionCall(), except that (f (f x)) is compressed into an Iteration when f is
+	a variable. δ-reduction looks for its primitives on plain application spines, so it
+	turns the compression off. */
+
+	if (!ctx->enableDeltaReduction && expr != NULL && expr2 != NULL && expr->type == lcExpressionType_Variable &&
+		(expr2->type == lcExpressionType_FunctionCall || expr2->type == lcExpressionType_Iteration) &&
+		isSameFunction(expr2->expr, expr)) {
+		return createIteration(ctx, expr, expr2, 1);
+	}
+
+	return createFunctionCall(ctx, expr, expr2);
 }
 
-LC_EXPR * createFunctionCall(LC_EXPR * expr, LC_EXPR * expr2) {
-	return createExpr(lcExpressionType_FunctionCall, NULL, expr, expr2);
+LC_EXPR * expandIterations(LC_CONTEXT * ctx, LC_EXPR * expr) {
+	/* For the engines that only know plain applications; the tree is copied only where it contains an Iteration */
+	LC_EXPR * newExpr;
+	LC_EXPR * newExpr2;
+	long i;
+
+	switch (expr->type) {
+		case lcExpressionType_LambdaExpr:
+			newExpr = expandIterations(ctx, expr->expr);
+
+			return (newExpr == expr->expr) ? expr : createLambdaExpr(ctx, expr->name, newExpr);
+
+		case lcExpressionType_FunctionCall:
+			newExpr = expandIterations(ctx, expr->expr);
+			newExpr2 = expandIterations(ctx, expr->expr2);
+
+			return (newExpr == expr->expr && newExpr2 == expr->expr2) ? expr : createFunctionCall(ctx, newExpr, newExpr2);
+
+		case lcExpressionType_Iteration:
+			newExpr = expandIterations(ctx, expr->expr);
+			newExpr2 = expandIterations(ctx, expr->expr2);
+
+			for (i = 0; i < expr->value; ++i) {
+				newExpr2 = createFunctionCall(ctx, newExpr, newExpr2);
+			}
+
+			return newExpr2;
+
+		default:
+			return expr;
+	}
 }
 
 /* void freeExpr(LC_EXPR * expr) {
@@ -85,8 +202,16 @@ LC_EXPR * createFunctionCall(LC_EXPR * expr, LC_EXPR * expr2) {
 	++numFrees;
 } */
 
-void incNumFreesInCreateAndDestroy() {
-	++numFrees;
+void addNumFreesInCreateAndDestroy(LC_CONTEXT * ctx, int n) {
+	ctx->createAndDestroyCounts.numFrees += n;
+
+	if (hasNodeLimits(ctx)) {
+		__atomic_sub_fetch(&ctx->root->numLimitedLiveNodes, n, __ATOMIC_RELAXED);
+	}
+}
+
+void incNumFreesInCreateAndDestroy(LC_CONTEXT * ctx) {
+	addNumFreesInCreateAndDestroy(ctx, 1);
 }
 
 /* **** The End **** */
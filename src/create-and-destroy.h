@@ -1,9 +1,13 @@
 /* facility/src/create-and-destroy.h */
 
-LC_EXPR * createVariable(char * name);
-LC_EXPR * createLambdaExpr(char * argName, LC_EXPR * body);
-LC_EXPR * createFunctionCall(LC_EXPR * expr, LC_EXPR * expr2);
+LC_EXPR * createVariable(LC_CONTEXT * ctx, char * name);
+LC_EXPR * createLambdaExpr(LC_CONTEXT * ctx, char * argName, LC_EXPR * body);
+LC_EXPR * createFunctionCall(LC_CONTEXT * ctx, LC_EXPR * expr, LC_EXPR * expr2);
+LC_EXPR * createIntegerLiteral(LC_CONTEXT * ctx, long value);
+LC_EXPR * createIteration(LC_CONTEXT * ctx, LC_EXPR * f, LC_EXPR * x, long n);
+LC_EXPR * createFunctionCallOrIteration(LC_CONTEXT * ctx, LC_EXPR * expr, LC_EXPR * expr2);
+LC_EXPR * expandIterations(LC_CONTEXT * ctx, LC_EXPR * expr);
 
-void printCreateAndDestroyMemMgrReport();
+void printCreateAndDestroyMemMgrReport(LC_CONTEXT * ctx);
 
 /* **** The End **** */
@@ -6,26 +6,19 @@
 #include <stdio.h>
 #include <string.h>
 
-/* #include "boolean.h" */
+#include "boolean.h"
 
 #include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 
 typedef struct STRING_LIST_STRUCT {
 	char * str;
 	struct STRING_LIST_STRUCT * next;
 } STRING_LIST;
 
-static int numMallocs = 0;
-static int numFrees = 0;
-
-void printStringListMemMgrReport() {
-	printf("  String lists (de-bruijn.c): %d mallocs, %d frees", numMallocs, numFrees);
-
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
-	}
-
-	printf("\n");
+void printStringListMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("String lists (de-bruijn.c)", &ctx->stringListCounts);
 }
 
 static int findIndexOfString(char * name, STRING_LIST * boundVariablesList) {
@@ -47,7 +40,7 @@ static int findIndexOfString(char * name, STRING_LIST * boundVariablesList) {
 	return findIndexOfString(name, stringList) > 0;
 } */
 
-static STRING_LIST * addStringToList(char * name, STRING_LIST * stringList) {
+static STRING_LIST * addStringToList(LC_CONTEXT * ctx, char * name, STRING_LIST * stringList) {
 
 	/* if (name != NULL && strlen(name) >= maxStringValueLength - 1) {
 		fprintf(stderr, "addStringToList() : The name '%s' is too long.\n", name);
@@ -56,7 +49,7 @@ static STRING_LIST * addStringToList(char * name, STRING_LIST * stringList) {
 
 	STRING_LIST * newStringList = (STRING_LIST *)malloc(sizeof(STRING_LIST));
 
-	++numMallocs;
+	++ctx->stringListCounts.numMallocs;
 	newStringList->str = name;
 	newStringList->next = stringList;
 
@@ -121,9 +114,32 @@ static int deBruijnAppendString(char * buf, int bufSize, int i, char * str) {
 	return newi;
 }
 
-static int getDeBruijnIndexLocal(LC_EXPR * expr, char * buf, int bufSize, int i, STRING_LIST * boundVariablesList) {
+static int appendRepeatedString(char * buf, int bufSize, int i, int start, long count) {
+	/* Append count more copies of buf[start..i) */
+	const int length = i - start;
+	long j;
+
+	for (j = 0; j < count; ++j) {
+
+		if (i + length >= bufSize) {
+			fprintf(stderr, "appendRepeatedString() error: Not enough buffer space to append %ld more copies of '%.*s'\n", count - j, length, buf + start);
+			break;
+		}
+
+		memcpy(buf + i, buf + start, length);
+		i += length;
+	}
+
+	buf[i] = '\0';
+
+	return i;
+}
+
+static int getDeBruijnIndexLocal(LC_CONTEXT * ctx, LC_EXPR * expr, char * buf, int bufSize, int i, STRING_LIST * boundVariablesList) {
 	int n = 0;
+	int start;
 	STRING_LIST * newBoundVariablesList = NULL;
+	char numBuf[24];
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
@@ -145,22 +161,41 @@ static int getDeBruijnIndexLocal(LC_EXPR * expr, char * buf, int bufSize, int i,
 
 		case lcExpressionType_LambdaExpr:
 			i = deBruijnAppendString(buf, bufSize, i, "λ");
-			newBoundVariablesList = addStringToList(expr->name, boundVariablesList);
-			i = getDeBruijnIndexLocal(expr->expr, buf, bufSize, i, newBoundVariablesList);
+			newBoundVariablesList = addStringToList(ctx, expr->name, boundVariablesList);
+			i = getDeBruijnIndexLocal(ctx, expr->expr, buf, bufSize, i, newBoundVariablesList);
 			newBoundVariablesList->next = NULL;
 			free(newBoundVariablesList);
-			++numFrees;
+			++ctx->stringListCounts.numFrees;
 			newBoundVariablesList = NULL;
 			break;
 
 		case lcExpressionType_FunctionCall:
 			i = deBruijnAppendString(buf, bufSize, i, "(");
-			i = getDeBruijnIndexLocal(expr->expr, buf, bufSize, i, boundVariablesList);
+			i = getDeBruijnIndexLocal(ctx, expr->expr, buf, bufSize, i, boundVariablesList);
 			i = deBruijnAppendString(buf, bufSize, i, " ");
-			i = getDeBruijnIndexLocal(expr->expr2, buf, bufSize, i, boundVariablesList);
+			i = getDeBruijnIndexLocal(ctx, expr->expr2, buf, bufSize, i, boundVariablesList);
 			i = deBruijnAppendString(buf, bufSize, i, ")");
 			break;
 
+		case lcExpressionType_Iteration:
+			/* As the spine of FunctionCalls that it stands for, but f is only converted once */
+			start = i;
+			i = deBruijnAppendString(buf, bufSize, i, "(");
+			i = getDeBruijnIndexLocal(ctx, expr->expr, buf, bufSize, i, boundVariablesList);
+			i = deBruijnAppendString(buf, bufSize, i, " ");
+			i = appendRepeatedString(buf, bufSize, i, start, expr->value - 1);
+			i = getDeBruijnIndexLocal(ctx, expr->expr2, buf, bufSize, i, boundVariablesList);
+			start = i;
+			i = deBruijnAppendString(buf, bufSize, i, ")");
+			i = appendRepeatedString(buf, bufSize, i, start, expr->value - 1);
+			break;
+
+		case lcExpressionType_IntegerLiteral:
+			/* The # keeps literals distinct from indices */
+			snprintf(numBuf, sizeof(numBuf), "#%ld", expr->value);
+			i = deBruijnAppendString(buf, bufSize, i, numBuf);
+			break;
+
 		default:
 			break;
 	}
@@ -168,10 +203,10 @@ static int getDeBruijnIndexLocal(LC_EXPR * expr, char * buf, int bufSize, int i,
 	return i;
 }
 
-int getDeBruijnIndex(LC_EXPR * expr, char * buf, int bufSize) {
+int getDeBruijnIndex(LC_CONTEXT * ctx, LC_EXPR * expr, char * buf, int bufSize) {
 	memset(buf, 0, bufSize);
 
-	return getDeBruijnIndexLocal(expr, buf, bufSize, 0, NULL);
+	return getDeBruijnIndexLocal(ctx, expr, buf, bufSize, 0, NULL);
 }
 
 /* **** The End **** */
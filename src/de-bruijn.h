@@ -1,8 +1,8 @@
 /* facility/src/de-bruijn.h */
 
 /* void printDeBruijnIndex(LC_EXPR * expr); */
-int getDeBruijnIndex(LC_EXPR * expr, char * buf, int bufSize);
+int getDeBruijnIndex(LC_CONTEXT * ctx, LC_EXPR * expr, char * buf, int bufSize);
 
-void printStringListMemMgrReport();
+void printStringListMemMgrReport(LC_CONTEXT * ctx);
 
 /* **** The End **** */
@@ -0,0 +1,259 @@
+/* facility/src/delta-reduction.c */
+
+/* δ-reduction (delta-reduction) for the extended Lambda calculus: the
+ * reduction of primitive operators applied to native integer literals;
+ * e.g. ((+ 2) 3) δ-> 5
+ *
+ * The primitives, all of which are curried:
+ *
+ *	((+ a) b), ((- a) b), ((* a) b)   Integer arithmetic
+ *	((= a) b)                         1 if a equals b, otherwise 0
+ *	(((if c) t) e)                    t if c is not 0, otherwise e
+ *	(church n)                        The Church numeral for the literal n, if n <= maxChurchNumeral
+ *	(number c)                        The literal for the Church numeral c
+ *
+ * δ-reduction is enabled by ctx->enableDeltaReduction; the parser then reads
+ * a run of digits as an integer literal, and the names of the primitives are
+ * reserved. The strict operands are reduced first; if they do not reduce to
+ * literals, or the arithmetic overflows, the call is left alone and
+ * β-reduction proceeds as usual.
+ *
+ * The exception is an if whose condition does not reduce to a literal (e.g.
+ * inside the body of a recursive function, where the condition depends on a
+ * parameter): it is left unreduced, like the body of a lambda in weak head
+ * normal form. Otherwise reducing the definition of a recursive function
+ * would unfold the recursion without end. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "delta-reduction.h"
+#include "trace.h"
+
+/* const int maxPrimitiveArity = 3; */
+#define maxPrimitiveArity 3
+/* const long maxChurchNumeral = 10000; */
+#define maxChurchNumeral 10000L
+
+typedef enum {
+	primAdd,
+	primSubtract,
+	primMultiply,
+	primEquals,
+	primIf,
+	primChurch,
+	primNumber,
+	primNone
+} PrimitiveOperator;
+
+typedef struct {
+	char * name;
+	int arity;
+	int numStrictArgs; /* The first numStrictArgs args must reduce to literals */
+} PRIMITIVE_OPERATOR_INFO;
+
+static PRIMITIVE_OPERATOR_INFO primitiveOperators[] = {
+	{ "+", 2, 2 },
+	{ "-", 2, 2 },
+	{ "*", 2, 2 },
+	{ "=", 2, 2 },
+	{ "if", 3, 1 },
+	{ "church", 1, 1 },
+	{ "number", 1, 0 }
+};
+
+static PrimitiveOperator getPrimitiveOperator(LC_EXPR * expr) {
+	int i;
+
+	if (expr->type != lcExpressionType_Variable) {
+		return primNone;
+	}
+
+	for (i = 0; i < primNone; ++i) {
+
+		if (!strcmp(expr->name, primitiveOperators[i].name)) {
+			return (PrimitiveOperator)i;
+		}
+	}
+
+	return primNone;
+}
+
+BOOL isIntegerLiteralString(char * str) {
+
+	if (*str == '-') {
+		++str;
+	}
+
+	if (*str == '\0') {
+		return FALSE;
+	}
+
+	for (; *str != '\0'; ++str) {
+
+		if (*str < '0' || *str > '9') {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+LC_EXPR * integerToChurchNumeral(LC_CONTEXT * ctx, long n) {
+	/* λf.λx.(f (f ... (f x))) with n applications of f; n must be >= 0.
+	The nodes count against the limits of ctx, like any others: once one
+	is exceeded, the spine is left short, and the reduction unwinds. */
+	LC_EXPR * f = createVariable(ctx, "f");
+	LC_EXPR * body = createVariable(ctx, "x");
+
+	for (; n > 0 && ctx->status == rsOK; --n) {
+		body = createFunctionCall(ctx, f, body);
+	}
+
+	return createLambdaExpr(ctx, "f", createLambdaExpr(ctx, "x", body));
+}
+
+long churchNumeralToInteger(LC_EXPR * expr) {
+	/* Returns n if expr is the Church numeral for n (in normal form, perhaps
+	η-reduced), or -1 otherwise. No reduction is done. */
+	long n = 0;
+
+	if (expr->type != lcExpressionType_LambdaExpr) {
+		return -1;
+	}
+
+	char * f = expr->name;
+	LC_EXPR * body = expr->expr;
+
+	if (body->type == lcExpressionType_Variable) {
+		/* λf.f is the η-reduced form of λf.λx.(f x) */
+		return !strcmp(body->name, f) ? 1 : -1;
+	} else if (body->type != lcExpressionType_LambdaExpr || !strcmp(body->name, f)) {
+		return -1;
+	}
+
+	char * x = body->name;
+
+	for (body = body->expr; body->type == lcExpressionType_FunctionCall; body = body->expr2) {
+
+		if (body->expr->type != lcExpressionType_Variable || strcmp(body->expr->name, f)) {
+			return -1;
+		}
+
+		++n;
+	}
+
+	return (body->type == lcExpressionType_Variable && !strcmp(body->name, x)) ? n : -1;
+}
+
+static LC_EXPR * applyPrimitiveOperator(LC_CONTEXT * ctx, PrimitiveOperator op, LC_EXPR ** args, int maxDepth, BetaReductionStrategy strategy) {
+	/* Returns NULL if the operands are not of the right kind, or if the
+	result of the arithmetic would not fit in a long */
+	long n;
+
+	switch (op) {
+		case primAdd:
+			return __builtin_add_overflow(args[0]->value, args[1]->value, &n) ? NULL : createIntegerLiteral(ctx, n);
+
+		case primSubtract:
+			return __builtin_sub_overflow(args[0]->value, args[1]->value, &n) ? NULL : createIntegerLiteral(ctx, n);
+
+		case primMultiply:
+			return __builtin_mul_overflow(args[0]->value, args[1]->value, &n) ? NULL : createIntegerLiteral(ctx, n);
+
+		case primEquals:
+			return createIntegerLiteral(ctx, (args[0]->value == args[1]->value) ? 1 : 0);
+
+		case primIf:
+			return (args[0]->value != 0) ? args[1] : args[2];
+
+		case primChurch:
+			/* With δ-reduction, nothing is compressed into an Iteration, so the
+			numeral is a plain spine, which the recursive passes (e.g.
+			etaReduce()) descend one call at a time: a longer one is refused */
+			return (args[0]->value >= 0 && args[0]->value <= maxChurchNumeral) ? integerToChurchNumeral(ctx, args[0]->value) : NULL;
+
+		case primNumber:
+			n = churchNumeralToInteger(betaReduce(ctx, args[0], maxDepth, strategy));
+
+			return (n >= 0) ? createIntegerLiteral(ctx, n) : NULL;
+
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+static LC_EXPR * deltaReduceSpine(LC_CONTEXT * ctx, LC_EXPR * expr, PrimitiveOperator op, int numArgs, int maxDepth, BetaReductionStrategy strategy, BOOL * isStuck) {
+	/* expr is op applied to numArgs >= arity args. Returns the δ-contractum
+	applied to any extra args, not yet reduced, or NULL. Sets *isStuck if
+	a strict operand does not reduce to a literal. */
+	const int arity = primitiveOperators[op].arity;
+	LC_EXPR * args[maxPrimitiveArity];
+	int i;
+
+	if (numArgs > arity) {
+		LC_EXPR * callee = deltaReduceSpine(ctx, expr->expr, op, numArgs - 1, maxDepth, strategy, isStuck);
+
+		return (callee == NULL) ? NULL : createFunctionCall(ctx, callee, expr->expr2);
+	}
+
+	for (i = arity - 1; i >= 0; --i, expr = expr->expr) {
+		args[i] = expr->expr2;
+	}
+
+	for (i = 0; i < primitiveOperators[op].numStrictArgs; ++i) {
+		args[i] = betaReduce(ctx, args[i], maxDepth, strategy);
+
+		if (args[i]->type != lcExpressionType_IntegerLiteral) {
+			*isStuck = TRUE;
+			return NULL;
+		}
+	}
+
+	return applyPrimitiveOperator(ctx, op, args, maxDepth, strategy);
+}
+
+LC_EXPR * deltaReduceFunctionCall(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy) {
+	/* If expr is a primitive operator applied to at least as many args as
+	it takes, then apply it and reduce the result. Otherwise return NULL. */
+	LC_EXPR * head = expr;
+	int numArgs = 0;
+	BOOL isStuck = FALSE;
+
+	/* Walk down the spine: ((op a) b) is Call(Call(op, a), b) */
+
+	for (; head->type == lcExpressionType_FunctionCall; head = head->expr) {
+		++numArgs;
+	}
+
+	const PrimitiveOperator op = getPrimitiveOperator(head);
+
+	if (op == primNone || numArgs < primitiveOperators[op].arity) {
+		return NULL;
+	}
+
+	LC_EXPR * result = deltaReduceSpine(ctx, expr, op, numArgs, maxDepth, strategy, &isStuck);
+
+	if (result == NULL) {
+		return (op == primIf && isStuck) ? expr : NULL;
+	}
+
+	if (ctx->trace != NULL) {
+		recordTraceEvent(ctx, teDelta, expr, NULL);
+	}
+
+	return betaReduce(ctx, result, maxDepth, strategy);
+}
+
+/* **** The End **** */
@@ -0,0 +1,8 @@
+/* facility/src/delta-reduction.h */
+
+BOOL isIntegerLiteralString(char * str);
+LC_EXPR * integerToChurchNumeral(LC_CONTEXT * ctx, long n);
+long churchNumeralToInteger(LC_EXPR * expr);
+LC_EXPR * deltaReduceFunctionCall(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth, BetaReductionStrategy strategy);
+
+/* **** The End **** */
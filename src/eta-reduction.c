@@ -9,11 +9,14 @@
 #include "boolean.h"
 
 #include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 
 #include "string-set.h"
 #include "create-and-destroy.h"
+#include "trace.h"
 
-BOOL containsUnboundVariableNamed(LC_EXPR * expr, char * varName, STRING_SET * boundVariableNames) {
+BOOL containsUnboundVariableNamed(LC_CONTEXT * ctx, LC_EXPR * expr, char * varName, STRING_SET * boundVariableNames) {
 	BOOL result = FALSE;
 	STRING_SET * newStringSet = NULL;
 
@@ -26,23 +29,24 @@ BOOL containsUnboundVariableNamed(LC_EXPR * expr, char * varName, STRING_SET * b
 			/* Create the set: boundVariableNames union { expr->name } */
 
 			if (!stringSetContains(boundVariableNames, expr->name)) {
-				newStringSet = addStringToSet(expr->name, boundVariableNames);
+				newStringSet = addStringToSet(ctx, expr->name, boundVariableNames);
 				boundVariableNames = newStringSet;
 			}
 
-			result = containsUnboundVariableNamed(expr->expr, varName, boundVariableNames);
+			result = containsUnboundVariableNamed(ctx, expr->expr, varName, boundVariableNames);
 
 			/* If we allocated any memory by calling addStringToList() above, then free it now */
 
 			if (newStringSet != NULL) {
 				newStringSet->next = NULL;
-				freeStringSet(newStringSet);
+				freeStringSet(ctx, newStringSet);
 			}
 
 			return result;
 
 		case lcExpressionType_FunctionCall:
-			return containsUnboundVariableNamed(expr->expr, varName, boundVariableNames) || containsUnboundVariableNamed(expr->expr2, varName, boundVariableNames);
+		case lcExpressionType_Iteration:
+			return containsUnboundVariableNamed(ctx, expr->expr, varName, boundVariableNames) || containsUnboundVariableNamed(ctx, expr->expr2, varName, boundVariableNames);
 
 		default:
 			break;
@@ -51,9 +55,11 @@ BOOL containsUnboundVariableNamed(LC_EXPR * expr, char * varName, STRING_SET * b
 	return FALSE;
 }
 
-LC_EXPR * etaReduce(LC_EXPR * expr) {
+LC_EXPR * etaReduce(LC_CONTEXT * ctx, LC_EXPR * expr) {
 	/* η-reduction (eta-reduction) : Reduce λx.(f x) to f if x does not appear
-	free in f. */
+	free in f. Subtrees with no η-redex are returned as they are. */
+	LC_EXPR * newExpr;
+	LC_EXPR * newExpr2;
 
 	switch (expr->type) {
 		case lcExpressionType_Variable:
@@ -65,15 +71,34 @@ LC_EXPR * etaReduce(LC_EXPR * expr) {
 				expr->expr->type == lcExpressionType_FunctionCall &&
 				expr->expr->expr2->type == lcExpressionType_Variable &&
 				!strcmp(expr->expr->expr2->name, expr->name) &&
-				!containsUnboundVariableNamed(expr->expr->expr, expr->name, NULL)
+				!containsUnboundVariableNamed(ctx, expr->expr->expr, expr->name, NULL)
 			) {
-				return etaReduce(expr->expr->expr);
+
+				if (ctx->trace != NULL) {
+					recordTraceEvent(ctx, teEta, expr, NULL);
+				}
+
+				return etaReduce(ctx, expr->expr->expr);
 			}
 
-			return createLambdaExpr(expr->name, etaReduce(expr->expr));
+			newExpr = etaReduce(ctx, expr->expr);
+
+			return (newExpr == expr->expr) ? expr : createLambdaExpr(ctx, expr->name, newExpr);
 
 		case lcExpressionType_FunctionCall:
-			return createFunctionCall(etaReduce(expr->expr), etaReduce(expr->expr2));
+			newExpr = etaReduce(ctx, expr->expr);
+			newExpr2 = etaReduce(ctx, expr->expr2);
+
+			return (newExpr == expr->expr && newExpr2 == expr->expr2) ? expr : createFunctionCall(ctx, newExpr, newExpr2);
+
+		case lcExpressionType_Iteration:
+			newExpr = etaReduce(ctx, expr->expr);
+			newExpr2 = etaReduce(ctx, expr->expr2);
+
+			return (newExpr == expr->expr && newExpr2 == expr->expr2) ? expr : createIteration(ctx, newExpr, newExpr2, expr->value);
+
+		case lcExpressionType_IntegerLiteral:
+			return expr;
 
 		default:
 			break;
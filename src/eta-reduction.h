@@ -1,6 +1,6 @@
 /* facility/src/eta-reduction.h */
 
-BOOL containsUnboundVariableNamed(LC_EXPR * expr, char * varName, STRING_SET * boundVariableNames);
-LC_EXPR * etaReduce(LC_EXPR * expr);
+BOOL containsUnboundVariableNamed(LC_CONTEXT * ctx, LC_EXPR * expr, char * varName, STRING_SET * boundVariableNames);
+LC_EXPR * etaReduce(LC_CONTEXT * ctx, LC_EXPR * expr);
 
 /* **** The End **** */
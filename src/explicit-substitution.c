@@ -0,0 +1,567 @@
+/* facility/src/explicit-substitution.c */
+
+/* An alternative reduction engine based on the λσ-calculus of explicit
+ * substitutions (Abadi, Cardelli, Curien and Lévy).
+ *
+ * betaReduceCore() copies the body of the lambda on every β-step, and
+ * α-conversion copies it again, although the next step often throws most
+ * of the copy away. Here the term is converted to de Bruijn indices, so
+ * there is no α-conversion, and a β-step only builds a closure a[s]: the
+ * term a with a pending substitution s. A substitution is pushed one level
+ * into a closure only when reduction looks at it:
+ *
+ *	(λa) b        -> a[b · id]                  (Beta)
+ *	((λa)[s]) b   -> a[b · s]
+ *	(a b)[s]      -> (a[s] b[s])                (App)
+ *	(λa)[s]       -> λ(a[1 · (s ∘ ↑)])          (Abs)
+ *	a[s][t]       -> a[s ∘ t]                   (Clos)
+ *	1[a · s]      -> a                          (VarCons)
+ *	(n+1)[a · s]  -> n[s]
+ *	n[↑^k]        -> n+k
+ *
+ * Adjacent substitutions are composed (id ∘ s = s, ↑^j ∘ ↑^k = ↑^(j+k),
+ * ↑ ∘ (a · s) = s), and compositions are kept right-associated, so the
+ * chains that a variable lookup walks stay short.
+ *
+ * Reduction is to weak head normal form by unwinding the spine; the read-back
+ * then goes under lambdas and into the arguments of a free head, as in
+ * combinator.c. When the weak head normal form of a closure is found, the
+ * closure is overwritten by it, so an argument that is used many times is
+ * evaluated only once. The names of the lambdas are kept as hints for the
+ * read-back, which renames only where a name could be captured.
+ *
+ * δ-reduction is not supported; with it enabled, normal order is used. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+#include "explicit-substitution.h"
+
+/* const long maxExplicitSubstitutionSteps = 1L << 22; */
+#define maxExplicitSubstitutionSteps (1L << 22)
+/* const int maxExplicitSubstitutionReadBackDepth = 50000; */
+#define maxExplicitSubstitutionReadBackDepth 50000
+/* const int numCachedVariableNodes = 64; */
+#define numCachedVariableNodes 64
+
+typedef enum {
+	esNodeType_Variable, /* A de Bruijn index */
+	esNodeType_FreeVariable,
+	esNodeType_Lambda,
+	esNodeType_Application,
+	esNodeType_Closure /* A term with a pending substitution */
+} EsNodeType;
+
+typedef struct {
+	EsNodeType type;
+	int index; /* For variables; 1 is the innermost binder */
+	int left; /* The body of a lambda, the callee, or the term in a closure */
+	int right; /* The argument, or the substitution of a closure */
+	char name[maxStringValueLength]; /* For free variables, and as a hint for lambdas */
+} ES_NODE;
+
+typedef enum {
+	esSubstType_Identity,
+	esSubstType_Shift, /* ↑^shift */
+	esSubstType_Cons, /* term · left */
+	esSubstType_Composition /* left ∘ right: first left, then right */
+} EsSubstType;
+
+typedef struct {
+	EsSubstType type;
+	int shift;
+	int term;
+	int left;
+	int right;
+} ES_SUBST;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	ES_NODE * nodes;
+	int numNodes;
+	int nodeCapacity;
+	ES_SUBST * substs; /* substs[0] is the identity */
+	int numSubsts;
+	int substCapacity;
+	int * stack; /* The arguments of the spine being unwound */
+	int stackSize;
+	int stackCapacity;
+	int * pending; /* The substitutions still to apply, during a lookup */
+	int pendingSize;
+	int pendingCapacity;
+	int variableNodes[numCachedVariableNodes]; /* 0 if not created yet */
+	char (* scopeNames)[maxStringValueLength]; /* The binders, innermost last */
+	int numScopeNames;
+	int scopeNamesCapacity;
+	STRING_SET * freeNames; /* The free variables of the input */
+	long numSteps;
+	BOOL failed;
+} ES_MACHINE;
+
+/* **** Allocation **** */
+
+void printExplicitSubstitutionMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Explicit substitutions", &ctx->explicitSubstitutionCounts);
+}
+
+static void * esRealloc(ES_MACHINE * machine, void * ptr, size_t size) {
+	return countedRealloc(&machine->ctx->explicitSubstitutionCounts, ptr, size);
+}
+
+static void esFree(ES_MACHINE * machine, void * ptr) {
+	countedFree(&machine->ctx->explicitSubstitutionCounts, ptr);
+}
+
+static int pushInt(ES_MACHINE * machine, int ** array, int * size, int * capacity, int n) {
+
+	if (*size == *capacity) {
+		*capacity = (*capacity == 0) ? 64 : 2 * *capacity;
+		*array = (int *)esRealloc(machine, *array, *capacity * sizeof(int));
+	}
+
+	(*array)[(*size)++] = n;
+
+	return n;
+}
+
+static int createNode(ES_MACHINE * machine, EsNodeType type, int index, int left, int right) {
+
+	if (machine->numNodes == machine->nodeCapacity) {
+		machine->nodeCapacity = (machine->nodeCapacity == 0) ? 256 : 2 * machine->nodeCapacity;
+		machine->nodes = (ES_NODE *)esRealloc(machine, machine->nodes, machine->nodeCapacity * sizeof(ES_NODE));
+	}
+
+	const int n = machine->numNodes++;
+	ES_NODE * node = &machine->nodes[n];
+
+	node->type = type;
+	node->index = index;
+	node->left = left;
+	node->right = right;
+	memset(node->name, 0, maxStringValueLength);
+
+	return n;
+}
+
+static int createVariableNode(ES_MACHINE * machine, int index) {
+
+	if (index >= numCachedVariableNodes) {
+		return createNode(machine, esNodeType_Variable, index, -1, -1);
+	} else if (machine->variableNodes[index] == 0) {
+		machine->variableNodes[index] = createNode(machine, esNodeType_Variable, index, -1, -1);
+	}
+
+	return machine->variableNodes[index];
+}
+
+static int createNamedNode(ES_MACHINE * machine, EsNodeType type, char * name, int body) {
+	const int n = createNode(machine, type, 0, body, -1);
+
+	strcpy(machine->nodes[n].name, name);
+
+	return n;
+}
+
+static int createClosure(ES_MACHINE * machine, int term, int subst) {
+
+	if (subst == 0 || machine->nodes[term].type == esNodeType_FreeVariable) {
+		return term;
+	}
+
+	return createNode(machine, esNodeType_Closure, 0, term, subst);
+}
+
+static int createSubst(ES_MACHINE * machine, EsSubstType type, int shift, int term, int left, int right) {
+
+	if (machine->numSubsts == machine->substCapacity) {
+		machine->substCapacity = (machine->substCapacity == 0) ? 256 : 2 * machine->substCapacity;
+		machine->substs = (ES_SUBST *)esRealloc(machine, machine->substs, machine->substCapacity * sizeof(ES_SUBST));
+	}
+
+	const int s = machine->numSubsts++;
+	ES_SUBST * subst = &machine->substs[s];
+
+	subst->type = type;
+	subst->shift = shift;
+	subst->term = term;
+	subst->left = left;
+	subst->right = right;
+
+	return s;
+}
+
+static int createCons(ES_MACHINE * machine, int term, int subst) {
+	return createSubst(machine, esSubstType_Cons, 0, term, subst, -1);
+}
+
+/* **** Substitutions **** */
+
+static int composeSimple(ES_MACHINE * machine, int s, int t) {
+	/* s ∘ t, where s is not a composition */
+	int shift;
+
+	if (s == 0) {
+		return t;
+	} else if (t == 0) {
+		return s;
+	} else if (machine->substs[s].type != esSubstType_Shift) {
+		/* (a · s) ∘ t is left alone until a lookup needs it */
+		return createSubst(machine, esSubstType_Composition, 0, -1, s, t);
+	}
+
+	/* ↑ ∘ (a · t) = t */
+
+	for (shift = machine->substs[s].shift; shift > 0 && machine->substs[t].type == esSubstType_Cons; --shift) {
+		t = machine->substs[t].left;
+	}
+
+	if (shift == 0) {
+		return t;
+	} else if (t == 0) {
+		return createSubst(machine, esSubstType_Shift, shift, -1, -1, -1);
+	} else if (machine->substs[t].type == esSubstType_Shift) {
+		return createSubst(machine, esSubstType_Shift, shift + machine->substs[t].shift, -1, -1, -1);
+	}
+
+	return createSubst(machine, esSubstType_Composition, 0, -1,
+		createSubst(machine, esSubstType_Shift, shift, -1, -1, -1), t);
+}
+
+static int compose(ES_MACHINE * machine, int s, int t) {
+	/* s ∘ t, kept right-associated: (a ∘ b) ∘ t = a ∘ (b ∘ t) */
+	const int base = machine->pendingSize;
+
+	while (machine->substs[s].type == esSubstType_Composition) {
+		pushInt(machine, &machine->pending, &machine->pendingSize, &machine->pendingCapacity, machine->substs[s].left);
+		s = machine->substs[s].right;
+	}
+
+	t = composeSimple(machine, s, t);
+
+	while (machine->pendingSize > base) {
+		t = composeSimple(machine, machine->pending[--machine->pendingSize], t);
+	}
+
+	return t;
+}
+
+static int lift(ES_MACHINE * machine, int s) {
+	/* ⇑s = 1 · (s ∘ ↑): s, under one more binder */
+	return (s == 0) ? 0 : createCons(machine, createVariableNode(machine, 1),
+		compose(machine, s, createSubst(machine, esSubstType_Shift, 1, -1, -1, -1)));
+}
+
+static int lookUpVariable(ES_MACHINE * machine, int n, int s) {
+	/* n[s], pushed down as far as it will go */
+	const int base = machine->pendingSize;
+
+	for (;;) {
+		ES_SUBST * subst = &machine->substs[s];
+		int term;
+
+		switch (subst->type) {
+			case esSubstType_Identity:
+			case esSubstType_Shift:
+				n += subst->shift;
+
+				if (machine->pendingSize == base) {
+					return createVariableNode(machine, n);
+				}
+
+				s = machine->pending[--machine->pendingSize];
+				break;
+
+			case esSubstType_Cons:
+
+				if (n > 1) {
+					--n;
+					s = subst->left;
+					break;
+				}
+
+				/* a[p1][p2]... = a[p1 ∘ p2 ∘ ...] */
+				term = subst->term;
+				s = 0;
+
+				while (machine->pendingSize > base) {
+					s = compose(machine, s, machine->pending[--machine->pendingSize]);
+				}
+
+				return createClosure(machine, term, s);
+
+			case esSubstType_Composition:
+				/* n[a ∘ b] = n[a][b] */
+				pushInt(machine, &machine->pending, &machine->pendingSize, &machine->pendingCapacity, subst->right);
+				s = subst->left;
+				break;
+
+			default:
+				machine->failed = TRUE;
+				return createVariableNode(machine, n);
+		}
+	}
+}
+
+/* **** Conversion from LC_EXPR **** */
+
+static void pushScopeName(ES_MACHINE * machine, char * name) {
+
+	if (machine->numScopeNames == machine->scopeNamesCapacity) {
+		machine->scopeNamesCapacity = (machine->scopeNamesCapacity == 0) ? 64 : 2 * machine->scopeNamesCapacity;
+		machine->scopeNames = (char (*)[maxStringValueLength])esRealloc(machine, machine->scopeNames,
+			machine->scopeNamesCapacity * maxStringValueLength);
+	}
+
+	memset(machine->scopeNames[machine->numScopeNames], 0, maxStringValueLength);
+	strcpy(machine->scopeNames[machine->numScopeNames++], name);
+}
+
+static int convertExpr(ES_MACHINE * machine, LC_EXPR * expr) {
+	int i;
+	int body;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+
+			for (i = machine->numScopeNames - 1; i >= 0; --i) {
+
+				if (!strcmp(machine->scopeNames[i], expr->name)) {
+					return createVariableNode(machine, machine->numScopeNames - i);
+				}
+			}
+
+			if (!stringSetContains(machine->freeNames, expr->name)) {
+				machine->freeNames = addStringToSet(machine->ctx, expr->name, machine->freeNames);
+			}
+
+			return createNamedNode(machine, esNodeType_FreeVariable, expr->name, -1);
+
+		case lcExpressionType_LambdaExpr:
+			pushScopeName(machine, expr->name);
+			body = convertExpr(machine, expr->expr);
+			--machine->numScopeNames;
+
+			return createNamedNode(machine, esNodeType_Lambda, expr->name, body);
+
+		case lcExpressionType_FunctionCall:
+			body = convertExpr(machine, expr->expr);
+
+			return createNode(machine, esNodeType_Application, 0, body, convertExpr(machine, expr->expr2));
+
+		default:
+			break;
+	}
+
+	/* E.g. an integer literal */
+	machine->failed = TRUE;
+
+	return createVariableNode(machine, 1);
+}
+
+/* **** Reduction **** */
+
+static int reduceToWeakHeadNormalForm(ES_MACHINE * machine, int n, int base) {
+	/* Unwinds the spine of n, pushing the arguments onto the stack above
+	base, first argument on top. Returns the head, which is a variable or,
+	if there are no arguments left, a lambda. */
+	const int original = n;
+
+	machine->stackSize = base;
+
+	while (!machine->failed) {
+		const ES_NODE node = machine->nodes[n];
+
+		if (++machine->numSteps > maxExplicitSubstitutionSteps) {
+			machine->failed = TRUE;
+			break;
+		}
+
+		if (node.type == esNodeType_Application) {
+			pushInt(machine, &machine->stack, &machine->stackSize, &machine->stackCapacity, node.right);
+			n = node.left;
+			continue;
+		} else if (node.type == esNodeType_Lambda) {
+
+			if (machine->stackSize == base) {
+				break;
+			}
+
+			/* (λa) b -> a[b · id] */
+			n = createClosure(machine, node.left, createCons(machine, machine->stack[--machine->stackSize], 0));
+			continue;
+		} else if (node.type != esNodeType_Closure) {
+			break; /* A variable */
+		}
+
+		/* Push the substitution one level into the closure */
+		const ES_NODE inner = machine->nodes[node.left];
+		const int s = node.right;
+
+		switch (inner.type) {
+			case esNodeType_Variable:
+				n = lookUpVariable(machine, inner.index, s);
+				break;
+
+			case esNodeType_FreeVariable:
+				n = node.left;
+				break;
+
+			case esNodeType_Lambda:
+
+				if (machine->stackSize > base) {
+					/* ((λa)[s]) b -> a[b · s] */
+					n = createClosure(machine, inner.left, createCons(machine, machine->stack[--machine->stackSize], s));
+				} else {
+					const int body = createClosure(machine, inner.left, lift(machine, s));
+
+					n = createNamedNode(machine, esNodeType_Lambda, machine->nodes[node.left].name, body);
+				}
+
+				break;
+
+			case esNodeType_Application:
+				pushInt(machine, &machine->stack, &machine->stackSize, &machine->stackCapacity, createClosure(machine, inner.right, s));
+				n = createClosure(machine, inner.left, s);
+				break;
+
+			case esNodeType_Closure:
+				n = createClosure(machine, inner.left, compose(machine, inner.right, s));
+				break;
+
+			default:
+				machine->failed = TRUE;
+				break;
+		}
+	}
+
+	if (!machine->failed && machine->stackSize == base && n != original &&
+		(machine->nodes[original].type == esNodeType_Closure || machine->nodes[original].type == esNodeType_Application)) {
+		/* Share the result with everything else that refers to original */
+		machine->nodes[original] = machine->nodes[n];
+	}
+
+	return n;
+}
+
+/* **** Read-back to LC_EXPR **** */
+
+static BOOL isNameInScope(ES_MACHINE * machine, char * name) {
+	int i;
+
+	for (i = 0; i < machine->numScopeNames; ++i) {
+
+		if (!strcmp(machine->scopeNames[i], name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static LC_EXPR * readBack(ES_MACHINE * machine, int n, int depth) {
+	const int base = machine->stackSize;
+	LC_EXPR * result = NULL;
+	int i;
+
+	if (depth > maxExplicitSubstitutionReadBackDepth) {
+		machine->failed = TRUE;
+	}
+
+	const int head = reduceToWeakHeadNormalForm(machine, n, base);
+
+	if (machine->failed) {
+		machine->stackSize = base;
+		return NULL;
+	}
+
+	const ES_NODE node = machine->nodes[head];
+
+	if (node.type == esNodeType_Lambda) {
+		/* Keep the name, unless it could capture or be captured */
+		char name[maxStringValueLength];
+
+		memcpy(name, node.name, maxStringValueLength);
+
+		while (name[0] == '\0' || isNameInScope(machine, name) || stringSetContains(machine->freeNames, name)) {
+			generateNewVariableName(machine->ctx, name, maxStringValueLength);
+		}
+
+		pushScopeName(machine, name);
+
+		LC_EXPR * body = readBack(machine, node.left, depth + 1);
+
+		--machine->numScopeNames;
+
+		return (body == NULL) ? NULL : createLambdaExpr(machine->ctx, name, body);
+	} else if (node.type == esNodeType_FreeVariable) {
+		result = createVariable(machine->ctx, (char *)node.name);
+	} else if (node.index <= machine->numScopeNames) {
+		result = createVariable(machine->ctx, machine->scopeNames[machine->numScopeNames - node.index]);
+	} else {
+		machine->failed = TRUE;
+	}
+
+	/* The head applied to zero or more arguments. The stack may grow (and
+	move) while we read back the arguments, so index it afresh. */
+
+	for (i = machine->stackSize - 1; i >= base && result != NULL; --i) {
+		const int savedStackSize = machine->stackSize;
+		LC_EXPR * argExpr = readBack(machine, machine->stack[i], depth + 1);
+
+		machine->stackSize = savedStackSize;
+		result = (argExpr == NULL) ? NULL : createFunctionCall(machine->ctx, result, argExpr);
+	}
+
+	machine->stackSize = base;
+
+	return result;
+}
+
+/* **** The engine **** */
+
+LC_EXPR * reduceWithExplicitSubstitutions(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
+	ES_MACHINE machine;
+
+	if (ctx->enableDeltaReduction) {
+		return betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	memset(&machine, 0, sizeof(ES_MACHINE));
+	machine.ctx = ctx;
+	createSubst(&machine, esSubstType_Identity, 0, -1, -1, -1);
+	createNode(&machine, esNodeType_FreeVariable, 0, -1, -1); /* So that node 0 is never a cached variable */
+
+	const int root = convertExpr(&machine, expr);
+	LC_EXPR * result = machine.failed ? NULL : readBack(&machine, root, 0);
+
+	if (result == NULL) {
+		fprintf(stderr, "reduceWithExplicitSubstitutions() : %s after %ld steps; using normal order instead\n",
+			(machine.numSteps > maxExplicitSubstitutionSteps) ? "Too many steps" : "Cannot read back the result",
+			machine.numSteps);
+		result = betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	} else {
+		result = etaReduce(ctx, result);
+	}
+
+	freeStringSet(ctx, machine.freeNames);
+	esFree(&machine, machine.scopeNames);
+	esFree(&machine, machine.pending);
+	esFree(&machine, machine.stack);
+	esFree(&machine, machine.substs);
+	esFree(&machine, machine.nodes);
+
+	return result;
+}
+
+/* **** The End **** */
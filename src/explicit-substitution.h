@@ -0,0 +1,6 @@
+/* facility/src/explicit-substitution.h */
+
+void printExplicitSubstitutionMemMgrReport(LC_CONTEXT * ctx);
+LC_EXPR * reduceWithExplicitSubstitutions(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth);
+
+/* **** The End **** */
@@ -0,0 +1,33 @@
+/* facility/src/facility.h */
+
+/* The embedding API. A host program includes this header and links with
+ * libfacility.a (see the Makefile). All interpreter state lives in an
+ * LC_CONTEXT, so separate contexts may be used concurrently on separate
+ * threads without locking; a single context must not be shared by threads.
+ *
+ *	LC_CONTEXT * ctx = createContext();
+ *	LC_EXPR * expr = parse(ctx, "(\\x.x y)");
+ *	LC_EXPR * result = betaReduce(ctx, expr, 50, brsDefault);
+ *
+ *	fprintExpr(ctx, stdout, result);
+ *	freeContext(ctx);
+ *
+ * Every LC_EXPR belongs to the heap of the context that created it, and is
+ * freed by collectGarbage() (unless it is reachable from one of the roots
+ * passed in) or by freeContext(). */
+
+#include <stdio.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "delta-reduction.h"
+#include "parser.h"
+#include "printer.h"
+
+/* **** The End **** */
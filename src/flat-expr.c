@@ -0,0 +1,505 @@
+/* facility/src/flat-expr.c */
+
+/* A flattened, read-only copy of an expression. The nodes are laid out in
+ * preorder in one array: a lambda is followed by its body, and an
+ * application by its callee and then its argument. Each node records the
+ * size of its subterm, so the argument of the application at i starts at
+ * i + 1 + nodes[i + 1].size, and the whole subterm can be skipped at once.
+ * A variable also records its de Bruijn index, which is worked out during
+ * the conversion.
+ *
+ * The passes that only read a term (printing, de Bruijn indices, free
+ * variable queries) then become loops over a contiguous array, with no
+ * recursion and no pointers to chase. On a big normal form they run at the
+ * speed of memory, not at the latency of a cache miss per node. The layout
+ * cannot be modified; build an LC_EXPR with fromFlatExpr() to reduce it.
+ *
+ * The output of fprintFlatExpr() and getFlatDeBruijnIndex() is the same as
+ * that of fprintExpr() and getDeBruijnIndex(). */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "create-and-destroy.h"
+#include "flat-expr.h"
+
+/* const unsigned int flatTypeMask = 7; */
+#define flatTypeMask 7
+/* const int flatNameIdShift = 3; */
+#define flatNameIdShift 3
+/* const unsigned int maxFlatNameId = (1U << 29) - 1; */
+#define maxFlatNameId ((1U << 29) - 1)
+/* const int flatPrintBufferSize = 65536; */
+#define flatPrintBufferSize 65536
+
+typedef struct {
+	LC_EXPR * expr;
+	unsigned int node; /* Its index in flat->nodes */
+	unsigned int shadowedDepth; /* For a lambda: the depth of the binder of the same name outside it */
+	int state; /* The number of subterms done */
+} FLAT_CONVERSION_FRAME;
+
+typedef struct {
+	unsigned int leftEnd; /* Where the callee ends and the argument starts */
+	unsigned int rightEnd; /* Where the application ends */
+} FLAT_PRINT_FRAME;
+
+void printFlatExprMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Flat expressions", &ctx->flatExprCounts);
+}
+
+static void * flatRealloc(LC_CONTEXT * ctx, void * ptr, size_t size) {
+	return countedRealloc(&ctx->flatExprCounts, ptr, size);
+}
+
+static void flatFree(LC_CONTEXT * ctx, void * ptr) {
+	countedFree(&ctx->flatExprCounts, ptr);
+}
+
+int getFlatNodeType(FLAT_NODE * node) {
+	return (int)(node->header & flatTypeMask);
+}
+
+static unsigned int getFlatNameId(FLAT_NODE * node) {
+	return node->header >> flatNameIdShift;
+}
+
+char * getFlatNodeName(FLAT_EXPR * flat, unsigned int i) {
+	/* The name of the variable or lambda at node i */
+	return flat->names[getFlatNameId(&flat->nodes[i])];
+}
+
+/* **** Interned names **** */
+
+static unsigned int hashName(char * name) {
+	/* FNV-1a */
+	unsigned int h = 2166136261U;
+
+	for (; *name != '\0'; ++name) {
+		h = (h ^ (unsigned char)*name) * 16777619U;
+	}
+
+	return h;
+}
+
+static unsigned int * findNameTableSlot(FLAT_EXPR * flat, char * name) {
+	/* Returns the slot holding the ID of name, or the empty slot where it belongs */
+	unsigned int i = hashName(name) & (flat->nameTableCapacity - 1);
+
+	while (flat->nameTable[i] != 0 && strcmp(flat->names[flat->nameTable[i]], name)) {
+		i = (i + 1) & (flat->nameTableCapacity - 1);
+	}
+
+	return &flat->nameTable[i];
+}
+
+static void growNameTable(FLAT_EXPR * flat) {
+	unsigned int id;
+
+	flatFree(flat->ctx, flat->nameTable);
+	flat->nameTableCapacity = (flat->nameTableCapacity == 0) ? 256 : 2 * flat->nameTableCapacity;
+	flat->nameTable = (unsigned int *)countedCalloc(&flat->ctx->flatExprCounts, flat->nameTableCapacity, sizeof(unsigned int));
+
+	for (id = 1; id < flat->numNames; ++id) {
+		*findNameTableSlot(flat, flat->names[id]) = id;
+	}
+}
+
+static unsigned int findNameId(FLAT_EXPR * flat, char * name) {
+	/* 0 if name does not occur in the expression */
+	return (flat->nameTable == NULL) ? 0 : *findNameTableSlot(flat, name);
+}
+
+static unsigned int internName(FLAT_EXPR * flat, char * name) {
+
+	if (2 * flat->numNames >= flat->nameTableCapacity) {
+		growNameTable(flat);
+	}
+
+	unsigned int * slot = findNameTableSlot(flat, name);
+
+	if (*slot != 0) {
+		return *slot;
+	} else if (flat->numNames > maxFlatNameId) {
+		fprintf(stderr, "internName() : Too many names\n");
+		return 0;
+	}
+
+	if (flat->numNames >= flat->namesCapacity) {
+		flat->namesCapacity = (flat->namesCapacity == 0) ? 128 : 2 * flat->namesCapacity;
+		flat->names = (char (*)[maxStringValueLength])flatRealloc(flat->ctx, flat->names, flat->namesCapacity * maxStringValueLength);
+	}
+
+	memset(flat->names[flat->numNames], 0, maxStringValueLength);
+	strcpy(flat->names[flat->numNames], name);
+	*slot = flat->numNames;
+
+	return flat->numNames++;
+}
+
+/* **** Conversion **** */
+
+static unsigned int appendFlatNode(FLAT_EXPR * flat, int type, unsigned int nameId, unsigned int index) {
+
+	if (flat->numNodes == flat->capacity) {
+		flat->capacity = (flat->capacity == 0) ? 1024 : 2 * flat->capacity;
+		flat->nodes = (FLAT_NODE *)flatRealloc(flat->ctx, flat->nodes, flat->capacity * sizeof(FLAT_NODE));
+	}
+
+	FLAT_NODE * node = &flat->nodes[flat->numNodes];
+
+	node->header = (nameId << flatNameIdShift) | (unsigned int)type;
+	node->index = index;
+	node->size = 1;
+
+	return flat->numNodes++;
+}
+
+static unsigned int addValue(FLAT_EXPR * flat, long value) {
+
+	if (flat->numValues == flat->valuesCapacity) {
+		flat->valuesCapacity = (flat->valuesCapacity == 0) ? 16 : 2 * flat->valuesCapacity;
+		flat->values = (long *)flatRealloc(flat->ctx, flat->values, flat->valuesCapacity * sizeof(long));
+	}
+
+	flat->values[flat->numValues] = value;
+
+	return flat->numValues++;
+}
+
+FLAT_EXPR * toFlatExpr(LC_CONTEXT * ctx, LC_EXPR * expr) {
+	/* Walk expr in preorder with an explicit stack. bindingDepth[id] is the
+	depth of the innermost lambda that binds name ID id (0 if none does), so
+	a variable's de Bruijn index is found without searching. */
+	FLAT_EXPR * flat = (FLAT_EXPR *)flatRealloc(ctx, NULL, sizeof(FLAT_EXPR));
+	FLAT_CONVERSION_FRAME * stack = NULL;
+	unsigned int * bindingDepth = NULL;
+	unsigned int bindingDepthCapacity = 0;
+	unsigned int depth = 0;
+	int stackSize = 0;
+	int stackCapacity = 0;
+
+	memset(flat, 0, sizeof(FLAT_EXPR));
+	expr = expandIterations(ctx, expr); /* The encoding has only plain applications */
+	flat->ctx = ctx;
+	flat->numNames = 1; /* Skip the null name ID */
+
+	for (;;) {
+		FLAT_CONVERSION_FRAME * frame;
+
+		if (expr != NULL) {
+			/* Start a new node */
+			unsigned int id = 0;
+
+			if (expr->type == lcExpressionType_Variable || expr->type == lcExpressionType_LambdaExpr) {
+				id = internName(flat, expr->name);
+
+				if (id >= bindingDepthCapacity) {
+					const unsigned int oldCapacity = bindingDepthCapacity;
+
+					bindingDepthCapacity = flat->namesCapacity;
+					bindingDepth = (unsigned int *)flatRealloc(ctx, bindingDepth, bindingDepthCapacity * sizeof(unsigned int));
+					memset(bindingDepth + oldCapacity, 0, (bindingDepthCapacity - oldCapacity) * sizeof(unsigned int));
+				}
+			}
+
+			switch (expr->type) {
+				case lcExpressionType_Variable:
+					appendFlatNode(flat, expr->type, id, (bindingDepth[id] > 0) ? depth - bindingDepth[id] + 1 : 0);
+					expr = NULL;
+					continue;
+
+				case lcExpressionType_IntegerLiteral:
+					appendFlatNode(flat, expr->type, 0, addValue(flat, expr->value));
+					expr = NULL;
+					continue;
+
+				default:
+					break;
+			}
+
+			if (stackSize == stackCapacity) {
+				stackCapacity = (stackCapacity == 0) ? 256 : 2 * stackCapacity;
+				stack = (FLAT_CONVERSION_FRAME *)flatRealloc(ctx, stack, stackCapacity * sizeof(FLAT_CONVERSION_FRAME));
+			}
+
+			frame = &stack[stackSize++];
+			frame->expr = expr;
+			frame->node = appendFlatNode(flat, expr->type, id, 0);
+			frame->state = 0;
+
+			if (expr->type == lcExpressionType_LambdaExpr) {
+				frame->shadowedDepth = bindingDepth[id];
+				bindingDepth[id] = ++depth;
+			}
+
+			expr = expr->expr;
+			continue;
+		}
+
+		/* A subterm is done; carry on with its parent */
+
+		if (stackSize == 0) {
+			break;
+		}
+
+		frame = &stack[stackSize - 1];
+
+		if (frame->expr->type == lcExpressionType_FunctionCall && frame->state == 0) {
+			frame->state = 1;
+			expr = frame->expr->expr2;
+			continue;
+		}
+
+		if (frame->expr->type == lcExpressionType_LambdaExpr) {
+			bindingDepth[getFlatNameId(&flat->nodes[frame->node])] = frame->shadowedDepth;
+			--depth;
+		}
+
+		flat->nodes[frame->node].size = flat->numNodes - frame->node;
+		--stackSize;
+	}
+
+	flatFree(ctx, bindingDepth);
+	flatFree(ctx, stack);
+
+	return flat;
+}
+
+LC_EXPR * fromFlatExpr(LC_CONTEXT * ctx, FLAT_EXPR * flat) {
+	/* Build the nodes from the last to the first: each node's subterms are
+	then on the stack, the callee above the argument. */
+	LC_EXPR ** stack = (LC_EXPR **)flatRealloc(ctx, NULL, flat->numNodes * sizeof(LC_EXPR *));
+	int stackSize = 0;
+	unsigned int i = flat->numNodes;
+
+	while (i-- > 0) {
+		FLAT_NODE * node = &flat->nodes[i];
+		LC_EXPR * expr;
+
+		switch (getFlatNodeType(node)) {
+			case lcExpressionType_Variable:
+				expr = createVariable(ctx, flat->names[getFlatNameId(node)]);
+				break;
+
+			case lcExpressionType_LambdaExpr:
+				expr = createLambdaExpr(ctx, flat->names[getFlatNameId(node)], stack[--stackSize]);
+				break;
+
+			case lcExpressionType_FunctionCall:
+				stackSize -= 2;
+				expr = createFunctionCall(ctx, stack[stackSize + 1], stack[stackSize]);
+				break;
+
+			default:
+				expr = createIntegerLiteral(ctx, flat->values[node->index]);
+				break;
+		}
+
+		stack[stackSize++] = expr;
+	}
+
+	LC_EXPR * result = stack[0];
+
+	flatFree(ctx, stack);
+
+	return result;
+}
+
+void freeFlatExpr(FLAT_EXPR * flat) {
+	LC_CONTEXT * ctx = flat->ctx;
+
+	flatFree(ctx, flat->nodes);
+	flatFree(ctx, flat->names);
+	flatFree(ctx, flat->nameTable);
+	flatFree(ctx, flat->values);
+	flatFree(ctx, flat);
+}
+
+/* **** Sequential passes **** */
+
+static int appendToken(char * buf, int bufSize, int len, char * str, FILE * fp) {
+	/* Append str to buf. If fp is not NULL, buf is flushed to it when it is
+	full; otherwise the text is cut short, as in de-bruijn.c. */
+	const int n = strlen(str);
+
+	if (len + n >= bufSize) {
+
+		if (fp == NULL) {
+			fprintf(stderr, "getFlatDeBruijnIndex() error: Not enough buffer space to append '%s'\n", str);
+			return len;
+		}
+
+		fwrite(buf, sizeof(char), len, fp);
+		len = 0;
+	}
+
+	memcpy(buf + len, str, n);
+
+	return len + n;
+}
+
+static int writeFlatExpr(FLAT_EXPR * flat, char * buf, int bufSize, FILE * fp, BOOL useDeBruijnIndices) {
+	/* The loop behind fprintFlatExpr() and getFlatDeBruijnIndex(). The only
+	stack is of the applications that are still open, to know when to print
+	the space between callee and argument and the closing parenthesis. */
+	FLAT_PRINT_FRAME * frames = NULL;
+	int numFrames = 0;
+	int framesCapacity = 0;
+	char numBuf[24];
+	int len = 0;
+	unsigned int i;
+
+	for (i = 0; i < flat->numNodes; ++i) {
+		FLAT_NODE * node = &flat->nodes[i];
+
+		switch (getFlatNodeType(node)) {
+			case lcExpressionType_LambdaExpr:
+				len = appendToken(buf, bufSize, len, "λ", fp);
+
+				if (!useDeBruijnIndices) {
+					len = appendToken(buf, bufSize, len, flat->names[getFlatNameId(node)], fp);
+					len = appendToken(buf, bufSize, len, ".", fp);
+				}
+
+				continue;
+
+			case lcExpressionType_FunctionCall:
+
+				if (numFrames == framesCapacity) {
+					framesCapacity = (framesCapacity == 0) ? 256 : 2 * framesCapacity;
+					frames = (FLAT_PRINT_FRAME *)flatRealloc(flat->ctx, frames, framesCapacity * sizeof(FLAT_PRINT_FRAME));
+				}
+
+				frames[numFrames].leftEnd = i + 1 + flat->nodes[i + 1].size;
+				frames[numFrames].rightEnd = i + node->size;
+				++numFrames;
+				len = appendToken(buf, bufSize, len, "(", fp);
+				continue;
+
+			case lcExpressionType_Variable:
+
+				if (useDeBruijnIndices && node->index > 0) {
+					snprintf(numBuf, sizeof(numBuf), "%u", node->index);
+					len = appendToken(buf, bufSize, len, numBuf, fp);
+				} else {
+					len = appendToken(buf, bufSize, len, flat->names[getFlatNameId(node)], fp);
+				}
+
+				break;
+
+			default:
+				/* In de Bruijn form, the # keeps literals distinct from indices */
+				snprintf(numBuf, sizeof(numBuf), useDeBruijnIndices ? "#%ld" : "%ld", flat->values[node->index]);
+				len = appendToken(buf, bufSize, len, numBuf, fp);
+				break;
+		}
+
+		/* A leaf ends here, and perhaps some applications with it */
+
+		while (numFrames > 0) {
+
+			if (frames[numFrames - 1].rightEnd == i + 1) {
+				len = appendToken(buf, bufSize, len, ")", fp);
+				--numFrames;
+			} else {
+
+				if (frames[numFrames - 1].leftEnd == i + 1) {
+					len = appendToken(buf, bufSize, len, " ", fp);
+				}
+
+				break;
+			}
+		}
+	}
+
+	flatFree(flat->ctx, frames);
+
+	return len;
+}
+
+void fprintFlatExpr(FILE * fp, FLAT_EXPR * flat) {
+	char * buf = (char *)flatRealloc(flat->ctx, NULL, flatPrintBufferSize * sizeof(char));
+	const int len = writeFlatExpr(flat, buf, flatPrintBufferSize, fp, FALSE);
+
+	fwrite(buf, sizeof(char), len, fp);
+	flatFree(flat->ctx, buf);
+}
+
+int getFlatDeBruijnIndex(FLAT_EXPR * flat, char * buf, int bufSize) {
+	memset(buf, 0, bufSize);
+
+	return writeFlatExpr(flat, buf, bufSize, NULL, TRUE);
+}
+
+BOOL isFlatExprClosed(FLAT_EXPR * flat) {
+	unsigned int i;
+
+	for (i = 0; i < flat->numNodes; ++i) {
+
+		if (getFlatNodeType(&flat->nodes[i]) == lcExpressionType_Variable && flat->nodes[i].index == 0) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+BOOL flatExprContainsFreeVariableNamed(FLAT_EXPR * flat, char * name) {
+	/* The header of a free occurrence of name, if there is any */
+	const unsigned int id = findNameId(flat, name);
+	const unsigned int header = (id << flatNameIdShift) | lcExpressionType_Variable;
+	unsigned int i;
+
+	if (id == 0) {
+		return FALSE;
+	}
+
+	for (i = 0; i < flat->numNodes; ++i) {
+
+		if (flat->nodes[i].header == header && flat->nodes[i].index == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+int getFlatFreeVariableNames(FLAT_EXPR * flat, char * names[], int maxNames) {
+	/* Put the distinct names of the free variables in names[], in order of
+	first occurrence, and return how many there are (which may be more than
+	maxNames) */
+	unsigned char * seen = (unsigned char *)flatRealloc(flat->ctx, NULL, flat->numNames);
+	int numNames = 0;
+	unsigned int i;
+
+	memset(seen, 0, flat->numNames);
+
+	for (i = 0; i < flat->numNodes; ++i) {
+		FLAT_NODE * node = &flat->nodes[i];
+		const unsigned int id = getFlatNameId(node);
+
+		if (getFlatNodeType(node) == lcExpressionType_Variable && node->index == 0 && !seen[id]) {
+			seen[id] = 1;
+
+			if (numNames < maxNames) {
+				names[numNames] = flat->names[id];
+			}
+
+			++numNames;
+		}
+	}
+
+	flatFree(flat->ctx, seen);
+
+	return numNames;
+}
+
+/* **** The End **** */
@@ -0,0 +1,45 @@
+/* facility/src/flat-expr.h */
+
+/* A flattened, read-only layout for Lambda calculus expressions; see
+ * flat-expr.c */
+
+typedef struct {
+	unsigned int header; /* Bits 0-2: type; bits 3-31: name ID */
+	unsigned int index; /* A variable's de Bruijn index (0 if it is free), or a literal's slot in values */
+	unsigned int size; /* The number of nodes in the subterm, this one included */
+} FLAT_NODE; /* 12 bytes */
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	FLAT_NODE * nodes; /* In preorder: each node is followed by its subterms */
+	unsigned int numNodes;
+	unsigned int capacity;
+
+	/* The interned names, indexed by name ID; ID 0 is unused */
+	char (* names)[maxStringValueLength];
+	unsigned int numNames; /* Including ID 0 */
+	unsigned int namesCapacity;
+	unsigned int * nameTable; /* Open addressing: name IDs, or 0 if empty */
+	unsigned int nameTableCapacity; /* A power of 2 */
+
+	long * values; /* Of the integer literals */
+	unsigned int numValues;
+	unsigned int valuesCapacity;
+} FLAT_EXPR;
+
+void printFlatExprMemMgrReport(LC_CONTEXT * ctx);
+
+FLAT_EXPR * toFlatExpr(LC_CONTEXT * ctx, LC_EXPR * expr);
+LC_EXPR * fromFlatExpr(LC_CONTEXT * ctx, FLAT_EXPR * flat);
+void freeFlatExpr(FLAT_EXPR * flat);
+
+int getFlatNodeType(FLAT_NODE * node);
+char * getFlatNodeName(FLAT_EXPR * flat, unsigned int i);
+
+void fprintFlatExpr(FILE * fp, FLAT_EXPR * flat);
+int getFlatDeBruijnIndex(FLAT_EXPR * flat, char * buf, int bufSize);
+BOOL isFlatExprClosed(FLAT_EXPR * flat);
+BOOL flatExprContainsFreeVariableNamed(FLAT_EXPR * flat, char * name);
+int getFlatFreeVariableNames(FLAT_EXPR * flat, char * names[], int maxNames);
+
+/* **** The End **** */
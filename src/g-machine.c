@@ -0,0 +1,591 @@
+/* facility/src/g-machine.c */
+
+/* An alternative reduction engine: a G-machine (Johnsson; Peyton Jones and
+ * Lester, "Implementing Functional Languages", chapter 3).
+ *
+ * The term is lambda-lifted into supercombinators: each maximal run of
+ * lambdas λx1...λxk.body becomes a global function whose parameters are the
+ * enclosing variables that occur free in it, followed by x1...xk. The
+ * variables that are free in the whole term stay free; they are constants.
+ * The body of each supercombinator is compiled to instructions that build
+ * its instance directly, rather than walking and copying a template:
+ *
+ *	PUSH n		Push the nth item of the stack (0 is the top)
+ *	PUSHGLOBAL s	Push the node of supercombinator s
+ *	PUSHNODE n	Push node n, a free variable
+ *	MKAP		Pop f and then a, and push the application (f a)
+ *	UPDATE n	Pop the result, and overwrite the nth item (the root of
+ *			the redex) with an indirection to it
+ *	POP n		Pop n items
+ *	UNWIND		Pop the top item, and carry on unwinding from it
+ *
+ * The graph is reduced by unwinding the spine of applications. When the
+ * head is a supercombinator with all of its arguments, the spine is
+ * rearranged so that the arguments themselves are on the stack above the
+ * root of the redex, and the supercombinator's code is run. The root is
+ * updated in place, so a shared redex is reduced only once.
+ *
+ * The read-back is the one of combinator.c: reduce to weak head normal
+ * form; if the head is a free variable, read back its arguments, and if it
+ * is a supercombinator that is missing arguments, apply the graph to a fresh
+ * variable and abstract over that variable. The result is then η-reduced,
+ * like the input to betaReduce(). */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+#include "g-machine.h"
+
+/* const long maxGMachineSteps = 1L << 22; */
+#define maxGMachineSteps (1L << 22)
+/* const int maxGMachineReadBackDepth = 50000; */
+#define maxGMachineReadBackDepth 50000
+
+typedef enum {
+	gmNodeType_Application,
+	gmNodeType_Variable, /* A free variable */
+	gmNodeType_Global, /* A supercombinator */
+	gmNodeType_Indirection /* An updated redex; left is its value */
+} GmNodeType;
+
+typedef struct {
+	GmNodeType type;
+	int left; /* For applications and indirections; the supercombinator of a global */
+	int right; /* For applications */
+	char * name; /* For variables; it points into an LC_EXPR */
+} GM_NODE;
+
+typedef enum {
+	gmOp_Push,
+	gmOp_PushGlobal,
+	gmOp_PushNode,
+	gmOp_MkAp,
+	gmOp_Update,
+	gmOp_Pop,
+	gmOp_Unwind
+} GmOpcode;
+
+typedef struct {
+	GmOpcode op;
+	int arg;
+} GM_INSTRUCTION;
+
+typedef struct {
+	int arity;
+	int code; /* The index of its first instruction */
+	int node; /* Its global node */
+	LC_EXPR * body; /* To be compiled */
+	char ** params; /* The names of its parameters; params[0] is the first */
+} GM_SUPERCOMBINATOR;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	GM_NODE * nodes;
+	int numNodes;
+	int nodeCapacity;
+	GM_INSTRUCTION * code;
+	int codeSize;
+	int codeCapacity;
+	GM_SUPERCOMBINATOR * supercombinators;
+	int numSupercombinators;
+	int supercombinatorCapacity;
+	int * stack;
+	int stackSize;
+	int stackCapacity;
+	long numSteps;
+	BOOL failed;
+	LC_EXPR * term; /* The input, whose free variables must not be captured */
+} G_MACHINE;
+
+typedef struct GM_SCOPE_STRUCT {
+	char * name;
+	struct GM_SCOPE_STRUCT * next;
+} GM_SCOPE; /* The variables bound inside a lambda that is being lifted */
+
+/* **** Allocation **** */
+
+void printGMachineMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("G-machine", &ctx->gMachineCounts);
+}
+
+static void * gmRealloc(G_MACHINE * gm, void * ptr, size_t size) {
+	return countedRealloc(&gm->ctx->gMachineCounts, ptr, size);
+}
+
+static void gmFree(G_MACHINE * gm, void * ptr) {
+	countedFree(&gm->ctx->gMachineCounts, ptr);
+}
+
+static int createNode(G_MACHINE * gm, GmNodeType type, int left, int right) {
+
+	if (gm->numNodes == gm->nodeCapacity) {
+		gm->nodeCapacity = (gm->nodeCapacity == 0) ? 256 : 2 * gm->nodeCapacity;
+		gm->nodes = (GM_NODE *)gmRealloc(gm, gm->nodes, gm->nodeCapacity * sizeof(GM_NODE));
+	}
+
+	const int n = gm->numNodes++;
+	GM_NODE * node = &gm->nodes[n];
+
+	node->type = type;
+	node->left = left;
+	node->right = right;
+	node->name = NULL;
+
+	return n;
+}
+
+static int createVariableNode(G_MACHINE * gm, char * name) {
+	const int n = createNode(gm, gmNodeType_Variable, -1, -1);
+
+	gm->nodes[n].name = name;
+
+	return n;
+}
+
+static int createApplication(G_MACHINE * gm, int left, int right) {
+	return createNode(gm, gmNodeType_Application, left, right);
+}
+
+static void emit(G_MACHINE * gm, GmOpcode op, int arg) {
+
+	if (gm->codeSize == gm->codeCapacity) {
+		gm->codeCapacity = (gm->codeCapacity == 0) ? 256 : 2 * gm->codeCapacity;
+		gm->code = (GM_INSTRUCTION *)gmRealloc(gm, gm->code, gm->codeCapacity * sizeof(GM_INSTRUCTION));
+	}
+
+	gm->code[gm->codeSize].op = op;
+	gm->code[gm->codeSize].arg = arg;
+	++gm->codeSize;
+}
+
+static void push(G_MACHINE * gm, int n) {
+
+	if (gm->stackSize == gm->stackCapacity) {
+		gm->stackCapacity = (gm->stackCapacity == 0) ? 64 : 2 * gm->stackCapacity;
+		gm->stack = (int *)gmRealloc(gm, gm->stack, gm->stackCapacity * sizeof(int));
+	}
+
+	gm->stack[gm->stackSize++] = n;
+}
+
+/* **** Lambda lifting **** */
+
+static int findParam(GM_SUPERCOMBINATOR * sc, char * name) {
+	/* The last parameter with the name is the innermost binding */
+	int i;
+
+	for (i = sc->arity - 1; i >= 0; --i) {
+
+		if (!strcmp(sc->params[i], name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static BOOL isBoundInScope(GM_SCOPE * scope, char * name) {
+
+	for (; scope != NULL; scope = scope->next) {
+
+		if (!strcmp(scope->name, name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void findFreeParams(GM_SUPERCOMBINATOR * sc, LC_EXPR * expr, GM_SCOPE * scope, char ** freeParams, int * numFreeParams) {
+	/* Collect, once each, the parameters of sc that occur free in expr */
+	GM_SCOPE innerScope;
+	int i;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+
+			if (isBoundInScope(scope, expr->name) || findParam(sc, expr->name) < 0) {
+				return;
+			}
+
+			for (i = 0; i < *numFreeParams; ++i) {
+
+				if (!strcmp(freeParams[i], expr->name)) {
+					return;
+				}
+			}
+
+			freeParams[(*numFreeParams)++] = expr->name;
+			break;
+
+		case lcExpressionType_LambdaExpr:
+			innerScope.name = expr->name;
+			innerScope.next = scope;
+			findFreeParams(sc, expr->expr, &innerScope, freeParams, numFreeParams);
+			break;
+
+		case lcExpressionType_FunctionCall:
+			findFreeParams(sc, expr->expr, scope, freeParams, numFreeParams);
+			findFreeParams(sc, expr->expr2, scope, freeParams, numFreeParams);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static int addSupercombinator(G_MACHINE * gm, int arity, LC_EXPR * body) {
+
+	if (gm->numSupercombinators == gm->supercombinatorCapacity) {
+		gm->supercombinatorCapacity = (gm->supercombinatorCapacity == 0) ? 16 : 2 * gm->supercombinatorCapacity;
+		gm->supercombinators = (GM_SUPERCOMBINATOR *)gmRealloc(gm, gm->supercombinators, gm->supercombinatorCapacity * sizeof(GM_SUPERCOMBINATOR));
+	}
+
+	const int s = gm->numSupercombinators++;
+	GM_SUPERCOMBINATOR * sc = &gm->supercombinators[s];
+
+	sc->arity = arity;
+	sc->code = -1;
+	sc->node = createNode(gm, gmNodeType_Global, s, -1);
+	sc->body = body;
+	sc->params = (arity > 0) ? (char **)gmRealloc(gm, NULL, arity * sizeof(char *)) : NULL;
+
+	return s;
+}
+
+static int liftLambda(G_MACHINE * gm, char ** freeParams, int numFreeParams, LC_EXPR * lambda) {
+	/* Create a supercombinator with the parameters freeParams followed by
+	those of the run of lambdas that starts at lambda. It is compiled later
+	(see compileSupercombinators()), so that the code of each one is
+	contiguous. */
+	LC_EXPR * body = lambda;
+	int arity = numFreeParams;
+	int i;
+
+	for (; body->type == lcExpressionType_LambdaExpr; body = body->expr) {
+		++arity;
+	}
+
+	const int s = addSupercombinator(gm, arity, body);
+	GM_SUPERCOMBINATOR * sc = &gm->supercombinators[s];
+
+	for (i = 0; i < numFreeParams; ++i) {
+		sc->params[i] = freeParams[i];
+	}
+
+	for (body = lambda; body->type == lcExpressionType_LambdaExpr; body = body->expr) {
+		sc->params[i++] = body->name;
+	}
+
+	return s;
+}
+
+/* **** Compilation to G-machine code **** */
+
+static void compileExpr(G_MACHINE * gm, int s, LC_EXPR * expr, int depth) {
+	/* The scheme C: emit code that pushes the instance of expr, in the body
+	of supercombinator s, with depth items on the stack above its arguments.
+	Note that gm->supercombinators can move when a lambda is lifted. */
+	int i;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+			i = findParam(&gm->supercombinators[s], expr->name);
+
+			if (i >= 0) {
+				emit(gm, gmOp_Push, i + depth);
+			} else {
+				emit(gm, gmOp_PushNode, createVariableNode(gm, expr->name));
+			}
+
+			break;
+
+		case lcExpressionType_LambdaExpr: {
+			/* They are distinct parameters of s, so there are at most its arity */
+			char ** freeParams = (char **)gmRealloc(gm, NULL, (gm->supercombinators[s].arity + 1) * sizeof(char *));
+			int numFreeParams = 0;
+
+			findFreeParams(&gm->supercombinators[s], expr, NULL, freeParams, &numFreeParams);
+
+			const int lifted = liftLambda(gm, freeParams, numFreeParams, expr);
+
+			/* ((lifted freeParams[0]) ... freeParams[n - 1]) */
+			for (i = numFreeParams - 1; i >= 0; --i) {
+				emit(gm, gmOp_Push, findParam(&gm->supercombinators[s], freeParams[i]) + depth + (numFreeParams - 1 - i));
+			}
+
+			emit(gm, gmOp_PushGlobal, lifted);
+
+			for (i = 0; i < numFreeParams; ++i) {
+				emit(gm, gmOp_MkAp, 0);
+			}
+
+			gmFree(gm, freeParams);
+			break;
+		}
+
+		case lcExpressionType_FunctionCall:
+			compileExpr(gm, s, expr->expr2, depth);
+			compileExpr(gm, s, expr->expr, depth + 1);
+			emit(gm, gmOp_MkAp, 0);
+			break;
+
+		default:
+			/* E.g. an integer literal */
+			gm->failed = TRUE;
+			emit(gm, gmOp_PushNode, createVariableNode(gm, "?"));
+			break;
+	}
+}
+
+static void compileSupercombinators(G_MACHINE * gm, int first) {
+	/* The scheme R: build the instance of the body, update the root of the
+	redex with it, and carry on unwinding from there. Compiling one may lift
+	more of them. */
+	int s;
+
+	for (s = first; s < gm->numSupercombinators && !gm->failed; ++s) {
+		gm->supercombinators[s].code = gm->codeSize;
+		compileExpr(gm, s, gm->supercombinators[s].body, 0);
+		emit(gm, gmOp_Update, gm->supercombinators[s].arity);
+		emit(gm, gmOp_Pop, gm->supercombinators[s].arity);
+		emit(gm, gmOp_Unwind, 0);
+	}
+}
+
+static int compileProgram(G_MACHINE * gm, LC_EXPR * expr) {
+	/* Returns the index of the first instruction of the code that builds
+	the graph of expr; it is run by runCode(). The top level has no
+	parameters, so it is compiled as the body of a supercombinator of arity
+	zero, which is never unwound. */
+	const int topLevel = addSupercombinator(gm, 0, expr);
+
+	gm->supercombinators[topLevel].code = gm->codeSize;
+	compileExpr(gm, topLevel, expr, 0);
+	emit(gm, gmOp_Unwind, 0);
+	compileSupercombinators(gm, topLevel + 1);
+
+	return gm->supercombinators[topLevel].code;
+}
+
+/* **** Graph reduction **** */
+
+static int followIndirections(G_MACHINE * gm, int n) {
+
+	while (gm->nodes[n].type == gmNodeType_Indirection) {
+		n = gm->nodes[n].left;
+	}
+
+	return n;
+}
+
+static int runCode(G_MACHINE * gm, int pc) {
+	/* Run the code from pc up to an UNWIND, and return the node that it
+	pops */
+
+	for (;; ++pc) {
+		const GM_INSTRUCTION * instruction = &gm->code[pc];
+		int f;
+		int a;
+
+		switch (instruction->op) {
+			case gmOp_Push:
+				push(gm, gm->stack[gm->stackSize - 1 - instruction->arg]);
+				break;
+
+			case gmOp_PushGlobal:
+				push(gm, gm->supercombinators[instruction->arg].node);
+				break;
+
+			case gmOp_PushNode:
+				push(gm, instruction->arg);
+				break;
+
+			case gmOp_MkAp:
+				f = gm->stack[--gm->stackSize];
+				a = gm->stack[gm->stackSize - 1];
+				gm->stack[gm->stackSize - 1] = createApplication(gm, f, a);
+				break;
+
+			case gmOp_Update:
+				a = followIndirections(gm, gm->stack[--gm->stackSize]);
+				f = gm->stack[gm->stackSize - 1 - instruction->arg];
+
+				if (a == f) {
+					/* The redex reduces to itself */
+					gm->failed = TRUE;
+					break;
+				}
+
+				gm->nodes[f].type = gmNodeType_Indirection;
+				gm->nodes[f].left = a;
+				break;
+
+			case gmOp_Pop:
+				gm->stackSize -= instruction->arg;
+				break;
+
+			case gmOp_Unwind:
+			default:
+				return gm->stack[--gm->stackSize];
+		}
+	}
+}
+
+static int reduceToWeakHeadNormalForm(G_MACHINE * gm, int n, int base) {
+	/* Unwinds the spine of n onto the stack above base, reducing as it goes.
+	Returns the head; stack[base] is the outermost application, and the top
+	of the stack is the application of the head to its first argument. */
+	int i;
+
+	gm->stackSize = base;
+
+	while (!gm->failed) {
+		n = followIndirections(gm, n);
+
+		if (gm->nodes[n].type == gmNodeType_Application) {
+			push(gm, n);
+			gm->nodes[n].left = followIndirections(gm, gm->nodes[n].left);
+			n = gm->nodes[n].left;
+			continue;
+		}
+
+		if (gm->nodes[n].type != gmNodeType_Global) {
+			return n; /* A free variable */
+		}
+
+		const GM_SUPERCOMBINATOR * sc = &gm->supercombinators[gm->nodes[n].left];
+		const int arity = sc->arity;
+
+		if (gm->stackSize - base < arity) {
+			return n; /* A partial application */
+		}
+
+		/* Rearrange the spine: the root of the redex stays where it is, and
+		the arguments go above it, with the first one on top */
+		const int root = gm->stackSize - arity;
+
+		push(gm, -1);
+
+		for (i = arity; i > 0; --i) {
+			gm->stack[root + i] = followIndirections(gm, gm->nodes[gm->stack[root + i - 1]].right);
+		}
+
+		n = runCode(gm, sc->code);
+
+		if (++gm->numSteps > maxGMachineSteps) {
+			gm->failed = TRUE;
+		}
+	}
+
+	return n;
+}
+
+/* **** Read-back to LC_EXPR **** */
+
+static LC_EXPR * readBack(G_MACHINE * gm, int n, int depth) {
+	const int base = gm->stackSize;
+	int i;
+
+	if (depth > maxGMachineReadBackDepth) {
+		gm->failed = TRUE;
+	}
+
+	const int head = reduceToWeakHeadNormalForm(gm, n, base);
+
+	if (gm->failed) {
+		gm->stackSize = base;
+		return NULL;
+	}
+
+	if (gm->nodes[head].type != gmNodeType_Variable) {
+		/* A supercombinator that is missing some arguments: η-expand */
+		char buf[maxStringValueLength];
+
+		gm->stackSize = base;
+
+		do {
+			generateNewVariableName(gm->ctx, buf, maxStringValueLength);
+		} while (containsUnboundVariableNamed(gm->ctx, gm->term, buf, NULL));
+
+		LC_EXPR * variable = createVariable(gm->ctx, buf);
+		LC_EXPR * body = readBack(gm, createApplication(gm, n, createVariableNode(gm, variable->name)), depth + 1);
+
+		return (body == NULL) ? NULL : createLambdaExpr(gm->ctx, buf, body);
+	}
+
+	/* A free variable applied to zero or more arguments. The stack may grow
+	(and move) while we read back the arguments, so index it afresh. */
+	const int numArgs = gm->stackSize - base;
+	LC_EXPR * result = createVariable(gm->ctx, gm->nodes[head].name);
+
+	for (i = numArgs - 1; i >= 0 && result != NULL; --i) {
+		const int arg = gm->nodes[gm->stack[base + i]].right;
+		const int savedStackSize = gm->stackSize;
+
+		LC_EXPR * argExpr = readBack(gm, arg, depth + 1);
+
+		gm->stackSize = savedStackSize;
+		result = (argExpr == NULL) ? NULL : createFunctionCall(gm->ctx, result, argExpr);
+	}
+
+	gm->stackSize = base;
+
+	return result;
+}
+
+/* **** The engine **** */
+
+LC_EXPR * reduceWithGMachine(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
+	G_MACHINE gm;
+	LC_EXPR * result = NULL;
+	int s;
+
+	if (ctx->enableDeltaReduction) {
+		/* The primitives would be taken for free variables */
+		return betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	memset(&gm, 0, sizeof(G_MACHINE));
+	gm.ctx = ctx;
+	gm.term = expr;
+
+	const int code = compileProgram(&gm, expr);
+
+	if (!gm.failed) {
+		result = readBack(&gm, runCode(&gm, code), 0);
+	}
+
+	if (result == NULL) {
+		fprintf(stderr, "reduceWithGMachine() : %s after %ld steps; using normal order instead\n",
+			(gm.numSteps > maxGMachineSteps) ? "Too many steps" : "Cannot compile or read back the term",
+			gm.numSteps);
+		result = betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	} else {
+		result = etaReduce(ctx, result);
+	}
+
+	for (s = 0; s < gm.numSupercombinators; ++s) {
+		gmFree(&gm, gm.supercombinators[s].params);
+	}
+
+	gmFree(&gm, gm.supercombinators);
+	gmFree(&gm, gm.stack);
+	gmFree(&gm, gm.code);
+	gmFree(&gm, gm.nodes);
+
+	return result;
+}
+
+/* **** The End **** */
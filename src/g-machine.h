@@ -0,0 +1,6 @@
+/* facility/src/g-machine.h */
+
+void printGMachineMemMgrReport(LC_CONTEXT * ctx);
+LC_EXPR * reduceWithGMachine(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth);
+
+/* **** The End **** */
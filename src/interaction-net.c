@@ -0,0 +1,765 @@
+/* facility/src/interaction-net.c */
+
+/* An alternative reduction engine based on interaction nets: Lamping's
+ * abstract algorithm (without the bracket and croissant "oracle").
+ *
+ * The term is compiled into a graph of agents, each with one principal port
+ * and zero or more auxiliary ports:
+ *
+ *	Lambda:       principal = the lambda; aux 1 = body; aux 2 = variable
+ *	Application:  principal = the callee; aux 1 = result; aux 2 = argument
+ *	Fan:          principal = the shared value; aux 1, aux 2 = the two uses
+ *	Eraser:       principal only; marks a value that is never used
+ *	Free variable: principal only
+ *
+ * Two agents interact only when they are connected by their principal ports,
+ * and every rewrite rule is local: lambda-application is a β-step; fans with
+ * the same label annihilate; any other pair commutes (the agents pass through
+ * one another, copying themselves); erasers erase. Because a fan duplicates a
+ * lambda's body incrementally, as it is needed, work inside a shared body is
+ * never duplicated, which is what makes e.g. Church-numeral exponentiation
+ * cheap here.
+ *
+ * Every variable-sharing fan gets a label of its own, and copies keep their
+ * label. This is exact for the terms of elementary affine logic (which
+ * include the Church-numeral arithmetic), but for some terms in which a
+ * duplicated function duplicates its own argument, fans with equal labels
+ * can meet by accident. The read-back detects the inconsistent paths that
+ * this produces; reduceWithInteractionNet() then falls back on normal order.
+ *
+ * Reduction is lazy: we reduce only the redexes that are reachable from the
+ * root, starting with those that the root's weak head normal form needs,
+ * so the net of an erased, divergent argument is never reduced. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+#include "interaction-net.h"
+
+/* const long maxInteractions = 1L << 24; */
+#define maxInteractions (1L << 24)
+/* const int maxReadBackDepth = 50000; */
+#define maxReadBackDepth 50000
+
+/* A port is (nodeIndex << 2) | portNumber. Port 0 is the principal port. */
+#define makePort(n, p) (((n) << 2) | (p))
+#define portNode(port) ((port) >> 2)
+#define portNumber(port) ((port) & 3)
+
+enum {
+	inetNodeType_Free, /* A node in the free list */
+	inetNodeType_Root, /* Port 0 is connected to the term; never interacts */
+	inetNodeType_Lambda,
+	inetNodeType_Application,
+	inetNodeType_Fan,
+	inetNodeType_Eraser,
+	inetNodeType_FreeVariable
+};
+
+typedef struct {
+	int type;
+	int label; /* For fans */
+	int ports[3];
+	int generation; /* Incremented whenever the node is freed */
+	int mark; /* For the traversal in normalizeNet() */
+	char * name; /* For lambdas and free variables: the name in the source */
+	char * readBackName; /* For lambdas, during read-back */
+} INET_NODE;
+
+typedef struct {
+	int * items;
+	int size;
+	int capacity;
+} INET_STACK;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	INET_NODE * nodes;
+	int numNodes;
+	int capacity;
+	int freeList; /* Linked through ports[0]; -1 if empty */
+	int numLabels;
+	long numInteractions;
+	int markGeneration;
+	BOOL failed;
+} INTERACTION_NET;
+
+/* A lexically enclosing binder, during compilation */
+
+typedef struct INET_BINDER_STRUCT {
+	char * name;
+	int lambdaNode;
+	int lastPort; /* The port to which the latest use of the variable is connected */
+	struct INET_BINDER_STRUCT * next;
+} INET_BINDER;
+
+/* **** Allocation **** */
+
+void printInteractionNetMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Interaction nets", &ctx->interactionNetCounts);
+}
+
+static void * inetMalloc(INTERACTION_NET * net, size_t size) {
+	return countedRealloc(&net->ctx->interactionNetCounts, NULL, size);
+}
+
+static void * inetRealloc(INTERACTION_NET * net, void * ptr, size_t size) {
+	return countedRealloc(&net->ctx->interactionNetCounts, ptr, size);
+}
+
+static void inetFree(INTERACTION_NET * net, void * ptr) {
+	countedFree(&net->ctx->interactionNetCounts, ptr);
+}
+
+static void stackPush(INTERACTION_NET * net, INET_STACK * stack, int item) {
+
+	if (stack->size == stack->capacity) {
+		stack->capacity = (stack->capacity == 0) ? 64 : 2 * stack->capacity;
+		stack->items = (int *)inetRealloc(net, stack->items, stack->capacity * sizeof(int));
+	}
+
+	stack->items[stack->size++] = item;
+}
+
+static int createNode(INTERACTION_NET * net, int type) {
+	int n;
+
+	if (net->freeList >= 0) {
+		n = net->freeList;
+		net->freeList = net->nodes[n].ports[0];
+	} else {
+
+		if (net->numNodes == net->capacity) {
+			net->capacity = (net->capacity == 0) ? 256 : 2 * net->capacity;
+			net->nodes = (INET_NODE *)inetRealloc(net, net->nodes, net->capacity * sizeof(INET_NODE));
+		}
+
+		n = net->numNodes++;
+		net->nodes[n].generation = 0;
+	}
+
+	INET_NODE * node = &net->nodes[n];
+
+	node->type = type;
+	node->label = 0;
+	node->ports[0] = node->ports[1] = node->ports[2] = -1;
+	node->mark = 0;
+	node->name = NULL;
+	node->readBackName = NULL;
+
+	return n;
+}
+
+static void freeNode(INTERACTION_NET * net, int n) {
+	INET_NODE * node = &net->nodes[n];
+
+	node->type = inetNodeType_Free;
+	++node->generation;
+	node->ports[0] = net->freeList;
+	net->freeList = n;
+}
+
+static int getArity(int type) {
+
+	switch (type) {
+		case inetNodeType_Lambda:
+		case inetNodeType_Application:
+		case inetNodeType_Fan:
+			return 2;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+static int partner(INTERACTION_NET * net, int port) {
+	return net->nodes[portNode(port)].ports[portNumber(port)];
+}
+
+static void linkPorts(INTERACTION_NET * net, int port1, int port2) {
+	net->nodes[portNode(port1)].ports[portNumber(port1)] = port2;
+	net->nodes[portNode(port2)].ports[portNumber(port2)] = port1;
+}
+
+/* **** Compilation from LC_EXPR **** */
+
+static int compileExpr(INTERACTION_NET * net, LC_EXPR * expr, INET_BINDER * binders) {
+	/* Returns the port at which the value of expr comes out. The caller must
+	link it before compiling anything else, because a later use of the same
+	variable relinks the earlier use's connection (see below). */
+	INET_BINDER * binder;
+	INET_BINDER newBinder;
+	int n;
+
+	switch (expr->type) {
+		case lcExpressionType_Variable:
+
+			for (binder = binders; binder != NULL; binder = binder->next) {
+
+				if (!strcmp(binder->name, expr->name)) {
+					break;
+				}
+			}
+
+			if (binder == NULL) {
+				n = createNode(net, inetNodeType_FreeVariable);
+				net->nodes[n].name = expr->name;
+
+				return makePort(n, 0);
+			}
+
+			if (binder->lastPort < 0) {
+				/* The first use is connected straight to the lambda's variable port */
+				binder->lastPort = makePort(binder->lambdaNode, 2);
+
+				return binder->lastPort;
+			}
+
+			/* Insert a fan between the previous use and the port that it
+			was connected to: the previous use moves to the fan's aux 1,
+			and this use comes out of its aux 2. */
+			n = createNode(net, inetNodeType_Fan);
+			net->nodes[n].label = net->numLabels++;
+
+			const int previousUse = partner(net, binder->lastPort);
+
+			linkPorts(net, binder->lastPort, makePort(n, 0));
+			linkPorts(net, makePort(n, 1), previousUse);
+			binder->lastPort = makePort(n, 2);
+
+			return binder->lastPort;
+
+		case lcExpressionType_LambdaExpr:
+			n = createNode(net, inetNodeType_Lambda);
+			net->nodes[n].name = expr->name;
+			newBinder.name = expr->name;
+			newBinder.lambdaNode = n;
+			newBinder.lastPort = -1;
+			newBinder.next = binders;
+			linkPorts(net, makePort(n, 1), compileExpr(net, expr->expr, &newBinder));
+
+			if (newBinder.lastPort < 0) {
+				/* The variable is never used */
+				linkPorts(net, makePort(n, 2), makePort(createNode(net, inetNodeType_Eraser), 0));
+			}
+
+			return makePort(n, 0);
+
+		case lcExpressionType_FunctionCall:
+			n = createNode(net, inetNodeType_Application);
+			linkPorts(net, makePort(n, 0), compileExpr(net, expr->expr, binders));
+			linkPorts(net, makePort(n, 2), compileExpr(net, expr->expr2, binders));
+
+			return makePort(n, 1);
+
+		default:
+			break;
+	}
+
+	net->failed = TRUE;
+
+	return makePort(createNode(net, inetNodeType_Eraser), 0);
+}
+
+/* **** Interaction rules **** */
+
+static BOOL hasInteractionRule(int type1, int type2) {
+
+	if (type1 == inetNodeType_Root || type2 == inetNodeType_Root) {
+		return FALSE;
+	}
+
+	if (type1 == inetNodeType_Fan || type2 == inetNodeType_Fan ||
+		type1 == inetNodeType_Eraser || type2 == inetNodeType_Eraser) {
+		return TRUE;
+	}
+
+	return (type1 == inetNodeType_Lambda && type2 == inetNodeType_Application) ||
+		(type1 == inetNodeType_Application && type2 == inetNodeType_Lambda);
+}
+
+static BOOL isAuxPortOf(int port, int a, int b) {
+	return portNumber(port) != 0 && (portNode(port) == a || portNode(port) == b);
+}
+
+static void annihilate(INTERACTION_NET * net, int a, int b) {
+	/* Connect whatever was attached to aux i of a to whatever was attached
+	to aux i of b: the β-rule (with a = the lambda) and the rule for two fans
+	with the same label. If an aux port of a is wired straight to an aux port
+	of b, follow the wire through to the next rule pair. */
+	int i;
+
+	for (i = 0; i < 4; ++i) {
+		const int x = makePort(i < 2 ? a : b, i % 2 + 1);
+		const int ext = partner(net, x);
+
+		if (isAuxPortOf(ext, a, b)) {
+			continue; /* Not an end of a path */
+		}
+
+		int y = makePort(portNode(x) == a ? b : a, portNumber(x));
+
+		while (isAuxPortOf(partner(net, y), a, b)) {
+			const int z = partner(net, y);
+
+			y = makePort(portNode(z) == a ? b : a, portNumber(z));
+		}
+
+		/* Each path is found from both of its ends; link it once. */
+
+		if (x < y) {
+			const int ext2 = partner(net, y);
+
+			net->nodes[portNode(ext)].ports[portNumber(ext)] = ext2;
+			net->nodes[portNode(ext2)].ports[portNumber(ext2)] = ext;
+		}
+	}
+
+	freeNode(net, a);
+	freeNode(net, b);
+}
+
+static void commute(INTERACTION_NET * net, int a, int b) {
+	/* Each agent passes through the other: make one copy of a for each of
+	b's aux ports, and one copy of b for each of a's aux ports. Copy j of a
+	takes the place of b's aux port j, and vice versa. */
+	const int typeA = net->nodes[a].type;
+	const int typeB = net->nodes[b].type;
+	const int arityA = getArity(typeA);
+	const int arityB = getArity(typeB);
+	int copiesOfA[2];
+	int copiesOfB[2];
+	int auxA[2];
+	int auxB[2];
+	int i;
+	int j;
+
+	for (j = 0; j < arityB; ++j) {
+		copiesOfA[j] = createNode(net, typeA);
+		net->nodes[copiesOfA[j]].label = net->nodes[a].label;
+		net->nodes[copiesOfA[j]].name = net->nodes[a].name;
+	}
+
+	for (i = 0; i < arityA; ++i) {
+		copiesOfB[i] = createNode(net, typeB);
+		net->nodes[copiesOfB[i]].label = net->nodes[b].label;
+		net->nodes[copiesOfB[i]].name = net->nodes[b].name;
+	}
+
+	/* Where the old aux ports were wired to each other, use the copies */
+
+	for (i = 0; i < arityA; ++i) {
+		const int ext = partner(net, makePort(a, i + 1));
+
+		auxA[i] = !isAuxPortOf(ext, a, b) ? ext :
+			(portNode(ext) == b) ? makePort(copiesOfA[portNumber(ext) - 1], 0) :
+			makePort(copiesOfB[portNumber(ext) - 1], 0);
+	}
+
+	for (j = 0; j < arityB; ++j) {
+		const int ext = partner(net, makePort(b, j + 1));
+
+		auxB[j] = !isAuxPortOf(ext, a, b) ? ext :
+			(portNode(ext) == a) ? makePort(copiesOfB[portNumber(ext) - 1], 0) :
+			makePort(copiesOfA[portNumber(ext) - 1], 0);
+	}
+
+	for (i = 0; i < arityA; ++i) {
+
+		for (j = 0; j < arityB; ++j) {
+			linkPorts(net, makePort(copiesOfA[j], i + 1), makePort(copiesOfB[i], j + 1));
+		}
+	}
+
+	for (j = 0; j < arityB; ++j) {
+		linkPorts(net, makePort(copiesOfA[j], 0), auxB[j]);
+	}
+
+	for (i = 0; i < arityA; ++i) {
+		linkPorts(net, makePort(copiesOfB[i], 0), auxA[i]);
+	}
+
+	freeNode(net, a);
+	freeNode(net, b);
+}
+
+static void erase(INTERACTION_NET * net, int eraser, int other) {
+	/* Replace each aux port of other with an eraser */
+	const int arity = getArity(net->nodes[other].type);
+	int erasers[2];
+	int aux[2];
+	int i;
+
+	for (i = 0; i < arity; ++i) {
+		erasers[i] = createNode(net, inetNodeType_Eraser);
+	}
+
+	for (i = 0; i < arity; ++i) {
+		const int ext = partner(net, makePort(other, i + 1));
+
+		aux[i] = isAuxPortOf(ext, other, other) ? makePort(erasers[portNumber(ext) - 1], 0) : ext;
+	}
+
+	for (i = 0; i < arity; ++i) {
+		linkPorts(net, makePort(erasers[i], 0), aux[i]);
+	}
+
+	freeNode(net, eraser);
+	freeNode(net, other);
+}
+
+static void interact(INTERACTION_NET * net, int a, int b) {
+	const int typeA = net->nodes[a].type;
+	const int typeB = net->nodes[b].type;
+
+	++net->numInteractions;
+
+	if (typeA == inetNodeType_Eraser) {
+		erase(net, a, b);
+	} else if (typeB == inetNodeType_Eraser) {
+		erase(net, b, a);
+	} else if (typeA == inetNodeType_Lambda && typeB == inetNodeType_Application) {
+		annihilate(net, a, b);
+	} else if (typeA == inetNodeType_Application && typeB == inetNodeType_Lambda) {
+		annihilate(net, b, a);
+	} else if (typeA == inetNodeType_Fan && typeB == inetNodeType_Fan && net->nodes[a].label == net->nodes[b].label) {
+		annihilate(net, a, b);
+	} else {
+		commute(net, a, b);
+	}
+}
+
+/* **** Lazy reduction **** */
+
+static BOOL isActivePair(INTERACTION_NET * net, int port) {
+	const int other = partner(net, port);
+
+	return portNumber(port) == 0 && portNumber(other) == 0 &&
+		hasInteractionRule(net->nodes[portNode(port)].type, net->nodes[portNode(other)].type);
+}
+
+static void reduceToWeakHeadNormalForm(INTERACTION_NET * net, int port, INET_STACK * stack) {
+	/* Reduce until the agent connected to port faces it with its principal
+	port, or is stuck. If it faces port with an aux port, then its principal
+	port must first meet a principal port, so we descend towards that. */
+	const int base = stack->size;
+
+	stackPush(net, stack, port);
+
+	while (stack->size > base && !net->failed) {
+		const int p = stack->items[stack->size - 1];
+
+		if (isActivePair(net, p)) {
+			/* p's own node is consumed by this interaction; the port below
+			it on the stack belongs to a node that survives. */
+			interact(net, portNode(p), portNode(partner(net, p)));
+			--stack->size;
+			continue;
+		}
+
+		const int q = partner(net, p);
+		const int n = portNode(q);
+
+		if (portNumber(q) == 0 || net->nodes[n].type == inetNodeType_Root) {
+			--stack->size;
+			continue;
+		}
+
+		const int principal = makePort(n, 0);
+		const int r = partner(net, principal);
+
+		if (portNumber(r) == 0) {
+
+			if (hasInteractionRule(net->nodes[n].type, net->nodes[portNode(r)].type)) {
+				interact(net, n, portNode(r));
+			} else {
+				/* Stuck, e.g. an application of a free variable; so is
+				everything that is waiting for it. */
+				stack->size = base;
+			}
+		} else if (stack->size - base > net->numNodes) {
+			/* A cycle of agents, none facing the next with its principal
+			port: the net is not the net of any term. */
+			net->failed = TRUE;
+		} else {
+			stackPush(net, stack, principal);
+		}
+
+		if (net->numInteractions > maxInteractions) {
+			net->failed = TRUE;
+		}
+	}
+
+	stack->size = base;
+}
+
+static void normalizeNet(INTERACTION_NET * net, int rootPort) {
+	/* Reduce everything reachable from the root: first to weak head normal
+	form, and then each of the node's other ports in turn. Each item on the
+	work list is a port and its node's generation, so that we can skip ports
+	whose nodes were consumed by interactions in the meantime. */
+	INET_STACK work = { NULL, 0, 0 };
+	INET_STACK stack = { NULL, 0, 0 };
+
+	++net->markGeneration;
+	stackPush(net, &work, rootPort);
+	stackPush(net, &work, net->nodes[portNode(rootPort)].generation);
+
+	while (work.size > 0 && !net->failed) {
+		const int generation = work.items[--work.size];
+		const int port = work.items[--work.size];
+
+		if (net->nodes[portNode(port)].generation != generation) {
+			continue;
+		}
+
+		reduceToWeakHeadNormalForm(net, port, &stack);
+
+		if (net->nodes[portNode(port)].generation != generation) {
+			continue;
+		}
+
+		const int q = partner(net, port);
+		const int n = portNode(q);
+		INET_NODE * node = &net->nodes[n];
+		int i;
+
+		if (node->mark == net->markGeneration) {
+			continue;
+		}
+
+		node->mark = net->markGeneration;
+
+		for (i = getArity(node->type); i >= 0; --i) {
+
+			if (makePort(n, i) != q) {
+				stackPush(net, &work, makePort(n, i));
+				stackPush(net, &work, net->nodes[n].generation);
+			}
+		}
+	}
+
+	inetFree(net, stack.items);
+	inetFree(net, work.items);
+}
+
+/* **** Read-back to LC_EXPR **** */
+
+typedef struct {
+	INET_STACK * fanPaths; /* One stack of aux port numbers per fan label */
+	char ** namesInScope;
+	int numNamesInScope;
+	int maxNamesInScope;
+	INET_STACK freeNames; /* Indices of free variable nodes; for name clashes */
+} INET_READ_BACK;
+
+static BOOL isNameTaken(INTERACTION_NET * net, INET_READ_BACK * rb, char * name) {
+	int i;
+
+	for (i = 0; i < rb->numNamesInScope; ++i) {
+
+		if (!strcmp(rb->namesInScope[i], name)) {
+			return TRUE;
+		}
+	}
+
+	for (i = 0; i < rb->freeNames.size; ++i) {
+
+		if (!strcmp(net->nodes[rb->freeNames.items[i]].name, name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static LC_EXPR * readBack(INTERACTION_NET * net, INET_READ_BACK * rb, int port, int depth) {
+	/* Read back the term whose value comes out at partner(port)'s node */
+	const int q = partner(net, port);
+	const int n = portNode(q);
+	INET_NODE * node = &net->nodes[n];
+	LC_EXPR * result = NULL;
+	char buf[maxStringValueLength];
+	int i;
+
+	if (net->failed || depth > maxReadBackDepth) {
+		net->failed = TRUE;
+		return NULL;
+	}
+
+	switch (node->type) {
+		case inetNodeType_Lambda:
+
+			if (portNumber(q) == 2) {
+				/* A use of the lambda's variable */
+
+				if (node->readBackName == NULL) {
+					net->failed = TRUE;
+					return NULL;
+				}
+
+				return createVariable(net->ctx, node->readBackName);
+			} else if (portNumber(q) != 0 || node->readBackName != NULL) {
+				net->failed = TRUE;
+				return NULL;
+			}
+
+			if (rb->numNamesInScope == rb->maxNamesInScope) {
+				rb->maxNamesInScope *= 2;
+				rb->namesInScope = (char **)inetRealloc(net, rb->namesInScope, rb->maxNamesInScope * sizeof(char *));
+			}
+
+			/* Choose a name that does not capture or shadow anything */
+			memset(buf, 0, maxStringValueLength);
+			strcpy(buf, node->name);
+
+			for (i = 1; isNameTaken(net, rb, buf); ++i) {
+				memset(buf, 0, maxStringValueLength);
+				snprintf(buf, maxStringValueLength - 1, "%.2s%d", node->name, i % 10000);
+			}
+
+			LC_EXPR * var = createVariable(net->ctx, buf); /* Holds the name */
+
+			rb->namesInScope[rb->numNamesInScope++] = var->name;
+			node->readBackName = var->name;
+
+			LC_EXPR * body = readBack(net, rb, makePort(n, 1), depth + 1);
+
+			node = &net->nodes[n];
+			node->readBackName = NULL;
+			--rb->numNamesInScope;
+
+			return (body == NULL) ? NULL : createLambdaExpr(net->ctx, var->name, body);
+
+		case inetNodeType_Application:
+
+			if (portNumber(q) != 1) {
+				net->failed = TRUE;
+				return NULL;
+			}
+
+			LC_EXPR * callee = readBack(net, rb, makePort(n, 0), depth + 1);
+			LC_EXPR * arg = readBack(net, rb, makePort(n, 2), depth + 1);
+
+			return (callee == NULL || arg == NULL) ? NULL : createFunctionCall(net->ctx, callee, arg);
+
+		case inetNodeType_Fan:
+
+			if (portNumber(q) != 0) {
+				/* Entering through a copy: remember which copy, and read
+				back the shared value. */
+				stackPush(net, &rb->fanPaths[node->label], portNumber(q));
+				result = readBack(net, rb, makePort(n, 0), depth + 1);
+				--rb->fanPaths[net->nodes[n].label].size;
+			} else {
+				/* Leaving a shared value: take the copy that we entered by */
+				INET_STACK * path = &rb->fanPaths[node->label];
+
+				if (path->size == 0) {
+					net->failed = TRUE;
+					return NULL;
+				}
+
+				const int auxPort = path->items[--path->size];
+
+				result = readBack(net, rb, makePort(n, auxPort), depth + 1);
+				stackPush(net, path, auxPort);
+			}
+
+			return result;
+
+		case inetNodeType_FreeVariable:
+			return createVariable(net->ctx, node->name);
+
+		default:
+			break;
+	}
+
+	net->failed = TRUE;
+
+	return NULL;
+}
+
+static LC_EXPR * readBackNet(INTERACTION_NET * net, int rootPort) {
+	INET_READ_BACK rb;
+	int i;
+
+	rb.fanPaths = (INET_STACK *)inetMalloc(net, (net->numLabels + 1) * sizeof(INET_STACK));
+	memset(rb.fanPaths, 0, (net->numLabels + 1) * sizeof(INET_STACK));
+	rb.maxNamesInScope = 64;
+	rb.namesInScope = (char **)inetMalloc(net, rb.maxNamesInScope * sizeof(char *));
+	rb.numNamesInScope = 0;
+	rb.freeNames.items = NULL;
+	rb.freeNames.size = 0;
+	rb.freeNames.capacity = 0;
+
+	for (i = 0; i < net->numNodes; ++i) {
+
+		if (net->nodes[i].type == inetNodeType_FreeVariable) {
+			stackPush(net, &rb.freeNames, i);
+		}
+	}
+
+	LC_EXPR * result = readBack(net, &rb, rootPort, 0);
+
+	for (i = 0; i <= net->numLabels; ++i) {
+		inetFree(net, rb.fanPaths[i].items);
+	}
+
+	inetFree(net, rb.freeNames.items);
+	inetFree(net, rb.namesInScope);
+	inetFree(net, rb.fanPaths);
+
+	return net->failed ? NULL : result;
+}
+
+/* **** The engine **** */
+
+LC_EXPR * reduceWithInteractionNet(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
+	INTERACTION_NET net;
+
+	if (ctx->enableDeltaReduction) {
+		/* The net has no nodes for literals or primitives */
+		return betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	memset(&net, 0, sizeof(INTERACTION_NET));
+	net.ctx = ctx;
+	net.freeList = -1;
+
+	/* Like betaReduce(), begin with η-reduction */
+	expr = etaReduce(ctx, expr);
+
+	const int root = createNode(&net, inetNodeType_Root);
+
+	linkPorts(&net, makePort(root, 0), compileExpr(&net, expr, NULL));
+	normalizeNet(&net, makePort(root, 0));
+
+	LC_EXPR * result = net.failed ? NULL : readBackNet(&net, makePort(root, 0));
+
+	if (result == NULL) {
+		fprintf(stderr, "reduceWithInteractionNet() : %s after %ld interactions; using normal order instead\n",
+			net.numInteractions > maxInteractions ? "Too many interactions" : "Inconsistent read-back",
+			net.numInteractions);
+		result = betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	inetFree(&net, net.nodes);
+
+	return result;
+}
+
+/* **** The End **** */
@@ -0,0 +1,6 @@
+/* facility/src/interaction-net.h */
+
+void printInteractionNetMemMgrReport(LC_CONTEXT * ctx);
+LC_EXPR * reduceWithInteractionNet(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth);
+
+/* **** The End **** */
@@ -4,6 +4,12 @@
 
 /* To compile and link: $ make */
 /* To run tests: $ ./facility -t */
+/* To reduce one expression per line of a file: $ ./facility -b file -j 4 */
+/* To also split each reduction over 8 threads: $ ./facility -b file -j 1 -p 8 */
+/* To record a trace of the reduction steps: $ ./facility -b file -r trace.bin */
+/* To summarize the trace: $ make tools/trace-summary && tools/trace-summary trace.bin */
+/* To write memory telemetry as JSON at exit: $ ./facility -b file -M memory.json */
+/* To limit each reduction to 100000 allocations and 500 ms: $ ./facility -b file -a 100000 -w 500 */
 /* To remove all build products: $ make clean */
 /* To do all of the above: $ make clean && make && ./facility -t */
 
@@ -31,39 +37,42 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 /* #include <ctype.h> */
 /* #include <assert.h> */
 
 #include "boolean.h"
 
 #include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 #include "create-and-destroy.h"
 
+#include "batch.h"
 #include "beta-reduction.h"
 #include "char-source.h"
+#include "combinator.h"
+#include "compiler.h"
+#include "explicit-substitution.h"
+#include "g-machine.h"
+#include "compact-expr.h"
+#include "flat-expr.h"
 #include "de-bruijn.h"
+#include "interaction-net.h"
+#include "normalization-by-evaluation.h"
+#include "parser.h"
+#include "printer.h"
+#include "repl.h"
 #include "string-set.h"
-#include "memory-manager.h"
-
-static int numMallocs = 0;
-static int numFrees = 0;
+#include "task-scheduler.h"
+#include "telemetry.h"
+#include "trace.h"
 
 // **** Memory manager functions ****
 
-void generateMemoryManagementReport() {
+void generateMemoryManagementReport(LC_CONTEXT * ctx) {
 	printf("\nMemory management report:\n");
-	printf("  Main: %d mallocs, %d frees", numMallocs, numFrees);
-
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
-	}
-
-	printf("\n");
-	printMemMgrSelfReport();
-	printCreateAndDestroyMemMgrReport();
-	printCharSourceMemMgrReport();
-	printStringSetMemMgrReport();
-	printStringListMemMgrReport();
+	printMemoryTelemetryReport(ctx);
 }
 
 /* Domain Object Model functions */
@@ -72,137 +81,435 @@ void generateMemoryManagementReport() {
 - δ-reduction (delta-reduction) for extended Lambda calculus: the reduction of
 constant arithmetic expressions; e.g. ((+ 2) 3) δ-> 5
 
-- κ-reduction (kappa-reduction) is the reduction of the SKI combinators (?)
+- κ-reduction (kappa-reduction) is the reduction of the SKI combinators;
+see combinator.c
  */
 
-static LC_EXPR * parseExpression(CharSource * cs) {
-	char dstBuf[maxStringValueLength];
-	int c = getNextChar(cs);
+static void parseAndReduceDelegate(LC_CONTEXT * ctx, char * str, BetaReductionStrategy strategy) {
+	const int maxDepth = 50;
 
-	if (c == EOF) {
-		return NULL;
-	/*} else if (c == 'λ') { */ /* error: character too large for enclosing character literal type */
-	} else if (c == '\\') {
+	printf("\nInput: '%s'\n", str);
 
-		if (getIdentifier(cs, dstBuf, maxStringValueLength) == 0) {
-			return NULL;
-		}
+	LC_EXPR * parseTree = parse(ctx, str);
 
-		if (!consumeStr(cs, ".")) {
-			fprintf(stderr, "parseExpression() : Error consuming '.'\n");
-			return NULL;
-		}
+	if (parseTree == NULL) {
+		fprintf(stderr, "parse('%s') : parseExpression() returned NULL\n", str);
+		return;
+	}
 
-		LC_EXPR * expr = parseExpression(cs);
+	printf("Output: ");
+	printExpr(ctx, parseTree);
+	printf("\n");
 
-		return createLambdaExpr(dstBuf, expr);
-	} else if (c == '(') {
-		LC_EXPR * expr = parseExpression(cs);
-		LC_EXPR * expr2 = parseExpression(cs);
+	const int bufSize = 1024;
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
 
-		if (!consumeStr(cs, ")")) {
-			fprintf(stderr, "parseExpression() : Error consuming ')'\n");
-			return NULL;
-		}
+	getDeBruijnIndex(ctx, parseTree, buf, bufSize);
 
-		return createFunctionCall(expr, expr2);
-	} else {
-		rewindOneChar(cs);
+	printf("Expr type = %d\nDeBruijn index: %s\n", parseTree->type, buf);
+	countedFree(&ctx->mainCounts, buf);
 
-		if (getIdentifier(cs, dstBuf, maxStringValueLength) == 0) {
-			return NULL;
-		}
+	LC_EXPR * reducedExpr = betaReduce(ctx, parseTree, maxDepth, strategy);
 
-		return createVariable(dstBuf);
-	}
-}
+	LC_EXPR * stillInUse[] = { reducedExpr, NULL };
 
-static LC_EXPR * parse(char * str) {
-	CharSource * cs = createCharSource(str);
+	printf("1) NumMemMgrRecords before GC: %d\n", getNumMemMgrRecords(ctx));
+	collectGarbage(ctx, stillInUse);
+	printf("2) NumMemMgrRecords after GC: %d\n", getNumMemMgrRecords(ctx));
 
-	LC_EXPR * parseTree = parseExpression(cs);
+	printf("reducedExpr: ");
+	printExpr(ctx, reducedExpr);
+	printf("\n");
 
-	freeCharSource(cs);
+	freeAllStructs(ctx);
+	printf("3) NumMemMgrRecords final: %d\n", getNumMemMgrRecords(ctx));
+}
 
-	return parseTree;
+static void parseAndReduce(LC_CONTEXT * ctx, char * str) {
+	parseAndReduceDelegate(ctx, str, brsDefault);
 }
 
-static void printExpr(LC_EXPR * expr) {
+static void parseAndReduceYCombinator(LC_CONTEXT * ctx, char * str) {
+	parseAndReduceDelegate(ctx, str, brsThAWHackForYCombinator);
+}
 
-	switch (expr->type) {
-		case lcExpressionType_Variable:
-			printf("%s", expr->name);
-			break;
+static void parseAndReduceInParallel(LC_CONTEXT * ctx, char * str, int numWorkers) {
+	/* Reduce str sequentially, then in parallel with every independent
+	subterm spawned as a task, and compare the de Bruijn indices of the two
+	results. (The generated variable names may differ.) */
+	const int maxDepth = 50;
+	const int bufSize = 1024;
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * buf2 = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
 
-		case lcExpressionType_LambdaExpr:
-			printf("λ%s.", expr->name);
-			printExpr(expr->expr);
-			break;
+	printf("\nInput: '%s'\n", str);
 
-		case lcExpressionType_FunctionCall:
-			printf("(");
-			printExpr(expr->expr);
-			printf(" ");
-			printExpr(expr->expr2);
-			printf(")");
-			break;
+	LC_EXPR * parseTree = parse(ctx, str);
+	LC_EXPR * sequentialResult = betaReduce(ctx, parseTree, maxDepth, brsNormalOrder);
 
-		default:
-			break;
-	}
+	ctx->scheduler = createTaskScheduler(numWorkers, &ctx->taskSchedulerCounts);
+	ctx->parallelThreshold = 1;
+
+	LC_EXPR * parallelResult = betaReduce(ctx, parseTree, maxDepth, brsNormalOrder);
+
+	freeTaskScheduler(ctx->scheduler);
+	ctx->scheduler = NULL;
+	ctx->parallelThreshold = defaultParallelThreshold;
+
+	printf("Sequential: ");
+	printExpr(ctx, sequentialResult);
+	printf("\nParallel (%d workers): ", numWorkers);
+	printExpr(ctx, parallelResult);
+	printf("\n");
+
+	getDeBruijnIndex(ctx, sequentialResult, buf, bufSize);
+	getDeBruijnIndex(ctx, parallelResult, buf2, bufSize);
+	printf("Parallel reduction test: %s\n", strcmp(buf, buf2) ? "**** FAILED ****" : "Succeeded");
+
+	freeAllStructs(ctx);
+	countedFree(&ctx->mainCounts, buf2);
+	countedFree(&ctx->mainCounts, buf);
 }
 
-static void parseAndReduceDelegate(char * str, BetaReductionStrategy strategy) {
+static void parseAndReduceAndCompare(LC_CONTEXT * ctx, char * str, BetaReductionStrategy strategy) {
+	/* Reduce str with the given strategy and in normal order, and compare
+	the de Bruijn indices of the two results. */
 	const int maxDepth = 50;
+	const int bufSize = 1024;
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * buf2 = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
 
 	printf("\nInput: '%s'\n", str);
 
-	LC_EXPR * parseTree = parse(str);
+	LC_EXPR * parseTree = parse(ctx, str);
+	LC_EXPR * normalOrderResult = betaReduce(ctx, parseTree, maxDepth, brsNormalOrder);
+	LC_EXPR * result = betaReduce(ctx, parseTree, maxDepth, strategy);
 
-	if (parseTree == NULL) {
-		fprintf(stderr, "parse('%s') : parseExpression() returned NULL\n", str);
-		return;
-	}
+	printf("Normal order: ");
+	printExpr(ctx, normalOrderResult);
+	printf("\nStrategy %d: ", strategy);
+	printExpr(ctx, result);
+	printf("\n");
 
-	printf("Output: ");
-	printExpr(parseTree);
+	getDeBruijnIndex(ctx, normalOrderResult, buf, bufSize);
+	getDeBruijnIndex(ctx, result, buf2, bufSize);
+	printf("Comparison with normal order: %s\n", strcmp(buf, buf2) ? "**** FAILED ****" : "Succeeded");
+
+	freeAllStructs(ctx);
+	countedFree(&ctx->mainCounts, buf2);
+	countedFree(&ctx->mainCounts, buf);
+}
+
+static void parseAndReduceAndCompareWithNextName(LC_CONTEXT * ctx, char * format, BetaReductionStrategy strategy) {
+	/* parseAndReduceAndCompare(), where format has a %d for the number of
+	the next generated variable name: a fresh name must not capture the
+	free variable that has that name already */
+	char str[64];
+
+	sprintf(str, format, ctx->root->generatedVariableNumber + 1);
+	parseAndReduceAndCompare(ctx, str, strategy);
+}
+
+static void runSharingPrinterTest(LC_CONTEXT * ctx) {
+	/* Build ((λz.(f z) y) (λz.(f z) y)) as a DAG, with both halves the same
+	node, and print it with and without sharing. */
+	LC_EXPR * half = parse(ctx, "(\\z.(f z) y)");
+	LC_EXPR * expr = createFunctionCall(ctx, half, createLambdaExpr(ctx, "w", createFunctionCall(ctx, half, half)));
+
+	printf("\nSharing printer test:\n");
+	printExpr(ctx, expr);
 	printf("\n");
+	fprintExprWithSharing(ctx, stdout, expr);
+	printf("\n");
+	freeAllStructs(ctx);
+}
+
+static void parseAndStream(LC_CONTEXT * ctx, char * str, long maxSteps) {
+	/* Print the normal form while it is being computed */
+	printf("\nStreaming test: %s\n", str);
+
+	const BOOL isComplete = fprintNormalFormStreaming(ctx, stdout, parse(ctx, str), NULL, maxSteps);
 
+	printf("\n%s\n", isComplete ? "Complete" : "Out of steps");
+	freeAllStructs(ctx);
+}
+
+static void runCompactLayoutTest(LC_CONTEXT * ctx, char * str) {
+	/* Convert the reduced expression to the compact layout and back, and
+	compare the de Bruijn indices of all three */
 	const int bufSize = 1024;
-	char * buf = (char *)malloc(bufSize * sizeof(char));
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * buf2 = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	COMPACT_HEAP * heap = createCompactHeap(ctx);
+
+	LC_EXPR * result = betaReduce(ctx, parse(ctx, str), 50, brsDefault);
+	COMPACT_EXPR roots[] = { toCompactExpr(heap, result), 0 };
+	BOOL succeeded = TRUE;
+
+	toCompactExpr(heap, result); /* Garbage */
+	collectCompactGarbage(heap, roots);
+	getDeBruijnIndex(ctx, result, buf, bufSize);
+	getCompactDeBruijnIndex(heap, roots[0], buf2, bufSize);
+	succeeded = succeeded && !strcmp(buf, buf2);
+	getDeBruijnIndex(ctx, fromCompactExpr(ctx, heap, roots[0]), buf2, bufSize);
+	succeeded = succeeded && !strcmp(buf, buf2);
+
+	printf("\nCompact layout test: %s\n", str);
+	printf("%u live nodes of %lu bytes (vs. %lu + %lu for LC_EXPR): %s\n",
+		getNumLiveCompactNodes(heap), sizeof(COMPACT_NODE), sizeof(LC_EXPR), sizeof(MEMMGR_RECORD),
+		succeeded ? "Succeeded" : "**** FAILED ****");
+
+	freeCompactHeap(heap);
+	freeAllStructs(ctx);
+	countedFree(&ctx->mainCounts, buf2);
+	countedFree(&ctx->mainCounts, buf);
+}
 
-	++numMallocs;
-	getDeBruijnIndex(parseTree, buf, bufSize);
+static void runFlatLayoutTest(LC_CONTEXT * ctx, char * str) {
+	/* Flatten the reduced expression, and compare the printed forms, the de
+	Bruijn indices (also after converting it back) and the free variables */
+	const int bufSize = 1024;
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * buf2 = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * printed = NULL;
+	char * flatPrinted = NULL;
+	size_t printedSize = 0;
+	size_t flatPrintedSize = 0;
+	char * freeNames[8];
+	int numFreeNames = 0;
+	int i;
 
-	printf("Expr type = %d\nDeBruijn index: %s\n", parseTree->type, buf);
-	free(buf);
-	++numFrees;
+	LC_EXPR * result = betaReduce(ctx, parse(ctx, str), 50, brsDefault);
+	FLAT_EXPR * flat = toFlatExpr(ctx, result);
+	FILE * fp = open_memstream(&printed, &printedSize);
+	BOOL succeeded = TRUE;
+
+	fprintExpr(ctx, fp, result);
+	fclose(fp);
+	fp = open_memstream(&flatPrinted, &flatPrintedSize);
+	fprintFlatExpr(fp, flat);
+	fclose(fp);
+	succeeded = succeeded && !strcmp(printed, flatPrinted);
+	getDeBruijnIndex(ctx, result, buf, bufSize);
+	getFlatDeBruijnIndex(flat, buf2, bufSize);
+	succeeded = succeeded && !strcmp(buf, buf2);
+	getDeBruijnIndex(ctx, fromFlatExpr(ctx, flat), buf2, bufSize);
+	succeeded = succeeded && !strcmp(buf, buf2);
+	numFreeNames = getFlatFreeVariableNames(flat, freeNames, 8);
+	succeeded = succeeded && isFlatExprClosed(flat) == (numFreeNames == 0);
+
+	for (i = 0; i < numFreeNames && i < 8; ++i) {
+		succeeded = succeeded && flatExprContainsFreeVariableNamed(flat, freeNames[i]);
+	}
 
-	LC_EXPR * reducedExpr = betaReduce(parseTree, maxDepth, strategy);
+	printf("\nFlat layout test: %s\n", str);
+	printf("%s : %u nodes of %lu bytes, %d free variable(s): %s\n",
+		flatPrinted, flat->numNodes, sizeof(FLAT_NODE), numFreeNames,
+		succeeded ? "Succeeded" : "**** FAILED ****");
+
+	freeFlatExpr(flat);
+	free(flatPrinted);
+	free(printed);
+	freeAllStructs(ctx);
+	countedFree(&ctx->mainCounts, buf2);
+	countedFree(&ctx->mainCounts, buf);
+}
 
-	LC_EXPR * stillInUse[] = { reducedExpr, NULL };
+static void runParallelGcTest(LC_CONTEXT * ctx, int numNodes) {
+	/* Build a chain of applications with a garbage node beside each link,
+	and collect it with 4 threads, however many CPUs there are: the chain
+	must survive, in newest-first order, and the garbage must not */
+	LC_EXPR * leaf = createVariable(ctx, "y");
+	LC_EXPR * chain = createVariable(ctx, "x");
+	MEMMGR_RECORD * mmRec;
+	BOOL succeeded = TRUE;
+	int i;
+
+	for (i = 0; i < numNodes; ++i) {
+		chain = createFunctionCall(ctx, chain, leaf);
+		createFunctionCall(ctx, leaf, chain); /* Garbage */
+	}
+
+	LC_EXPR * roots[] = { chain, NULL };
+
+	ctx->numGcThreads = 4;
+	ctx->uncapGcThreads = TRUE;
+	collectGarbage(ctx, roots);
+	succeeded = getNumMemMgrRecords(ctx) == numNodes + 2;
+
+	for (mmRec = ctx->memmgrRecords; mmRec->expr->type == lcExpressionType_FunctionCall; mmRec = mmRec->next) {
+		succeeded = succeeded && mmRec->expr->expr == mmRec->next->expr;
+	}
+
+	printf("\nParallel garbage collection test: %d of %d nodes survive: %s\n",
+		getNumMemMgrRecords(ctx), 2 * numNodes + 2, succeeded ? "Succeeded" : "**** FAILED ****");
+
+	freeAllStructs(ctx);
+	ctx->numGcThreads = 0;
+	ctx->uncapGcThreads = FALSE;
+}
+
+static char * printToString(LC_CONTEXT * ctx, LC_EXPR * expr, BOOL streaming) {
+	char * str = NULL;
+	size_t size = 0;
+	FILE * fp = open_memstream(&str, &size);
+
+	if (streaming) {
+		fprintNormalFormStreaming(ctx, fp, expr, NULL, 1000);
+	} else {
+		fprintExpr(ctx, fp, expr);
+	}
+
+	fclose(fp);
+
+	return str;
+}
+
+static void runIterationTest(LC_CONTEXT * ctx, char * str, long expectedCount) {
+	/* str reduces to (g (g ... (g z))), which should be one Iteration node;
+	if it is short, it should be printed (also while streaming) and
+	converted to de Bruijn indices as the applications that it stands for */
+	const int bufSize = 1024;
+	char * buf = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+	char * buf2 = (char *)countedRealloc(&ctx->mainCounts, NULL, bufSize * sizeof(char));
+
+	LC_EXPR * result = betaReduce(ctx, parse(ctx, str), 50, brsDefault);
+	LC_EXPR * roots[] = { result, NULL };
+
+	collectGarbage(ctx, roots);
+
+	const int numLiveNodes = getNumMemMgrRecords(ctx);
+	BOOL succeeded = result->type == lcExpressionType_Iteration && result->value == expectedCount && numLiveNodes <= 3;
+
+	if (succeeded && expectedCount < 100) {
+		LC_EXPR * expandedResult = expandIterations(ctx, result);
+		char * printed = printToString(ctx, result, FALSE);
+		char * expandedPrinted = printToString(ctx, expandedResult, FALSE);
+		char * streamed = printToString(ctx, result, TRUE);
+
+		succeeded = !strcmp(printed, expandedPrinted) && !strcmp(printed, streamed);
+		getDeBruijnIndex(ctx, result, buf, bufSize);
+		getDeBruijnIndex(ctx, expandedResult, buf2, bufSize);
+		succeeded = succeeded && !strcmp(buf, buf2);
+		free(streamed);
+		free(expandedPrinted);
+		free(printed);
+	}
+
+	printf("\nIteration test: %s\n", str);
+	printf("g applied %ld times, in %d live nodes: %s\n",
+		(result->type == lcExpressionType_Iteration) ? result->value : 0L, numLiveNodes,
+		succeeded ? "Succeeded" : "**** FAILED ****");
+
+	freeAllStructs(ctx);
+	countedFree(&ctx->mainCounts, buf2);
+	countedFree(&ctx->mainCounts, buf);
+}
+
+static void parseAndReduceWithLimits(LC_CONTEXT * ctx, char * str, int maxLiveNodes, int maxAllocations, int numWorkers) {
+	/* The reduction should stop, and leave the heap as it found it. With
+	numWorkers > 0 it is done in parallel, and the tasks share the limits. */
+	const int maxDepth = 50;
+	REDUCTION_LIMITS limits = { maxLiveNodes, maxAllocations, 0, FALSE };
+	ReductionStatus status = rsOK;
+
+	printf("\nInput: '%s'\n", str);
+
+	LC_EXPR * parseTree = parse(ctx, str);
+	const int numRecordsBefore = getNumMemMgrRecords(ctx);
+	const int numMallocsBefore = ctx->createAndDestroyCounts.numMallocs;
 
-	printf("1) NumMemMgrRecords before GC: %d\n", getNumMemMgrRecords());
-	collectGarbage(stillInUse);
-	printf("2) NumMemMgrRecords after GC: %d\n", getNumMemMgrRecords());
+	if (numWorkers > 0) {
+		ctx->scheduler = createTaskScheduler(numWorkers, &ctx->taskSchedulerCounts);
+		ctx->parallelThreshold = 1;
+	}
+
+	LC_EXPR * reducedExpr = betaReduceWithLimits(ctx, parseTree, maxDepth, brsDefault, &limits, &status);
+
+	if (numWorkers > 0) {
+		freeTaskScheduler(ctx->scheduler);
+		ctx->scheduler = NULL;
+		ctx->parallelThreshold = defaultParallelThreshold;
+	}
+
+	/* The tasks share one budget, so together they stop soon after it is
+	spent, rather than each spending all of it */
+	const BOOL isWithinBudget = maxAllocations == 0 || ctx->createAndDestroyCounts.numMallocs - numMallocsBefore <= maxAllocations * 3 / 2;
 
+	printf("Status: %s\n", getReductionStatusMessage(status));
+	printf("Resource limit test: %s\n",
+		(reducedExpr == NULL && status != rsOK && getNumMemMgrRecords(ctx) == numRecordsBefore && isWithinBudget) ? "Succeeded" : "**** FAILED ****");
+
+	/* Without the limits, the same context can finish the job */
+	reducedExpr = betaReduce(ctx, parseTree, maxDepth, brsDefault);
 	printf("reducedExpr: ");
-	printExpr(reducedExpr);
+	printExpr(ctx, reducedExpr);
 	printf("\n");
 
-	freeAllStructs();
-	printf("3) NumMemMgrRecords final: %d\n", getNumMemMgrRecords());
+	freeAllStructs(ctx);
 }
 
-static void parseAndReduce(char * str) {
-	parseAndReduceDelegate(str, brsDefault);
+static void parseAndDetectCycles(LC_CONTEXT * ctx, char * str) {
+	/* A divergent term should stop with rsCycleDetected, and leave the heap
+	as it found it; any other term should reduce as it does without it */
+	const int maxDepth = 50;
+	REDUCTION_LIMITS limits = { 0, 0, 0, TRUE };
+	ReductionStatus status = rsOK;
+
+	printf("\nCycle detection: '%s'\n", str);
+
+	LC_EXPR * parseTree = parse(ctx, str);
+	const int numRecordsBefore = getNumMemMgrRecords(ctx);
+	LC_EXPR * reducedExpr = betaReduceWithLimits(ctx, parseTree, maxDepth, brsDefault, &limits, &status);
+
+	printf("Status: %s\n", getReductionStatusMessage(status));
+
+	if (reducedExpr == NULL) {
+		printf("Cycle of length %d; heap %s\n", ctx->cycleLength,
+			(getNumMemMgrRecords(ctx) == numRecordsBefore) ? "restored" : "**** NOT RESTORED ****");
+	} else {
+		printf("reducedExpr: ");
+		printExpr(ctx, reducedExpr);
+		printf("\n");
+	}
+
+	freeAllStructs(ctx);
 }
 
-static void parseAndReduceYCombinator(char * str) {
-	parseAndReduceDelegate(str, brsThAWHackForYCombinator);
+static void runTraceTest(LC_CONTEXT * ctx, char * str) {
+	/* Record the steps of a reduction in a ring of 8 records */
+	const int maxDepth = 50;
+
+	ctx->trace = createTraceRecorder(8, NULL, &ctx->traceCounts);
+	printf("\nTrace test: %s\n", str);
+	betaReduce(ctx, parse(ctx, str), maxDepth, brsDefault);
+	printf("%u events recorded\n", getNumTraceEvents(ctx->trace));
+	freeTraceRecorder(ctx->trace);
+	ctx->trace = NULL;
+	freeAllStructs(ctx);
 }
 
-static void runYCombinatorTest1() {
+static void runCompilerTest(LC_CONTEXT * ctx, char * str) {
+	/* Compile str to C in a temporary file; the output is not built here
+	(see tools/aot-bench.sh) */
+	LC_EXPR * exprs[] = { parse(ctx, str) };
+	FILE * fp = tmpfile();
+
+	printf("\nCompiler test: %s\n", str);
+
+	if (fp == NULL) {
+		fprintf(stderr, "runCompilerTest() : Cannot create a temporary file\n");
+	} else {
+		const BOOL succeeded = compileToC(ctx, exprs, 1, fp);
+
+		printf("Compilation: %s\n", succeeded && ftell(fp) > 0 ? "Succeeded" : "**** FAILED ****");
+		fclose(fp);
+	}
+
+	freeAllStructs(ctx);
+}
+
+static void runYCombinatorTest1(LC_CONTEXT * ctx) {
 	/* Y combinator test 1 */
 
 	/* This test calculates 3 factorial using Church numerals
@@ -228,9 +535,8 @@ static void runYCombinatorTest1() {
 	char * strIsZero = "\\n.((n \\z.\\x.\\y.y) \\x.\\y.x)";
 
 	/* const strG = `λr.λn.(((${strIf} (${strIsZero} n)) ${strOne}) ((${strMult} n) (r (${strPredecessor} n))))`; */
-	char * strG = (char *)malloc(512 * sizeof(char));
+	char * strG = (char *)countedRealloc(&ctx->mainCounts, NULL, 512 * sizeof(char));
 
-	++numMallocs;
 	memset(strG, 0, 512 * sizeof(char));
 	sprintf(strG, "\\r.\\n.(((%s (%s n)) %s) ((%s n) (r (%s n))))", strIf, strIsZero, strOne, strMult, strPredecessor);
 
@@ -241,69 +547,104 @@ static void runYCombinatorTest1() {
 	char * strYCombinator = "\\a.(\\b.(a (b b)) \\b.(a (b b)))";
 
 	/* const expr = `((${strYCombinator} ${strG}) ${strThree})`; */
-	char * expr = (char *)malloc(512 * sizeof(char));
+	char * expr = (char *)countedRealloc(&ctx->mainCounts, NULL, 512 * sizeof(char));
 
-	++numMallocs;
 	memset(expr, 0, 512 * sizeof(char));
 	sprintf(expr, "((%s %s) %s)", strYCombinator, strG, strThree);
 
 	printf("expr is: %s\n", expr);
 	printf("strlen(expr) is: %lu\n", strlen(expr)); /* -> 205 */
 
-	parseAndReduceYCombinator(expr);
+	parseAndReduceYCombinator(ctx, expr);
 	/* Output: reducedExpr: λf.λx.(f (f (f (f (f (f x)))))) == 6 */
 	/* The test passes! */
 
-	free(expr);
-	++numFrees;
-	free(strG);
-	++numFrees;
+	/* The graph reducers share work, so they need no hack */
+	parseAndReduceDelegate(ctx, expr, brsCombinator);
+	parseAndReduceDelegate(ctx, expr, brsExplicitSubstitution);
+	parseAndReduceDelegate(ctx, expr, brsGMachine);
+	parseAndReduceDelegate(ctx, expr, brsNormalizationByEvaluation);
+
+	countedFree(&ctx->mainCounts, expr);
+	countedFree(&ctx->mainCounts, strG);
 }
 
-static void runTests() {
+static BOOL writeMemoryTelemetryFile(LC_CONTEXT * ctx, char * filename) {
+	FILE * fp = fopen(filename, "w");
+
+	if (fp == NULL) {
+		fprintf(stderr, "writeMemoryTelemetryFile() : Cannot open '%s'\n", filename);
+		return FALSE;
+	}
+
+	writeMemoryTelemetryJson(ctx, fp);
+	fclose(fp);
+
+	return TRUE;
+}
+
+static void runTests(char * telemetryFilename) {
+	LC_CONTEXT * ctx = createContext();
+
 	printf("\nRunning tests...\n");
 
 	/* initMemoryManagers(); */
 
-	parseAndReduce("x");
-	parseAndReduce("\\x.x");
-	parseAndReduce("(x y)");
+	parseAndReduce(ctx, "x");
+	parseAndReduce(ctx, "\\x.x");
+	parseAndReduce(ctx, "(x y)");
 
-	parseAndReduce("\\x.\\y.x");
-	parseAndReduce("\\x.\\y.y");
+	parseAndReduce(ctx, "\\x.\\y.x");
+	parseAndReduce(ctx, "\\x.\\y.y");
 
 	/* Eta-reduction test: */
-	parseAndReduce("\\f.\\x.(f x)"); /* -> \\f.f : Succeeds */
-	parseAndReduce("\\x.(f x)"); /* -> f : Succeeds */
+	parseAndReduce(ctx, "\\f.\\x.(f x)"); /* -> \\f.f : Succeeds */
+	parseAndReduce(ctx, "\\x.(f x)"); /* -> f : Succeeds */
 
 	/* LambdaCalculus beta-reduction test 1 from thaw-grammar */
-	parseAndReduce("(\\x.x y)"); /* -> y : Succeeds */
+	parseAndReduce(ctx, "(\\x.x y)"); /* -> y : Succeeds */
 
 	/* LambdaCalculus beta-reduction test 2 */
-	parseAndReduce("(\\f.\\x.x g)"); /* -> \\x.x : Succeeds */
+	parseAndReduce(ctx, "(\\f.\\x.x g)"); /* -> \\x.x : Succeeds */
 
 	/* LambdaCalculus beta-reduction test 3 */
-	parseAndReduce("((\\f.\\x.x g) h)"); /* -> h : Succeeds */
+	parseAndReduce(ctx, "((\\f.\\x.x g) h)"); /* -> h : Succeeds */
+
+	/* Capture: both lambdas that bind y must be renamed, the inner one too */
+	parseAndReduce(ctx, "(\\x.\\y.\\y.x y)"); /* -> λv1.λv2.y */
 
 	/* LambdaCalculus Church Numerals Successor Test 1 */
 	/* const strSucc = 'λn.λf.λx.(f ((n f) x))'; The successor function */
 	/* const strZero = 'λf.λx.x'; */
 	/* Expected result: const strOne = 'λf.λx.(f x)'; */
-	parseAndReduce("(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.x)"); /* succ(0) = 1 : Succeeds */
-	parseAndReduce("(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))"); /* succ(1) = 2 : Succeeds */
+	parseAndReduce(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.x)"); /* succ(0) = 1 : Succeeds */
+	parseAndReduce(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))"); /* succ(1) = 2 : Succeeds */
 
 	/* LambdaCalculus Church Numerals Predecessor Test 1 */
 	/* const strPred = 'λn.λf.λx.(((n λg.λh.(h (g f))) λu.x) λu.u)'; */
 	/* const strOne = 'λf.λx.(f x)'; */
 	/* const strTwo = 'λf.λx.(f (f x))'; */
 	/* const strThree = 'λf.λx.(f (f (f x)))'; */
-	parseAndReduce("(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f x))"); /* pred(1) = 0 : Succeeds */
-	parseAndReduce("(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f x)))"); /* pred(2) = 1 : Succeeds */
-	parseAndReduce("(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))"); /* pred(3) = 2 : Succeeds */
+	parseAndReduce(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f x))"); /* pred(1) = 0 : Succeeds */
+	parseAndReduce(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f x)))"); /* pred(2) = 1 : Succeeds */
+	parseAndReduce(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))"); /* pred(3) = 2 : Succeeds */
+
+	/* δ-reduction tests: native integers and the Church numeral conversions */
+	ctx->enableDeltaReduction = TRUE;
+	parseAndReduce(ctx, "((+ 2) 3)"); /* -> 5 */
+	parseAndReduce(ctx, "(((if ((= 2) 3)) a) b)"); /* -> b */
+	/* integerToChurchNumeral Test 1 */
+	parseAndReduce(ctx, "(church 3)"); /* -> λf.λx.(f (f (f x))) */
+	/* churchNumeralToInteger Test 1: 3 * 4 */
+	parseAndReduce(ctx, "(number ((\\m.\\n.\\f.(m (n f)) (church 3)) (church 4)))"); /* -> 12 */
+	/* 6 factorial, via the Y combinator */
+	parseAndReduce(ctx, "((\\f.(\\x.(f (x x)) \\x.(f (x x))) \\r.\\n.(((if ((= n) 0)) 1) ((* n) (r ((- n) 1))))) 6)"); /* -> 720 */
+	parseAndReduce(ctx, "((+ 12345678) 1)"); /* -> 12345679 : The literal is not cut short */
+	parseAndReduce(ctx, "((* 99999980000001) 99999980000001)"); /* Overflows, so it is left unreduced */
+	parseAndReduce(ctx, "(number (church 1000000))"); /* Too long a numeral, so it is left unreduced */
+	ctx->enableDeltaReduction = FALSE;
 
 	/* TODO: */
-	/* integerToChurchNumeral Test 1 */
-	/* churchNumeralToInteger Test 1 */
 	/* Church Numerals And Test 1 */
 	/* Church Numerals Or Test 1 */
 	/* Church Numerals Addition Test 1 */
@@ -312,12 +653,107 @@ static void runTests() {
 	/* Church Numerals isZero Test 1 */
 
 	/* Y combinator test 1 */
-	runYCombinatorTest1();
-
-	/* parseAndReduce("( )"); */
+	runYCombinatorTest1(ctx);
+
+	/* Parallel reduction test 1: 3 * 2 applied to the free variable g */
+	parseAndReduceInParallel(ctx, "(((\\m.\\n.\\f.(m (n f)) \\f.\\x.(f (f (f x)))) \\f.\\x.(f (f x))) g)", 4);
+
+	/* Interaction net tests: succ(1), pred(3), 2 ^ 3, and a discarded Ω */
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))", brsInteractionNet);
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))", brsInteractionNet);
+	parseAndReduceAndCompare(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", brsInteractionNet);
+	parseAndReduceAndCompare(ctx, "((\\x.\\y.y (\\z.(z z) \\z.(z z))) w)", brsInteractionNet);
+	/* (c2 c2) needs Lamping's oracle; the engine should notice and fall back */
+	parseAndReduceAndCompare(ctx, "(\\x.(x x) \\f.\\x.(f (f x)))", brsInteractionNet);
+
+	/* α-conversion in normal order must not rename y to the free variable of the argument */
+	parseAndReduceAndCompareWithNextName(ctx, "(\\x.\\y.(y x) (y v%d))", brsInteractionNet);
+
+	/* Combinator tests: succ(1), 2 ^ 3, a discarded Ω, and (c2 c2) */
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))", brsCombinator);
+	parseAndReduceAndCompare(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", brsCombinator);
+	parseAndReduceAndCompare(ctx, "((\\x.\\y.y (\\z.(z z) \\z.(z z))) w)", brsCombinator);
+	parseAndReduceAndCompare(ctx, "(\\x.(x x) \\f.\\x.(f (f x)))", brsCombinator);
+	parseAndReduceAndCompareWithNextName(ctx, "(\\x.\\y.(y x) v%d)", brsCombinator);
+
+	/* Explicit substitution tests: the same, and a name that must not be captured */
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))", brsExplicitSubstitution);
+	parseAndReduceAndCompare(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", brsExplicitSubstitution);
+	parseAndReduceAndCompare(ctx, "((\\x.\\y.y (\\z.(z z) \\z.(z z))) w)", brsExplicitSubstitution);
+	parseAndReduceAndCompare(ctx, "(\\x.(x x) \\f.\\x.(f (f x)))", brsExplicitSubstitution);
+	parseAndReduceAndCompare(ctx, "(\\x.\\y.(y x) y)", brsExplicitSubstitution);
+	parseAndReduceAndCompareWithNextName(ctx, "\\y.\\y.(y v%d)", brsExplicitSubstitution);
+
+	/* G-machine tests: the same, and a lambda with free variables to lift */
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))", brsGMachine);
+	parseAndReduceAndCompare(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", brsGMachine);
+	parseAndReduceAndCompare(ctx, "((\\x.\\y.y (\\z.(z z) \\z.(z z))) w)", brsGMachine);
+	parseAndReduceAndCompare(ctx, "(\\x.(x x) \\f.\\x.(f (f x)))", brsGMachine);
+	parseAndReduceAndCompare(ctx, "(\\x.\\y.(y x) y)", brsGMachine);
+	parseAndReduceAndCompare(ctx, "((\\a.\\b.(\\c.(a (c b)) \\d.(d a)) p) q)", brsGMachine);
+	parseAndReduceAndCompareWithNextName(ctx, "(\\x.\\y.(y x) v%d)", brsGMachine);
+
+	/* Normalization by evaluation tests: the same, and names that must not be captured */
+	parseAndReduceAndCompare(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "((\\x.\\y.y (\\z.(z z) \\z.(z z))) w)", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "(\\x.(x x) \\f.\\x.(f (f x)))", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "(\\x.\\y.(y x) y)", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "((\\a.\\b.(\\c.(a (c b)) \\d.(d a)) p) q)", brsNormalizationByEvaluation);
+	parseAndReduceAndCompare(ctx, "(\\x.\\y.\\y.x y)", brsNormalizationByEvaluation);
+	parseAndReduceAndCompareWithNextName(ctx, "\\y.\\y.(y v%d)", brsNormalizationByEvaluation);
+
+	runSharingPrinterTest(ctx);
+
+	/* Streaming tests: 2 ^ 3, and the infinite normal form of (Y λr.λx.(x r)) */
+	parseAndStream(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", 1000);
+	parseAndStream(ctx, "(\\a.(\\b.(a (b b)) \\b.(a (b b))) \\r.\\x.(x r))", 20);
+
+	/* Compiler test: succ(1) */
+	runCompilerTest(ctx, "(\\n.\\f.\\x.(f ((n f) x)) \\f.\\x.(f x))");
+
+	/* Trace test: pred(3) */
+	runTraceTest(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))");
+
+	/* Resource limit tests: 2 ^ 3 */
+	parseAndReduceWithLimits(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", 0, 30, 0);
+	parseAndReduceWithLimits(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)", 100, 0, 0);
+	parseAndReduceWithLimits(ctx, "(((g ((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x))))) ((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x))))) ((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))))", 0, 100, 4); /* Each 2 ^ 3 alone is within the limit */
+	parseAndDetectCycles(ctx, "(\\x.(x x) \\x.(x x))");
+	parseAndDetectCycles(ctx, "(\\f.(\\x.(f (x x)) \\x.(f (x x))) \\y.y)");
+	parseAndDetectCycles(ctx, "(((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g)");
+	parseAndDetectCycles(ctx, "(\\u.(u (\\x.(x x) \\x.(x x))) \\w.c)"); /* The cycle is thrown away */
+	parseAndDetectCycles(ctx, "(g (\\x.(x x) \\x.(x x)))"); /* The cycle is kept, in an argument */
+
+	/* Compact layout tests: pred(3), and a literal */
+	runCompactLayoutTest(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))");
+	ctx->enableDeltaReduction = TRUE;
+	runCompactLayoutTest(ctx, "\\x.((* x) -3)");
+	ctx->enableDeltaReduction = FALSE;
+
+	/* Flat layout tests: pred(3), shadowing with free variables, and a literal */
+	runFlatLayoutTest(ctx, "(\\n.\\f.\\x.(((n \\g.\\h.(h (g f))) \\u.x) \\u.u) \\f.\\x.(f (f (f x))))");
+	runFlatLayoutTest(ctx, "\\x.((f x) \\x.\\f.((f x) (y \\y.(x y))))");
+	ctx->enableDeltaReduction = TRUE;
+	runFlatLayoutTest(ctx, "\\x.((* x) -3)");
+	ctx->enableDeltaReduction = FALSE;
+
+	runParallelGcTest(ctx, 100000);
+
+	/* Iteration tests: 2 ^ 3, and 10 ^ 6 in O(1) memory */
+	runIterationTest(ctx, "((((\\m.\\n.(n m) \\f.\\x.(f (f x))) \\f.\\x.(f (f (f x)))) g) z)", 8);
+	runIterationTest(ctx, "((((\\m.\\n.(n m) \\f.\\x.(f (f (f (f (f (f (f (f (f (f x))))))))))) \\f.\\x.(f (f (f (f (f (f x))))))) g) z)", 1000000);
+
+	/* parseAndReduce(ctx, "( )"); */
 
 	/* terminateMemoryManagers(); */
-	generateMemoryManagementReport();
+	generateMemoryManagementReport(ctx);
+
+	if (telemetryFilename != NULL) {
+		writeMemoryTelemetryFile(ctx, telemetryFilename);
+	}
+
+	freeContext(ctx);
 
 	printf("\nDone.\n");
 }
@@ -326,19 +762,66 @@ void execScriptInFile(char * filename) {
 	printf("\nTODO: Execute the script in the file '%s'\n", filename);
 }
 
-void readEvalPrintLoop() {
-	printf("\nTODO: Implement readEvalPrintLoop()\n");
+static BOOL runBatchAndRecord(char * filename, int numThreads, int numReductionThreads, int numGcThreads, BOOL enableDeltaReduction, REDUCTION_LIMITS * limits, char * traceFilename, char * telemetryFilename) {
+	/* Run a batch, with an optional trace and memory telemetry file */
+	const int traceBufferCapacity = 4096; /* Records */
+	TRACE_RECORDER * trace = NULL;
+	LC_CONTEXT * statsCtx = NULL;
+	FILE * fp = NULL;
+
+	if (traceFilename != NULL) {
+		fp = fopen(traceFilename, "wb");
+
+		if (fp == NULL) {
+			fprintf(stderr, "runBatchAndRecord() : Cannot open '%s'\n", traceFilename);
+			return FALSE;
+		}
+
+	}
+
+	if (telemetryFilename != NULL) {
+		statsCtx = createContext();
+	}
+
+	if (fp != NULL) {
+		trace = createTraceRecorder(traceBufferCapacity, fp, (statsCtx != NULL) ? &statsCtx->traceCounts : NULL);
+	}
+
+	BOOL result = runBatch(filename, numThreads, numReductionThreads, numGcThreads, enableDeltaReduction, limits, trace, statsCtx);
+
+	if (statsCtx != NULL) {
+		result = writeMemoryTelemetryFile(statsCtx, telemetryFilename) && result;
+	}
+
+	if (trace != NULL) {
+		freeTraceRecorder(trace);
+		fclose(fp);
+	}
+
+	if (statsCtx != NULL) {
+		freeContext(statsCtx);
+	}
+
+	return result;
 }
 
 /* **** The Main MoFo **** */
 
 int main(int argc, char * argv[]) {
-	/* TODO: Implement an REPL (a read-evaluate-print loop) */
 	/* TODO: Implement the execution of a script in a file */
 
 	BOOL enableTests = FALSE;
 	BOOL enableVersion = FALSE;
+	BOOL enableDeltaReduction = FALSE;
 	char * filename = NULL;
+	char * batchFilename = NULL;
+	int numThreads = 0; /* Zero means one thread per online CPU */
+	int numReductionThreads = 0; /* Zero means that each reduction is sequential */
+	int numGcThreads = 0; /* Zero means that each garbage collection is sequential */
+	REDUCTION_LIMITS limits = { 0, 0, 0, FALSE }; /* Zero means no limit */
+	char * traceFilename = NULL;
+	char * telemetryFilename = NULL;
+	char * compiledFilename = NULL;
 	int i;
 
 	for (i = 1; i < argc; ++i) {
@@ -348,6 +831,30 @@ int main(int argc, char * argv[]) {
 			enableTests = TRUE;
 		} else if (!strcmp(argv[i], "-v")) {
 			enableVersion = TRUE;
+		} else if (!strcmp(argv[i], "-d")) {
+			enableDeltaReduction = TRUE;
+		} else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+			batchFilename = argv[++i];
+		} else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+			numThreads = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+			numReductionThreads = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+			numGcThreads = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+			traceFilename = argv[++i];
+		} else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+			compiledFilename = argv[++i];
+		} else if (!strcmp(argv[i], "-M") && i + 1 < argc) {
+			telemetryFilename = argv[++i];
+		} else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+			limits.maxLiveNodes = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+			limits.maxAllocations = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+			limits.maxMilliseconds = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-x")) {
+			limits.detectCycles = TRUE;
 		} else if (filename == NULL && argv[i][0] != '-') {
 			filename = argv[i];
 		}
@@ -356,11 +863,15 @@ int main(int argc, char * argv[]) {
 	if (enableVersion) {
 		printf("\nFacility version 0.0.0\n");
 	} else if (enableTests) {
-		runTests();
+		runTests(telemetryFilename);
+	} else if (batchFilename != NULL) {
+		return runBatchAndRecord(batchFilename, numThreads, numReductionThreads, numGcThreads, enableDeltaReduction, &limits, traceFilename, telemetryFilename) ? 0 : 1;
+	} else if (compiledFilename != NULL && filename != NULL) {
+		return compileFileToC(filename, compiledFilename) ? 0 : 1;
 	} else if (filename != NULL) {
 		execScriptInFile(filename);
 	} else {
-		readEvalPrintLoop();
+		readEvalPrintLoop(enableDeltaReduction, numGcThreads);
 	}
 
 	return 0; /* Zero (as a Unix exit code) means success. */
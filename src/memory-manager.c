@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 /* #include <ctype.h> */
 /* #include <assert.h> */
 
@@ -10,38 +13,33 @@
 
 #include "types.h"
 #include "memory-manager.h"
+#include "context.h"
 
-void incNumFreesInCreateAndDestroy();
+#include "telemetry.h"
 
-static int numMallocs = 0;
-static int numFrees = 0;
+void incNumFreesInCreateAndDestroy(LC_CONTEXT * ctx);
+void addNumFreesInCreateAndDestroy(LC_CONTEXT * ctx, int n);
 
-void printMemMgrSelfReport() {
-	printf("  Memory manager itself: %d mallocs, %d frees", numMallocs, numFrees);
-
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
-	}
-
-	printf("\n");
+void printMemMgrSelfReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Memory manager itself", &ctx->memMgrCounts);
 }
 
 /* **** BEGIN Memory manager version 1 **** */
 
-MEMMGR_RECORD * memmgrRecords = NULL;
+/* Each context has its own heap: ctx->memmgrRecords */
 
-void addItemToMemMgrRecords(LC_EXPR * item) {
+void addItemToMemMgrRecords(LC_CONTEXT * ctx, LC_EXPR * item) {
 	MEMMGR_RECORD * mmRec = (MEMMGR_RECORD *)malloc(sizeof(MEMMGR_RECORD));
 
-	++numMallocs;
+	++ctx->memMgrCounts.numMallocs;
 	mmRec->expr = item;
-	mmRec->next = memmgrRecords;
-	memmgrRecords = mmRec;
+	mmRec->next = ctx->memmgrRecords;
+	ctx->memmgrRecords = mmRec;
 }
 
-int getNumMemMgrRecords() {
+int getNumMemMgrRecords(LC_CONTEXT * ctx) {
 	int n = 0;
-	MEMMGR_RECORD * mmRec = memmgrRecords;
+	MEMMGR_RECORD * mmRec = ctx->memmgrRecords;
 
 	while (mmRec != NULL) {
 		++n;
@@ -51,29 +49,92 @@ int getNumMemMgrRecords() {
 	return n;
 }
 
-void clearMarks() {
+void adoptMemMgrRecords(LC_CONTEXT * ctx, LC_CONTEXT * otherCtx) {
+	/* Move all of the records in otherCtx's heap to the front of ctx's heap */
+	MEMMGR_RECORD * mmRec = otherCtx->memmgrRecords;
+
+	if (mmRec == NULL) {
+		return;
+	}
+
+	while (mmRec->next != NULL) {
+		mmRec = mmRec->next;
+	}
+
+	mmRec->next = ctx->memmgrRecords;
+	ctx->memmgrRecords = otherCtx->memmgrRecords;
+	otherCtx->memmgrRecords = NULL;
+}
+
+static void clearMarks(LC_CONTEXT * ctx) {
 	MEMMGR_RECORD * mmRec;
 
-	for (mmRec = memmgrRecords; mmRec != NULL; mmRec = mmRec->next) {
+	for (mmRec = ctx->memmgrRecords; mmRec != NULL; mmRec = mmRec->next) {
 		mmRec->expr->mark = 0;
 	}
 }
 
-void setMarksInExprTree(LC_EXPR * expr) {
-	/* Do this recursively */
-	expr->mark = 1;
+typedef struct {
+	LC_EXPR ** items;
+	int size;
+	int capacity;
+	MEMMGR_COUNTS * counts; /* Of the allocations of items */
+} GC_LOCAL_STACK; /* Nodes still to be marked, by one thread */
+
+static void pushLocal(GC_LOCAL_STACK * stack, LC_EXPR * expr) {
 
-	if (expr->expr != NULL) {
-		setMarksInExprTree(expr->expr);
+	if (stack->size == stack->capacity) {
+		stack->capacity = (stack->capacity == 0) ? 1024 : 2 * stack->capacity;
+		stack->items = (LC_EXPR **)countedRealloc(stack->counts, stack->items, stack->capacity * sizeof(LC_EXPR *));
 	}
 
-	if (expr->expr2 != NULL) {
-		setMarksInExprTree(expr->expr2);
+	stack->items[stack->size++] = expr;
+}
+
+static void setMarksInExprTrees(LC_CONTEXT * ctx, LC_EXPR * exprTrees[]) {
+	/* Mark the nodes that the NULL-terminated exprTrees reach, with an
+	explicit stack: a chain of applications can be deeper than the C stack.
+	Substitution shares subtrees, so the heap is a DAG: a marked node has
+	been visited already, with all that it reaches. */
+	GC_LOCAL_STACK stack = { NULL, 0, 0, &ctx->gcCounts };
+	int i;
+
+	for (i = 0; exprTrees[i] != NULL; ++i) {
+		pushLocal(&stack, exprTrees[i]);
 	}
+
+	while (stack.size > 0) {
+		LC_EXPR * expr = stack.items[--stack.size];
+
+		if (expr->mark != 0) {
+			continue;
+		}
+
+		expr->mark = 1;
+
+		if (expr->expr2 != NULL && expr->expr2->mark == 0) {
+			pushLocal(&stack, expr->expr2);
+		}
+
+		if (expr->expr != NULL && expr->expr->mark == 0) {
+			pushLocal(&stack, expr->expr);
+		}
+	}
+
+	countedFree(stack.counts, stack.items);
+}
+
+void markExprTree(LC_CONTEXT * ctx, LC_EXPR * expr) {
+	/* Mark exactly the nodes of ctx's heap that expr reaches, without
+	freeing anything. The next collection clears the marks again. */
+	LC_EXPR * exprTrees[] = { expr, NULL };
+
+	clearMarks(ctx);
+	setMarksInExprTrees(ctx, exprTrees);
 }
 
-void freeUnmarkedStructs() {
-	MEMMGR_RECORD ** ppmmRec = &memmgrRecords;
+static void freeUnmarkedStructs(LC_CONTEXT * ctx) {
+	MEMMGR_RECORD ** ppmmRec = &ctx->memmgrRecords;
 	MEMMGR_RECORD * mmRec = *ppmmRec;
 
 	while (mmRec != NULL) {
@@ -84,7 +145,7 @@ void freeUnmarkedStructs() {
 			mmRec->expr->expr2 = NULL;
 			free(mmRec->expr);
 			/* ++numFrees; */
-			incNumFreesInCreateAndDestroy();
+			incNumFreesInCreateAndDestroy(ctx);
 			mmRec->expr = NULL;
 
 			/* Then free mmRec, preserving the integrity of the linked list */
@@ -93,7 +154,7 @@ void freeUnmarkedStructs() {
 			mmRec->expr = NULL;
 			mmRec->next = NULL;
 			free(mmRec);
-			++numFrees;
+			++ctx->memMgrCounts.numFrees;
 			*ppmmRec = nextmmRec;
 		} else {
 			ppmmRec = &mmRec->next;
@@ -103,21 +164,423 @@ void freeUnmarkedStructs() {
 	}
 }
 
-void collectGarbage(LC_EXPR * exprTreesToMark[]) {
+/* **** The parallel collector **** */
+
+/* On a big heap, with ctx->numGcThreads > 1, a collection is split over that
+ * many threads, but no more than there are CPUs (the calling thread is one of
+ * them) unless ctx->uncapGcThreads is set:
+ *
+ * 1. The heap is cut into chunks of gcChunkSize records, by one walk over
+ *    the records alone, and each thread gets a run of whole chunks;
+ * 2. Each thread clears the marks in its own partition;
+ * 3. The threads mark from the roots together. Each has a private mark stack,
+ *    and a shared one that it moves work to whenever it is empty, so that
+ *    idle threads can steal it. A node is claimed by an atomic exchange of
+ *    its mark, so it is traced only once even if two threads reach it;
+ * 4. Each thread sweeps its own partition into a list of survivors, and the
+ *    lists are joined in order, so the heap keeps its newest-first order
+ *    (see freeStructsAllocatedSince()). */
+
+/* const int parallelGcThreshold = 65536; */
+#define parallelGcThreshold 65536
+/* const int gcChunkSize = 4096; */
+#define gcChunkSize 4096
+/* const int gcMarkBatchSize = 256; */
+#define gcMarkBatchSize 256
+
+typedef struct {
+	pthread_mutex_t mutex;
+	LC_EXPR ** items;
+	int size;
+	int capacity;
+	MEMMGR_COUNTS counts; /* Of its owner's mark stacks; added to ctx->gcCounts at the end */
+} GC_MARK_STACK; /* The part of a marker's work that the others may steal */
+
+typedef struct {
+	MEMMGR_RECORD * head; /* Of the records that survive in the partition */
+	MEMMGR_RECORD * tail;
+	int numFreed;
+} GC_SWEEP_RESULT;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	int numThreads;
+	MEMMGR_RECORD ** chunks; /* The first record of each chunk; chunks[numChunks] is NULL */
+	int numChunks;
+	LC_EXPR ** roots; /* NULL-terminated */
+	GC_MARK_STACK * markStacks;
+	GC_SWEEP_RESULT * sweepResults;
+	int numActiveMarkers;
+	pthread_barrier_t barrier;
+	long markEndTime; /* Read by thread 0 */
+} GC_JOB;
+
+typedef struct {
+	GC_JOB * job;
+	int index;
+} GC_WORKER_ARGS;
+
+static BOOL takeSharedWork(GC_MARK_STACK * shared, GC_LOCAL_STACK * local, BOOL takeHalf) {
+	/* The owner takes a batch; a thief takes half */
+	BOOL result = FALSE;
+
+	pthread_mutex_lock(&shared->mutex);
+
+	if (shared->size > 0) {
+		const int n = takeHalf ? (shared->size + 1) / 2 : (shared->size < gcMarkBatchSize ? shared->size : gcMarkBatchSize);
+		int i;
+
+		for (i = shared->size - n; i < shared->size; ++i) {
+			pushLocal(local, shared->items[i]);
+		}
+
+		/* The size is also read without the lock; see isAnyWorkShared() */
+		__atomic_store_n(&shared->size, shared->size - n, __ATOMIC_RELAXED);
+		result = TRUE;
+	}
+
+	pthread_mutex_unlock(&shared->mutex);
+
+	return result;
+}
+
+static void shareWork(GC_MARK_STACK * shared, GC_LOCAL_STACK * local) {
+	/* Move the oldest batch of local work, which is nearest the roots, to
+	where the other threads can steal it */
+	int i;
+
+	pthread_mutex_lock(&shared->mutex);
+
+	if (shared->size + gcMarkBatchSize > shared->capacity) {
+		shared->capacity = 2 * (shared->size + gcMarkBatchSize);
+		shared->items = (LC_EXPR **)countedRealloc(local->counts, shared->items, shared->capacity * sizeof(LC_EXPR *));
+	}
+
+	for (i = 0; i < gcMarkBatchSize; ++i) {
+		shared->items[shared->size + i] = local->items[i];
+	}
+
+	__atomic_store_n(&shared->size, shared->size + gcMarkBatchSize, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&shared->mutex);
+
+	local->size -= gcMarkBatchSize;
+	memmove(local->items, local->items + gcMarkBatchSize, local->size * sizeof(LC_EXPR *));
+}
+
+static BOOL stealWork(GC_JOB * job, int index, GC_LOCAL_STACK * local) {
+	int i;
+
+	for (i = 1; i < job->numThreads; ++i) {
+
+		if (takeSharedWork(&job->markStacks[(index + i) % job->numThreads], local, TRUE)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static BOOL isAnyWorkShared(GC_JOB * job) {
+	int i;
+
+	for (i = 0; i < job->numThreads; ++i) {
+
+		if (__atomic_load_n(&job->markStacks[i].size, __ATOMIC_RELAXED) > 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static BOOL waitForWork(GC_JOB * job, int index, GC_LOCAL_STACK * local) {
+	/* Returns FALSE when the marking is over. A thread is counted as active
+	while it has any work, private or shared, and work is only ever shared
+	by an active thread; so once no thread is active, no work is left. */
+	__atomic_sub_fetch(&job->numActiveMarkers, 1, __ATOMIC_SEQ_CST);
+
+	while (__atomic_load_n(&job->numActiveMarkers, __ATOMIC_SEQ_CST) > 0) {
+
+		if (isAnyWorkShared(job)) {
+			__atomic_add_fetch(&job->numActiveMarkers, 1, __ATOMIC_SEQ_CST);
+
+			if (stealWork(job, index, local)) {
+				return TRUE;
+			}
+
+			__atomic_sub_fetch(&job->numActiveMarkers, 1, __ATOMIC_SEQ_CST);
+		}
+
+		sched_yield();
+	}
+
+	return FALSE;
+}
+
+static void markInParallel(GC_JOB * job, int index) {
+	GC_MARK_STACK * shared = &job->markStacks[index];
+	GC_LOCAL_STACK local = { NULL, 0, 0, &shared->counts };
+
+	for (;;) {
+
+		if (local.size == 0 && !takeSharedWork(shared, &local, FALSE) && !stealWork(job, index, &local) && !waitForWork(job, index, &local)) {
+			break;
+		}
+
+		LC_EXPR * expr = local.items[--local.size];
+
+		/* Claim expr; the plain load first saves a write to a marked node */
+
+		if (__atomic_load_n(&expr->mark, __ATOMIC_RELAXED) != 0 || __atomic_exchange_n(&expr->mark, 1, __ATOMIC_RELAXED) != 0) {
+			continue;
+		}
+
+		if (expr->expr != NULL) {
+			pushLocal(&local, expr->expr);
+		}
+
+		if (expr->expr2 != NULL) {
+			pushLocal(&local, expr->expr2);
+		}
+
+		if (local.size >= 2 * gcMarkBatchSize && __atomic_load_n(&shared->size, __ATOMIC_RELAXED) == 0) {
+			shareWork(shared, &local);
+		}
+	}
+
+	countedFree(local.counts, local.items);
+}
+
+static void getPartition(GC_JOB * job, int index, MEMMGR_RECORD ** first, MEMMGR_RECORD ** end) {
+	*first = job->chunks[(long)index * job->numChunks / job->numThreads];
+	*end = job->chunks[(long)(index + 1) * job->numChunks / job->numThreads];
+}
+
+static void clearPartition(GC_JOB * job, int index) {
+	MEMMGR_RECORD * mmRec;
+	MEMMGR_RECORD * end;
+
+	for (getPartition(job, index, &mmRec, &end); mmRec != end; mmRec = mmRec->next) {
+		mmRec->expr->mark = 0;
+	}
+}
+
+static void sweepPartition(GC_JOB * job, int index) {
+	GC_SWEEP_RESULT * result = &job->sweepResults[index];
+	MEMMGR_RECORD * mmRec;
+	MEMMGR_RECORD * end;
+
+	result->head = result->tail = NULL;
+	result->numFreed = 0;
+
+	for (getPartition(job, index, &mmRec, &end); mmRec != end; ) {
+		MEMMGR_RECORD * nextmmRec = mmRec->next;
+
+		if (mmRec->expr->mark == 0) {
+			free(mmRec->expr);
+			free(mmRec);
+			++result->numFreed;
+		} else if (result->tail == NULL) {
+			result->head = result->tail = mmRec;
+		} else {
+			result->tail->next = mmRec;
+			result->tail = mmRec;
+		}
+
+		mmRec = nextmmRec;
+	}
+
+	if (result->tail != NULL) {
+		result->tail->next = NULL;
+	}
+}
+
+static void shareRoots(GC_JOB * job) {
+	/* Start with the roots on thread 0's shared stack */
+	GC_MARK_STACK * shared = &job->markStacks[0];
+
+	for (shared->capacity = 0; job->roots[shared->capacity] != NULL; ++shared->capacity) {
+	}
+
+	shared->items = (LC_EXPR **)countedRealloc(&shared->counts, NULL, (shared->capacity + 1) * sizeof(LC_EXPR *));
+	memcpy(shared->items, job->roots, shared->capacity * sizeof(LC_EXPR *));
+	shared->size = shared->capacity;
+}
+
+static void runGcWorker(GC_JOB * job, int index) {
+	clearPartition(job, index);
+
+	pthread_barrier_wait(&job->barrier);
+	markInParallel(job, index);
+	pthread_barrier_wait(&job->barrier);
+
+	if (index == 0) {
+		job->markEndTime = getTelemetryClock();
+	}
+
+	sweepPartition(job, index);
+}
+
+static void * gcWorkerLoop(void * arg) {
+	GC_WORKER_ARGS * args = (GC_WORKER_ARGS *)arg;
+
+	runGcWorker(args->job, args->index);
+
+	return NULL;
+}
+
+static MEMMGR_RECORD ** findChunks(LC_CONTEXT * ctx, int * numChunks) {
+	/* The first record of every chunk, and then NULL */
+	MEMMGR_RECORD ** chunks = NULL;
+	MEMMGR_RECORD * mmRec;
+	int capacity = 0;
+	int n = 0;
+	int i = 0;
+
+	for (mmRec = ctx->memmgrRecords; ; mmRec = mmRec->next) {
+
+		if (mmRec == NULL || i++ % gcChunkSize == 0) {
+
+			if (n == capacity) {
+				capacity = (capacity == 0) ? 256 : 2 * capacity;
+				chunks = (MEMMGR_RECORD **)countedRealloc(&ctx->gcCounts, chunks, capacity * sizeof(MEMMGR_RECORD *));
+			}
+
+			chunks[n++] = mmRec;
+		}
+
+		if (mmRec == NULL) {
+			break;
+		}
+	}
+
+	*numChunks = n - 1;
+
+	return chunks;
+}
+
+static BOOL collectGarbageInParallel(LC_CONTEXT * ctx, LC_EXPR * exprTreesToMark[]) {
+	/* Returns FALSE if the heap is too small to be worth it */
+	const long startTime = getTelemetryClock();
+	const int numCpus = ctx->uncapGcThreads ? ctx->numGcThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	const int numThreads = (ctx->numGcThreads < numCpus) ? ctx->numGcThreads : numCpus; /* More would only take turns */
+	GC_JOB job;
 	int i;
 
-	clearMarks();
+	if (numThreads < 2 || ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees < parallelGcThreshold) {
+		return FALSE;
+	}
+
+	memset(&job, 0, sizeof(GC_JOB));
+	job.ctx = ctx;
+	job.chunks = findChunks(ctx, &job.numChunks);
+	job.numThreads = (numThreads < job.numChunks) ? numThreads : job.numChunks;
+	job.roots = exprTreesToMark;
+	job.markStacks = (GC_MARK_STACK *)countedCalloc(&ctx->gcCounts, job.numThreads, sizeof(GC_MARK_STACK));
+	job.sweepResults = (GC_SWEEP_RESULT *)countedCalloc(&ctx->gcCounts, job.numThreads, sizeof(GC_SWEEP_RESULT));
+	job.numActiveMarkers = job.numThreads;
+	shareRoots(&job);
+	pthread_barrier_init(&job.barrier, NULL, job.numThreads);
+
+	pthread_t * threads = (pthread_t *)countedRealloc(&ctx->gcCounts, NULL, job.numThreads * sizeof(pthread_t));
+	GC_WORKER_ARGS * args = (GC_WORKER_ARGS *)countedRealloc(&ctx->gcCounts, NULL, job.numThreads * sizeof(GC_WORKER_ARGS));
+
+	for (i = 0; i < job.numThreads; ++i) {
+		pthread_mutex_init(&job.markStacks[i].mutex, NULL);
+		args[i].job = &job;
+		args[i].index = i;
+	}
+
+	for (i = 1; i < job.numThreads; ++i) {
+		pthread_create(&threads[i], NULL, gcWorkerLoop, &args[i]);
+	}
+
+	runGcWorker(&job, 0);
+
+	for (i = 1; i < job.numThreads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	/* Join the lists of survivors, in order */
+	MEMMGR_RECORD ** ppmmRec = &ctx->memmgrRecords;
+
+	for (i = 0; i < job.numThreads; ++i) {
+		GC_SWEEP_RESULT * result = &job.sweepResults[i];
+
+		if (result->head != NULL) {
+			*ppmmRec = result->head;
+			ppmmRec = &result->tail->next;
+		}
 
-	for (i = 0; exprTreesToMark[i] != NULL; ++i) {
-		setMarksInExprTree(exprTreesToMark[i]);
+		addNumFreesInCreateAndDestroy(ctx, result->numFreed);
+		ctx->memMgrCounts.numFrees += result->numFreed;
+		pthread_mutex_destroy(&job.markStacks[i].mutex);
+		countedFree(&job.markStacks[i].counts, job.markStacks[i].items);
+		ctx->gcCounts.numMallocs += job.markStacks[i].counts.numMallocs;
+		ctx->gcCounts.numFrees += job.markStacks[i].counts.numFrees;
+		ctx->gcCounts.numBytesAllocated += job.markStacks[i].counts.numBytesAllocated;
+		ctx->gcCounts.numBytesFreed += job.markStacks[i].counts.numBytesFreed;
 	}
 
-	freeUnmarkedStructs();
+	*ppmmRec = NULL;
+	recordCollection(ctx, job.markEndTime - startTime, getTelemetryClock() - job.markEndTime);
+
+	pthread_barrier_destroy(&job.barrier);
+	countedFree(&ctx->gcCounts, args);
+	countedFree(&ctx->gcCounts, threads);
+	countedFree(&ctx->gcCounts, job.sweepResults);
+	countedFree(&ctx->gcCounts, job.markStacks);
+	countedFree(&ctx->gcCounts, job.chunks);
+
+	return TRUE;
 }
 
-void freeAllStructs() {
-	clearMarks();
-	freeUnmarkedStructs();
+void collectGarbage(LC_CONTEXT * ctx, LC_EXPR * exprTreesToMark[]) {
+	const long startTime = getTelemetryClock();
+
+	if (collectGarbageInParallel(ctx, exprTreesToMark)) {
+		return;
+	}
+
+	clearMarks(ctx);
+	setMarksInExprTrees(ctx, exprTreesToMark);
+
+	const long sweepStartTime = getTelemetryClock();
+
+	freeUnmarkedStructs(ctx);
+	recordCollection(ctx, sweepStartTime - startTime, getTelemetryClock() - sweepStartTime);
+}
+
+void freeStructsAllocatedSince(LC_CONTEXT * ctx, MEMMGR_RECORD * oldHead) {
+	/* Free the nodes added to the heap since its head was oldHead (which
+	must not have been freed since): new records go at the front. Nodes
+	created before then never point to newer ones, so this is safe. */
+
+	while (ctx->memmgrRecords != NULL && ctx->memmgrRecords != oldHead) {
+		MEMMGR_RECORD * mmRec = ctx->memmgrRecords;
+
+		ctx->memmgrRecords = mmRec->next;
+		free(mmRec->expr);
+		incNumFreesInCreateAndDestroy(ctx);
+		free(mmRec);
+		++ctx->memMgrCounts.numFrees;
+	}
+}
+
+void freeAllStructs(LC_CONTEXT * ctx) {
+	const long startTime = getTelemetryClock();
+	LC_EXPR * noRoots[] = { NULL };
+
+	if (collectGarbageInParallel(ctx, noRoots)) {
+		return;
+	}
+
+	clearMarks(ctx);
+
+	const long sweepStartTime = getTelemetryClock();
+
+	freeUnmarkedStructs(ctx);
+	recordCollection(ctx, sweepStartTime - startTime, getTelemetryClock() - sweepStartTime);
 }
 
 /* **** END Memory manager version 1 **** */
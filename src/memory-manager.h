@@ -5,11 +5,14 @@ typedef struct MEMMGR_RECORD_STRUCT {
 	struct MEMMGR_RECORD_STRUCT * next;
 } MEMMGR_RECORD;
 
-void addItemToMemMgrRecords(LC_EXPR * item);
-int getNumMemMgrRecords();
-void collectGarbage(LC_EXPR * exprTreesToMark[]);
-void freeAllStructs();
+void addItemToMemMgrRecords(LC_CONTEXT * ctx, LC_EXPR * item);
+int getNumMemMgrRecords(LC_CONTEXT * ctx);
+void collectGarbage(LC_CONTEXT * ctx, LC_EXPR * exprTreesToMark[]);
+void freeStructsAllocatedSince(LC_CONTEXT * ctx, MEMMGR_RECORD * oldHead);
+void freeAllStructs(LC_CONTEXT * ctx);
+void adoptMemMgrRecords(LC_CONTEXT * ctx, LC_CONTEXT * otherCtx);
+void markExprTree(LC_CONTEXT * ctx, LC_EXPR * expr);
 
-void printMemMgrSelfReport();
+void printMemMgrSelfReport(LC_CONTEXT * ctx);
 
 /* **** The End **** */
@@ -0,0 +1,395 @@
+/* facility/src/normalization-by-evaluation.c */
+
+/* An alternative reduction engine: normalization by evaluation (Berger and
+ * Schwichtenberg; see also Abel, "Normalization by Evaluation", 2013).
+ *
+ * Instead of substituting into the term, evaluate it into semantic values:
+ *
+ *	Closure		A lambda together with the environment it was built in
+ *	Thunk		An argument not yet needed: a subterm and an environment.
+ *			It is evaluated at most once, and then becomes an
+ *			indirection to its value (call-by-need), so an argument
+ *			that is discarded is never evaluated, and one that is
+ *			used many times is evaluated only once
+ *	Neutral		A variable that is free in the term, or one bound by the
+ *			read-back (identified by its de Bruijn level), or a
+ *			neutral applied to an argument
+ *
+ * The term is evaluated from its flat encoding (see flat-expr.c), where each
+ * variable already carries its de Bruijn index, so a variable is looked up
+ * by position in the environment and names are never compared. Applying a
+ * closure just extends its environment; nothing is copied or renamed.
+ *
+ * The value is then read back into a term: a closure is applied to a fresh
+ * neutral variable at the next level, and the result is read back under a
+ * lambda; a neutral application reads back its head and its arguments. A
+ * lambda keeps its name unless that name is free in the term or is bound by
+ * an enclosing lambda of the result, in which case it gets a fresh one, so
+ * nothing is captured. The result is then η-reduced, like the input to
+ * betaReduce().
+ *
+ * A term without a normal form would evaluate forever, so the evaluation
+ * gives up after maxNbeSteps steps (or maxNbeDepth nested evaluations), and
+ * the term is reduced in normal order instead. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+#include "flat-expr.h"
+#include "normalization-by-evaluation.h"
+
+/* const long maxNbeSteps = 1L << 22; */
+#define maxNbeSteps (1L << 22)
+/* const int maxNbeDepth = 50000; */
+#define maxNbeDepth 50000
+
+typedef enum {
+	nbeValue_Closure, /* term is the lambda's node */
+	nbeValue_Thunk, /* term is the subterm's node */
+	nbeValue_Indirection, /* A forced thunk; left is its value, or -1 while it is being forced */
+	nbeValue_BoundVariable, /* left is its de Bruijn level */
+	nbeValue_FreeVariable, /* term is one of its occurrences */
+	nbeValue_Application /* A neutral application; left is the callee, right the argument */
+} NbeValueType;
+
+typedef struct {
+	NbeValueType type;
+	unsigned int term; /* For closures, thunks and free variables: a node of the flat encoding */
+	int env; /* For closures and thunks */
+	int left;
+	int right;
+} NBE_VALUE;
+
+typedef struct {
+	int value;
+	int next; /* -1 at the end of the environment */
+} NBE_ENV_CELL;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	FLAT_EXPR * code;
+	NBE_VALUE * values;
+	int numValues;
+	int valueCapacity;
+	NBE_ENV_CELL * envCells;
+	int numEnvCells;
+	int envCellCapacity;
+	char (* levelNames)[maxStringValueLength]; /* The names of the lambdas of the result, by de Bruijn level */
+	int levelNamesCapacity;
+	char ** freeNames; /* Of the whole term */
+	int numFreeNames;
+	long numSteps;
+	BOOL failed;
+} NBE_MACHINE;
+
+/* **** Allocation **** */
+
+void printNbeMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Normalization by evaluation", &ctx->nbeCounts);
+}
+
+static void * nbeRealloc(NBE_MACHINE * nbe, void * ptr, size_t size) {
+	return countedRealloc(&nbe->ctx->nbeCounts, ptr, size);
+}
+
+static void nbeFree(NBE_MACHINE * nbe, void * ptr) {
+	countedFree(&nbe->ctx->nbeCounts, ptr);
+}
+
+static int createValue(NBE_MACHINE * nbe, NbeValueType type, unsigned int term, int env, int left, int right) {
+
+	if (nbe->numValues == nbe->valueCapacity) {
+		nbe->valueCapacity = (nbe->valueCapacity == 0) ? 1024 : 2 * nbe->valueCapacity;
+		nbe->values = (NBE_VALUE *)nbeRealloc(nbe, nbe->values, nbe->valueCapacity * sizeof(NBE_VALUE));
+	}
+
+	NBE_VALUE * value = &nbe->values[nbe->numValues];
+
+	value->type = type;
+	value->term = term;
+	value->env = env;
+	value->left = left;
+	value->right = right;
+
+	return nbe->numValues++;
+}
+
+static int extendEnv(NBE_MACHINE * nbe, int value, int env) {
+
+	if (nbe->numEnvCells == nbe->envCellCapacity) {
+		nbe->envCellCapacity = (nbe->envCellCapacity == 0) ? 1024 : 2 * nbe->envCellCapacity;
+		nbe->envCells = (NBE_ENV_CELL *)nbeRealloc(nbe, nbe->envCells, nbe->envCellCapacity * sizeof(NBE_ENV_CELL));
+	}
+
+	nbe->envCells[nbe->numEnvCells].value = value;
+	nbe->envCells[nbe->numEnvCells].next = env;
+
+	return nbe->numEnvCells++;
+}
+
+static int lookUp(NBE_MACHINE * nbe, int env, unsigned int index) {
+	/* index is a de Bruijn index, so it is 1 for the innermost binder */
+
+	while (--index > 0) {
+		env = nbe->envCells[env].next;
+	}
+
+	return nbe->envCells[env].value;
+}
+
+/* **** Evaluation **** */
+
+static int evaluate(NBE_MACHINE * nbe, unsigned int term, int env, int depth);
+
+static int force(NBE_MACHINE * nbe, int v, int depth) {
+	/* Return the value of v, evaluating it if it is a thunk */
+
+	while (v >= 0 && nbe->values[v].type == nbeValue_Indirection) {
+		v = nbe->values[v].left;
+	}
+
+	if (v < 0) {
+		/* A thunk that needs its own value: it can have none */
+		nbe->failed = TRUE;
+		return -1;
+	} else if (nbe->values[v].type != nbeValue_Thunk) {
+		return v;
+	}
+
+	const unsigned int term = nbe->values[v].term;
+	const int env = nbe->values[v].env;
+
+	nbe->values[v].type = nbeValue_Indirection;
+	nbe->values[v].left = -1;
+
+	const int result = evaluate(nbe, term, env, depth + 1);
+
+	/* evaluate() may have moved nbe->values */
+	nbe->values[v].left = result;
+
+	return result;
+}
+
+static int delay(NBE_MACHINE * nbe, unsigned int term, int env) {
+	/* The value of an argument. Variables and lambdas are cheap to evaluate
+	at once, and that saves a thunk (and a chain of thunks) for each. */
+	FLAT_NODE * node = &nbe->code->nodes[term];
+
+	switch (getFlatNodeType(node)) {
+		case lcExpressionType_Variable:
+			return (node->index > 0) ? lookUp(nbe, env, node->index) : createValue(nbe, nbeValue_FreeVariable, term, -1, -1, -1);
+
+		case lcExpressionType_LambdaExpr:
+			return createValue(nbe, nbeValue_Closure, term, env, -1, -1);
+
+		default:
+			return createValue(nbe, nbeValue_Thunk, term, env, -1, -1);
+	}
+}
+
+static int evaluate(NBE_MACHINE * nbe, unsigned int term, int env, int depth) {
+	/* Return the value of term in env, which is never a thunk. Applying a
+	closure is a tail call, so it is a loop. */
+
+	for (;;) {
+
+		if (++nbe->numSteps > maxNbeSteps || depth > maxNbeDepth) {
+			nbe->failed = TRUE;
+		}
+
+		if (nbe->failed) {
+			return -1;
+		}
+
+		FLAT_NODE * node = &nbe->code->nodes[term];
+
+		switch (getFlatNodeType(node)) {
+			case lcExpressionType_Variable:
+				return (node->index > 0) ? force(nbe, lookUp(nbe, env, node->index), depth) : createValue(nbe, nbeValue_FreeVariable, term, -1, -1, -1);
+
+			case lcExpressionType_LambdaExpr:
+				return createValue(nbe, nbeValue_Closure, term, env, -1, -1);
+
+			default:
+				break;
+		}
+
+		/* An application */
+		const unsigned int argTerm = term + 1 + nbe->code->nodes[term + 1].size;
+		const int f = evaluate(nbe, term + 1, env, depth + 1);
+
+		if (f < 0) {
+			return -1;
+		}
+
+		const int arg = delay(nbe, argTerm, env);
+
+		if (nbe->values[f].type != nbeValue_Closure) {
+			return createValue(nbe, nbeValue_Application, 0, -1, f, arg);
+		}
+
+		++nbe->ctx->numBetaReductions;
+		env = extendEnv(nbe, arg, nbe->values[f].env);
+		term = nbe->values[f].term + 1;
+	}
+}
+
+static int apply(NBE_MACHINE * nbe, int f, int arg, int depth) {
+	/* f is a value; arg may be a thunk */
+
+	if (nbe->values[f].type != nbeValue_Closure) {
+		return createValue(nbe, nbeValue_Application, 0, -1, f, arg);
+	}
+
+	++nbe->ctx->numBetaReductions;
+
+	return evaluate(nbe, nbe->values[f].term + 1, extendEnv(nbe, arg, nbe->values[f].env), depth + 1);
+}
+
+/* **** Read-back to LC_EXPR **** */
+
+static BOOL isNameTaken(NBE_MACHINE * nbe, char * name, int level) {
+	int i;
+
+	for (i = 0; i < nbe->numFreeNames; ++i) {
+
+		if (!strcmp(nbe->freeNames[i], name)) {
+			return TRUE;
+		}
+	}
+
+	for (i = 0; i < level; ++i) {
+
+		if (!strcmp(nbe->levelNames[i], name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void nameLevel(NBE_MACHINE * nbe, char * name, int level) {
+	/* Choose the name of the lambda of the result at the given level */
+
+	if (level >= nbe->levelNamesCapacity) {
+		nbe->levelNamesCapacity = (nbe->levelNamesCapacity == 0) ? 64 : 2 * nbe->levelNamesCapacity;
+		nbe->levelNames = (char (*)[maxStringValueLength])nbeRealloc(nbe, nbe->levelNames, nbe->levelNamesCapacity * maxStringValueLength);
+	}
+
+	memset(nbe->levelNames[level], 0, maxStringValueLength);
+	strcpy(nbe->levelNames[level], name);
+
+	while (isNameTaken(nbe, nbe->levelNames[level], level)) {
+		generateNewVariableName(nbe->ctx, nbe->levelNames[level], maxStringValueLength);
+	}
+}
+
+static LC_EXPR * readBack(NBE_MACHINE * nbe, int v, int level, int depth) {
+	LC_EXPR * result = NULL;
+
+	if (depth > maxNbeDepth) {
+		nbe->failed = TRUE;
+	}
+
+	v = force(nbe, v, depth);
+
+	if (nbe->failed) {
+		return NULL;
+	}
+
+	switch (nbe->values[v].type) {
+		case nbeValue_Closure:
+			{
+				const int variable = createValue(nbe, nbeValue_BoundVariable, 0, -1, level, -1);
+
+				nameLevel(nbe, getFlatNodeName(nbe->code, nbe->values[v].term), level);
+
+				LC_EXPR * body = readBack(nbe, apply(nbe, v, variable, depth), level + 1, depth + 1);
+
+				/* Look the name up afresh: nbe->levelNames may have moved */
+				result = (body == NULL) ? NULL : createLambdaExpr(nbe->ctx, nbe->levelNames[level], body);
+			}
+
+			break;
+
+		case nbeValue_BoundVariable:
+			result = createVariable(nbe->ctx, nbe->levelNames[nbe->values[v].left]);
+			break;
+
+		case nbeValue_FreeVariable:
+			result = createVariable(nbe->ctx, getFlatNodeName(nbe->code, nbe->values[v].term));
+			break;
+
+		case nbeValue_Application:
+			{
+				const int arg = nbe->values[v].right;
+				LC_EXPR * callee = readBack(nbe, nbe->values[v].left, level, depth + 1);
+				LC_EXPR * argExpr = (callee == NULL) ? NULL : readBack(nbe, arg, level, depth + 1);
+
+				result = (argExpr == NULL) ? NULL : createFunctionCall(nbe->ctx, callee, argExpr);
+			}
+
+			break;
+
+		default:
+			nbe->failed = TRUE;
+			break;
+	}
+
+	return result;
+}
+
+/* **** The engine **** */
+
+LC_EXPR * normalizeByEvaluation(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth) {
+	NBE_MACHINE nbe;
+	LC_EXPR * result = NULL;
+
+	if (ctx->enableDeltaReduction) {
+		/* The primitives would be taken for free variables */
+		return betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	}
+
+	memset(&nbe, 0, sizeof(NBE_MACHINE));
+	nbe.ctx = ctx;
+	nbe.code = toFlatExpr(ctx, expr);
+	nbe.numFreeNames = getFlatFreeVariableNames(nbe.code, NULL, 0);
+	nbe.freeNames = (char **)nbeRealloc(&nbe, NULL, (nbe.numFreeNames + 1) * sizeof(char *));
+	getFlatFreeVariableNames(nbe.code, nbe.freeNames, nbe.numFreeNames);
+
+	const int value = evaluate(&nbe, 0, -1, 0);
+
+	if (!nbe.failed) {
+		result = readBack(&nbe, value, 0, 0);
+	}
+
+	if (result == NULL) {
+		fprintf(stderr, "normalizeByEvaluation() : %s after %ld steps; using normal order instead\n",
+			(nbe.numSteps > maxNbeSteps) ? "Too many steps" : "Cannot evaluate or read back the term",
+			nbe.numSteps);
+		result = betaReduce(ctx, expr, maxDepth, brsNormalOrder);
+	} else {
+		result = etaReduce(ctx, result);
+	}
+
+	nbeFree(&nbe, nbe.freeNames);
+	nbeFree(&nbe, nbe.levelNames);
+	nbeFree(&nbe, nbe.envCells);
+	nbeFree(&nbe, nbe.values);
+	freeFlatExpr(nbe.code);
+
+	return result;
+}
+
+/* **** The End **** */
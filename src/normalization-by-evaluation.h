@@ -0,0 +1,6 @@
+/* facility/src/normalization-by-evaluation.h */
+
+void printNbeMemMgrReport(LC_CONTEXT * ctx);
+LC_EXPR * normalizeByEvaluation(LC_CONTEXT * ctx, LC_EXPR * expr, int maxDepth);
+
+/* **** The End **** */
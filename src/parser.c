@@ -0,0 +1,106 @@
+/* facility/src/parser.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+#include "create-and-destroy.h"
+
+#include "beta-reduction.h"
+#include "char-source.h"
+#include "delta-reduction.h"
+#include "parser.h"
+
+/* Long enough for the digits of any long, so that an integer literal is
+not cut short like a name */
+/* const int maxTokenLength = 32; */
+#define maxTokenLength 32
+
+static LC_EXPR * parseExpression(LC_CONTEXT * ctx, CharSource * cs) {
+	char dstBuf[maxStringValueLength];
+	int c = getNextChar(cs);
+
+	if (c == EOF) {
+		return NULL;
+	/*} else if (c == 'λ') { */ /* error: character too large for enclosing character literal type */
+	} else if (c == '\\') {
+
+		if (getIdentifier(cs, dstBuf, maxStringValueLength) == 0) {
+			return NULL;
+		}
+
+		if (!consumeStr(cs, ".")) {
+			fprintf(stderr, "parseExpression() : Error consuming '.'\n");
+			return NULL;
+		}
+
+		LC_EXPR * expr = parseExpression(ctx, cs);
+
+		if (expr == NULL) {
+			return NULL;
+		}
+
+		return createLambdaExpr(ctx, dstBuf, expr);
+	} else if (c == '(') {
+		LC_EXPR * expr = parseExpression(ctx, cs);
+
+		if (expr == NULL) {
+			return NULL;
+		}
+
+		LC_EXPR * expr2 = parseExpression(ctx, cs);
+
+		if (expr2 == NULL) {
+			return NULL;
+		} else if (!consumeStr(cs, ")")) {
+			fprintf(stderr, "parseExpression() : Error consuming ')'\n");
+			return NULL;
+		}
+
+		return createFunctionCallOrIteration(ctx, expr, expr2);
+	} else {
+		char tokenBuf[maxTokenLength];
+
+		rewindOneChar(cs);
+
+		if (getIdentifier(cs, tokenBuf, maxTokenLength) == 0) {
+			return NULL;
+		}
+
+		if (ctx->enableDeltaReduction && isIntegerLiteralString(tokenBuf)) {
+			errno = 0;
+
+			const long value = strtol(tokenBuf, NULL, 10);
+
+			if (errno == ERANGE) {
+				fprintf(stderr, "parseExpression() : The integer literal '%s' is out of range\n", tokenBuf);
+				return NULL;
+			}
+
+			return createIntegerLiteral(ctx, value);
+		}
+
+		memset(dstBuf, 0, maxStringValueLength);
+		memcpy(dstBuf, tokenBuf, maxStringValueLength - 1);
+
+		return createVariable(ctx, dstBuf);
+	}
+}
+
+LC_EXPR * parse(LC_CONTEXT * ctx, char * str) {
+	CharSource * cs = createCharSource(ctx, str);
+
+	LC_EXPR * parseTree = parseExpression(ctx, cs);
+
+	freeCharSource(cs);
+
+	return parseTree;
+}
+
+/* **** The End **** */
@@ -0,0 +1,5 @@
+/* facility/src/parser.h */
+
+LC_EXPR * parse(LC_CONTEXT * ctx, char * str);
+
+/* **** The End **** */
@@ -0,0 +1,558 @@
+/* facility/src/printer.c */
+
+/* The printer walks the expression iteratively, with an explicit stack, so
+ * deep terms do not overflow the C stack. Output is collected in a large
+ * buffer and written in big chunks.
+ *
+ * Reduction shares subterms (e.g. an argument that is substituted for
+ * several occurrences of a variable), so an expression is really a DAG, and
+ * printing it as a tree can take time exponential in its size.
+ * fprintExprWithSharing() prints each shared subterm once, as a definition:
+ *
+ *	let $1 = (f y) in
+ *	($1 $1)
+ *
+ * The definitions are textual, like macros: replacing each $n by its
+ * definition gives exactly what fprintExpr() prints, with any variables in
+ * the definition bound at the place where $n occurs.
+ *
+ * fprintNormalFormStreaming() interleaves printing with reduction: it
+ * reduces a term only to head normal form, λx1...λxn.(v a1 ... am), prints
+ * everything up to the arguments, and then normalizes and prints each
+ * argument in turn. Whatever has been printed is garbage, so output starts
+ * early, and a normal form that is huge (or infinite) can be printed in
+ * bounded memory.
+ *
+ * An Iteration (f (f ... (f x))) takes three stack items however long it
+ * is: its closing parentheses, x, and an item that prints "(f " and then
+ * pushes itself again with one fewer to go. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+#include "create-and-destroy.h"
+
+#include "beta-reduction.h"
+#include "printer.h"
+
+/* const int printBufferSize = 65536; */
+#define printBufferSize 65536
+/* const int streamingCollectionInterval = 65536; */
+#define streamingCollectionInterval 65536
+/* const long streamingStepsPerSlice = 4096; */
+#define streamingStepsPerSlice 4096L
+
+typedef struct {
+	FILE * fp;
+	int len;
+	char buf[printBufferSize];
+} PRINT_BUFFER;
+
+typedef struct {
+	LC_EXPR * expr; /* If NULL, then print str */
+	char * str;
+	BOOL expand; /* Print expr in full, even if it is shared */
+	long count; /* Print str this many times, or this many more "(f " of the Iteration expr; 0 for once, or all of expr */
+} PRINT_STACK_ITEM;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	PRINT_STACK_ITEM * items;
+	int size;
+	int capacity;
+} PRINT_STACK;
+
+typedef struct {
+	LC_EXPR * expr; /* NULL if the slot is empty */
+	int numParents;
+	BOOL isNumbered;
+	int id; /* Non-zero if expr is printed as a definition */
+} SHARING_TABLE_ENTRY;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	SHARING_TABLE_ENTRY * entries;
+	int capacity; /* A power of 2 */
+	int size;
+} SHARING_TABLE;
+
+void printPrinterMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("Printer", &ctx->printerCounts);
+}
+
+/* **** The output buffer **** */
+
+static void flushPrintBuffer(PRINT_BUFFER * pb) {
+
+	if (pb->len > 0) {
+		fwrite(pb->buf, sizeof(char), pb->len, pb->fp);
+		pb->len = 0;
+	}
+}
+
+static void appendToPrintBuffer(PRINT_BUFFER * pb, char * str) {
+	const int n = strlen(str);
+
+	if (pb->len + n > printBufferSize) {
+		flushPrintBuffer(pb);
+	}
+
+	memcpy(pb->buf + pb->len, str, n); /* n is small: a name or a token */
+	pb->len += n;
+}
+
+/* **** The stack **** */
+
+static void pushRepeatedPrintStack(PRINT_STACK * stack, LC_EXPR * expr, char * str, BOOL expand, long count) {
+
+	if (stack->size == stack->capacity) {
+		stack->capacity = (stack->capacity == 0) ? 256 : 2 * stack->capacity;
+		stack->items = (PRINT_STACK_ITEM *)countedRealloc(&stack->ctx->printerCounts, stack->items, stack->capacity * sizeof(PRINT_STACK_ITEM));
+	}
+
+	PRINT_STACK_ITEM * item = &stack->items[stack->size++];
+
+	item->expr = expr;
+	item->str = str;
+	item->expand = expand;
+	item->count = count;
+}
+
+static void pushPrintStack(PRINT_STACK * stack, LC_EXPR * expr, char * str, BOOL expand) {
+	pushRepeatedPrintStack(stack, expr, str, expand, 0);
+}
+
+static void pushClosingParenthesis(PRINT_STACK * stack) {
+	/* Merged into the ")" below it, if any */
+	PRINT_STACK_ITEM * top = (stack->size > 0) ? &stack->items[stack->size - 1] : NULL;
+
+	if (top != NULL && top->expr == NULL && !strcmp(top->str, ")")) {
+		top->count = ((top->count > 0) ? top->count : 1) + 1;
+	} else {
+		pushPrintStack(stack, NULL, ")", FALSE);
+	}
+}
+
+static void appendItemString(PRINT_BUFFER * pb, PRINT_STACK_ITEM * item) {
+	long i;
+
+	for (i = 0; i < item->count || i == 0; ++i) {
+		appendToPrintBuffer(pb, item->str);
+	}
+}
+
+static void freePrintStack(PRINT_STACK * stack) {
+	countedFree(&stack->ctx->printerCounts, stack->items);
+}
+
+/* **** The sharing table: a hash table keyed on the address of the node **** */
+
+static SHARING_TABLE_ENTRY * findSharingTableEntry(SHARING_TABLE * table, LC_EXPR * expr) {
+	/* Returns the entry for expr, or the empty slot where it belongs */
+	unsigned long h = (unsigned long)expr;
+
+	h ^= h >> 17;
+	h *= 0x9E3779B97F4A7C15UL;
+
+	int i = (int)((h >> 32) & (table->capacity - 1));
+
+	while (table->entries[i].expr != NULL && table->entries[i].expr != expr) {
+		i = (i + 1) & (table->capacity - 1);
+	}
+
+	return &table->entries[i];
+}
+
+static void growSharingTable(SHARING_TABLE * table) {
+	SHARING_TABLE_ENTRY * oldEntries = table->entries;
+	const int oldCapacity = table->capacity;
+	int i;
+
+	table->capacity = (oldCapacity == 0) ? 1024 : 2 * oldCapacity;
+	table->entries = (SHARING_TABLE_ENTRY *)countedCalloc(&table->ctx->printerCounts, table->capacity, sizeof(SHARING_TABLE_ENTRY));
+
+	for (i = 0; i < oldCapacity; ++i) {
+
+		if (oldEntries[i].expr != NULL) {
+			*findSharingTableEntry(table, oldEntries[i].expr) = oldEntries[i];
+		}
+	}
+
+	countedFree(&table->ctx->printerCounts, oldEntries);
+}
+
+static SHARING_TABLE_ENTRY * addToSharingTable(SHARING_TABLE * table, LC_EXPR * expr) {
+
+	if (2 * (table->size + 1) > table->capacity) {
+		growSharingTable(table);
+	}
+
+	SHARING_TABLE_ENTRY * entry = findSharingTableEntry(table, expr);
+
+	if (entry->expr == NULL) {
+		entry->expr = expr;
+		++table->size;
+	}
+
+	return entry;
+}
+
+static void countParents(SHARING_TABLE * table, PRINT_STACK * stack, LC_EXPR * expr) {
+	/* Visit each node once, counting the references to it */
+	stack->size = 0;
+	pushPrintStack(stack, expr, NULL, FALSE);
+
+	while (stack->size > 0) {
+		LC_EXPR * node = stack->items[--stack->size].expr;
+
+		if (++addToSharingTable(table, node)->numParents > 1) {
+			continue;
+		}
+
+		if (node->expr2 != NULL) {
+			pushPrintStack(stack, node->expr2, NULL, FALSE);
+		}
+
+		if (node->expr != NULL) {
+			pushPrintStack(stack, node->expr, NULL, FALSE);
+		}
+	}
+}
+
+static int numberSharedNodes(SHARING_TABLE * table, PRINT_STACK * stack, LC_EXPR * expr) {
+	/* Number the shared nodes (other than variables and literals) in
+	post-order, so that each definition refers only to earlier ones. Each
+	node is pushed twice: with expand == FALSE on the way down, and with
+	expand == TRUE to be numbered on the way back up. Returns the number of
+	definitions. */
+	int numDefinitions = 0;
+
+	stack->size = 0;
+	pushPrintStack(stack, expr, NULL, FALSE);
+
+	while (stack->size > 0) {
+		PRINT_STACK_ITEM item = stack->items[--stack->size];
+		SHARING_TABLE_ENTRY * entry = findSharingTableEntry(table, item.expr);
+
+		if (item.expand) {
+
+			if (entry->numParents > 1 &&
+				(item.expr->type == lcExpressionType_LambdaExpr || item.expr->type == lcExpressionType_FunctionCall ||
+				item.expr->type == lcExpressionType_Iteration)) {
+				entry->id = ++numDefinitions;
+			}
+
+			continue;
+		}
+
+		if (entry->isNumbered) {
+			continue;
+		}
+
+		entry->isNumbered = TRUE;
+		pushPrintStack(stack, item.expr, NULL, TRUE);
+
+		if (item.expr->expr2 != NULL) {
+			pushPrintStack(stack, item.expr->expr2, NULL, FALSE);
+		}
+
+		if (item.expr->expr != NULL) {
+			pushPrintStack(stack, item.expr->expr, NULL, FALSE);
+		}
+	}
+
+	return numDefinitions;
+}
+
+/* **** Printing **** */
+
+static void printExprToBuffer(PRINT_BUFFER * pb, PRINT_STACK * stack, SHARING_TABLE * table, LC_EXPR * expr) {
+	/* If table is not NULL, print references to the shared subterms in it,
+	except expr itself */
+	char buf[maxStringValueLength + 24];
+
+	stack->size = 0;
+	pushPrintStack(stack, expr, NULL, TRUE);
+
+	while (stack->size > 0) {
+		PRINT_STACK_ITEM item = stack->items[--stack->size];
+
+		if (item.expr == NULL) {
+			appendItemString(pb, &item);
+			continue;
+		}
+
+		expr = item.expr;
+
+		if (item.count > 0) {
+			/* The next "(f " of an Iteration */
+			if (item.count > 1) {
+				pushRepeatedPrintStack(stack, expr, NULL, TRUE, item.count - 1);
+			}
+
+			pushPrintStack(stack, NULL, " ", FALSE);
+			pushPrintStack(stack, expr->expr, NULL, FALSE);
+			appendToPrintBuffer(pb, "(");
+			continue;
+		}
+
+		if (table != NULL && !item.expand) {
+			const int id = findSharingTableEntry(table, expr)->id;
+
+			if (id > 0) {
+				sprintf(buf, "$%d", id);
+				appendToPrintBuffer(pb, buf);
+				continue;
+			}
+		}
+
+		switch (expr->type) {
+			case lcExpressionType_Variable:
+				appendToPrintBuffer(pb, expr->name);
+				break;
+
+			case lcExpressionType_LambdaExpr:
+				sprintf(buf, "λ%s.", expr->name);
+				appendToPrintBuffer(pb, buf);
+				pushPrintStack(stack, expr->expr, NULL, FALSE);
+				break;
+
+			case lcExpressionType_FunctionCall:
+				/* Push in reverse order */
+				pushPrintStack(stack, NULL, ")", FALSE);
+				pushPrintStack(stack, expr->expr2, NULL, FALSE);
+				pushPrintStack(stack, NULL, " ", FALSE);
+				pushPrintStack(stack, expr->expr, NULL, FALSE);
+				appendToPrintBuffer(pb, "(");
+				break;
+
+			case lcExpressionType_Iteration:
+				pushRepeatedPrintStack(stack, NULL, ")", FALSE, expr->value);
+				pushPrintStack(stack, expr->expr2, NULL, FALSE);
+				pushRepeatedPrintStack(stack, expr, NULL, TRUE, expr->value);
+				break;
+
+			case lcExpressionType_IntegerLiteral:
+				sprintf(buf, "%ld", expr->value);
+				appendToPrintBuffer(pb, buf);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+void fprintExpr(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr) {
+	PRINT_BUFFER * pb = (PRINT_BUFFER *)countedRealloc(&ctx->printerCounts, NULL, sizeof(PRINT_BUFFER));
+	PRINT_STACK stack = { ctx, NULL, 0, 0 };
+
+	pb->fp = fp;
+	pb->len = 0;
+	printExprToBuffer(pb, &stack, NULL, expr);
+	flushPrintBuffer(pb);
+	freePrintStack(&stack);
+	countedFree(&ctx->printerCounts, pb);
+}
+
+void printExpr(LC_CONTEXT * ctx, LC_EXPR * expr) {
+	fprintExpr(ctx, stdout, expr);
+}
+
+void fprintExprWithSharing(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr) {
+	PRINT_BUFFER * pb = (PRINT_BUFFER *)countedRealloc(&ctx->printerCounts, NULL, sizeof(PRINT_BUFFER));
+	PRINT_STACK stack = { ctx, NULL, 0, 0 };
+	SHARING_TABLE table = { ctx, NULL, 0, 0 };
+	char buf[32];
+	int i;
+
+	pb->fp = fp;
+	pb->len = 0;
+
+	countParents(&table, &stack, expr);
+
+	const int numDefinitions = numberSharedNodes(&table, &stack, expr);
+
+	if (numDefinitions > 0) {
+		/* Collect the definitions, in order */
+		LC_EXPR ** definitions = (LC_EXPR **)countedRealloc(&ctx->printerCounts, NULL, (numDefinitions + 1) * sizeof(LC_EXPR *));
+
+		for (i = 0; i < table.capacity; ++i) {
+
+			if (table.entries[i].id > 0) {
+				definitions[table.entries[i].id] = table.entries[i].expr;
+			}
+		}
+
+		for (i = 1; i <= numDefinitions; ++i) {
+			sprintf(buf, "let $%d = ", i);
+			appendToPrintBuffer(pb, buf);
+			printExprToBuffer(pb, &stack, &table, definitions[i]);
+			appendToPrintBuffer(pb, " in\n");
+		}
+
+		countedFree(&ctx->printerCounts, definitions);
+	}
+
+	printExprToBuffer(pb, &stack, &table, expr);
+	flushPrintBuffer(pb);
+
+	countedFree(&ctx->printerCounts, table.entries);
+	freePrintStack(&stack);
+	countedFree(&ctx->printerCounts, pb);
+}
+
+/* **** Streaming normalization **** */
+
+static int getNumLiveNodes(LC_CONTEXT * ctx) {
+	/* getNumMemMgrRecords() walks the heap */
+	return ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees;
+}
+
+static void collectStreamingGarbage(LC_CONTEXT * ctx, PRINT_STACK * stack, LC_EXPR * otherRoots[]) {
+	/* The roots are the terms on the stack, which are still to be printed,
+	and otherRoots */
+	int numOtherRoots = 0;
+	int n = 0;
+	int i;
+
+	while (otherRoots != NULL && otherRoots[numOtherRoots] != NULL) {
+		++numOtherRoots;
+	}
+
+	LC_EXPR ** roots = (LC_EXPR **)countedRealloc(&ctx->printerCounts, NULL, (stack->size + numOtherRoots + 1) * sizeof(LC_EXPR *));
+
+	for (i = 0; i < stack->size; ++i) {
+
+		if (stack->items[i].expr != NULL) {
+			roots[n++] = stack->items[i].expr;
+		}
+	}
+
+	for (i = 0; i < numOtherRoots; ++i) {
+		roots[n++] = otherRoots[i];
+	}
+
+	roots[n] = NULL;
+	collectGarbage(ctx, roots);
+	countedFree(&ctx->printerCounts, roots);
+}
+
+static LC_EXPR * reduceHeadCollecting(LC_CONTEXT * ctx, PRINT_STACK * stack, LC_EXPR * otherRoots[], LC_EXPR * expr, long * numStepsLeft, int * collectionThreshold) {
+	/* betaReduceHead() in slices, collecting garbage between them, so that
+	a long head reduction (or an endless one) runs in bounded memory. expr is
+	pushed while the collection runs, to keep it alive. */
+
+	while (*numStepsLeft > 0 && hasHeadRedex(expr)) {
+		long numSliceSteps = (*numStepsLeft < streamingStepsPerSlice) ? *numStepsLeft : streamingStepsPerSlice;
+
+		*numStepsLeft -= numSliceSteps;
+		expr = betaReduceHead(ctx, expr, &numSliceSteps);
+		*numStepsLeft += numSliceSteps;
+
+		if (getNumLiveNodes(ctx) > *collectionThreshold) {
+			pushPrintStack(stack, expr, NULL, FALSE);
+			collectStreamingGarbage(ctx, stack, otherRoots);
+			--stack->size;
+			*collectionThreshold = getNumLiveNodes(ctx) + streamingCollectionInterval;
+		}
+	}
+
+	return expr;
+}
+
+BOOL fprintNormalFormStreaming(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr, LC_EXPR * otherRoots[], long maxSteps) {
+	/* Print the β-normal form of expr (which is not η-reduced) while it is
+	being computed. The heap of ctx is collected as printing goes, so any
+	node of ctx that the caller still needs must be reachable from
+	otherRoots, a NULL-terminated array (or NULL). After maxSteps β-steps,
+	each unfinished subterm is printed as "..." and FALSE is returned. */
+	PRINT_BUFFER * pb = (PRINT_BUFFER *)countedRealloc(&ctx->printerCounts, NULL, sizeof(PRINT_BUFFER));
+	PRINT_STACK stack = { ctx, NULL, 0, 0 };
+	char buf[maxStringValueLength + 24];
+	int collectionThreshold = getNumLiveNodes(ctx) + streamingCollectionInterval;
+	BOOL isComplete = TRUE;
+
+	pb->fp = fp;
+	pb->len = 0;
+	pushPrintStack(&stack, expr, NULL, FALSE);
+
+	while (stack.size > 0) {
+
+		if (getNumLiveNodes(ctx) > collectionThreshold) {
+			collectStreamingGarbage(ctx, &stack, otherRoots);
+			collectionThreshold = getNumLiveNodes(ctx) + streamingCollectionInterval;
+		}
+
+		PRINT_STACK_ITEM item = stack.items[--stack.size];
+
+		if (item.expr == NULL) {
+			appendItemString(pb, &item);
+			continue;
+		}
+
+		expr = item.expr;
+
+		/* Print the lambdas of the head normal form, reducing as needed */
+
+		for (;;) {
+
+			if (hasHeadRedex(expr)) {
+				/* Let the output so far be seen while we work */
+				flushPrintBuffer(pb);
+				fflush(fp);
+				expr = reduceHeadCollecting(ctx, &stack, otherRoots, expr, &maxSteps, &collectionThreshold);
+			}
+
+			if (expr->type != lcExpressionType_LambdaExpr) {
+				break;
+			}
+
+			sprintf(buf, "λ%s.", expr->name);
+			appendToPrintBuffer(pb, buf);
+			expr = expr->expr;
+		}
+
+		if (hasHeadRedex(expr)) {
+			/* Out of steps */
+			appendToPrintBuffer(pb, "...");
+			isComplete = FALSE;
+			continue;
+		}
+
+		/* Then the head, and the arguments later; push in reverse order.
+		An Iteration is (f y), where y is the rest of its spine; the closing
+		parentheses of a spine of Iterations pile up in one item. */
+		LC_EXPR * head = expr;
+
+		for (; head->type == lcExpressionType_FunctionCall || head->type == lcExpressionType_Iteration; head = head->expr) {
+
+			pushClosingParenthesis(&stack);
+			pushPrintStack(&stack, (head->type == lcExpressionType_Iteration) ?
+				createIteration(ctx, head->expr, head->expr2, head->value - 1) : head->expr2, NULL, FALSE);
+			pushPrintStack(&stack, NULL, " ", FALSE);
+			appendToPrintBuffer(pb, "(");
+		}
+
+		if (head->type == lcExpressionType_IntegerLiteral) {
+			sprintf(buf, "%ld", head->value);
+			appendToPrintBuffer(pb, buf);
+		} else {
+			appendToPrintBuffer(pb, head->name);
+		}
+	}
+
+	flushPrintBuffer(pb);
+	freePrintStack(&stack);
+	countedFree(&ctx->printerCounts, pb);
+
+	return isComplete;
+}
+
+/* **** The End **** */
@@ -0,0 +1,9 @@
+/* facility/src/printer.h */
+
+void printPrinterMemMgrReport(LC_CONTEXT * ctx);
+void fprintExpr(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr);
+void printExpr(LC_CONTEXT * ctx, LC_EXPR * expr);
+void fprintExprWithSharing(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr);
+BOOL fprintNormalFormStreaming(LC_CONTEXT * ctx, FILE * fp, LC_EXPR * expr, LC_EXPR * otherRoots[], long maxSteps);
+
+/* **** The End **** */
@@ -0,0 +1,407 @@
+/* facility/src/repl.c */
+
+/* The read-evaluate-print loop. Each line of input is a term, which is
+ * reduced and printed, a definition, or a command:
+ *
+ *	let name = term	Reduce term once and remember its normal form as name
+ *	:strategy [name]	Show or set the reduction strategy
+ *	:time		The elapsed time of the last evaluation
+ *	:stats		The β-reductions, allocations and live nodes of the last evaluation
+ *	:stream term	Print the normal form of term while it is being computed
+ *	:defs		List the definitions
+ *	:help, :quit
+ *
+ * The definitions live in the heap of the REPL's context, and are the roots
+ * of the garbage collection after each input, so they are never reduced
+ * again: a term that uses one gets the stored normal form. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "beta-reduction.h"
+#include "create-and-destroy.h"
+#include "string-set.h"
+#include "eta-reduction.h"
+#include "parser.h"
+#include "printer.h"
+#include "repl.h"
+#include "telemetry.h"
+
+typedef struct {
+	char name[maxStringValueLength];
+	LC_EXPR * value; /* In normal form */
+} REPL_DEFINITION;
+
+typedef struct {
+	char * name;
+	BetaReductionStrategy strategy;
+} REPL_STRATEGY;
+
+typedef struct {
+	LC_CONTEXT * ctx;
+	REPL_DEFINITION * definitions;
+	int numDefinitions;
+	int capacity;
+	BetaReductionStrategy strategy;
+
+	/* The last evaluation */
+	BOOL hasEvaluated;
+	BetaReductionStrategy evaluationStrategy; /* Streaming is in normal order */
+	long nanoseconds;
+	long numBetaReductions;
+	int numAllocations;
+	int numLiveNodes; /* After the garbage collection that followed it */
+} REPL;
+
+/* const int replMaxDepth = 50; */
+#define replMaxDepth 50
+/* const long replMaxStreamingSteps = 10000000; */
+#define replMaxStreamingSteps 10000000L
+
+static REPL_STRATEGY strategies[] = {
+	{ "normal-order", brsNormalOrder },
+	{ "y-combinator-hack", brsThAWHackForYCombinator },
+	{ "interaction-net", brsInteractionNet },
+	{ "combinator", brsCombinator },
+	{ "explicit-substitution", brsExplicitSubstitution },
+	{ "g-machine", brsGMachine },
+	{ "normalization-by-evaluation", brsNormalizationByEvaluation }
+};
+
+/* const int numStrategies = sizeof(strategies) / sizeof(strategies[0]); */
+#define numStrategies ((int)(sizeof(strategies) / sizeof(strategies[0])))
+
+static char * getStrategyName(BetaReductionStrategy strategy) {
+	int i;
+
+	for (i = 0; i < numStrategies; ++i) {
+
+		if (strategies[i].strategy == strategy) {
+			return strategies[i].name;
+		}
+	}
+
+	return "unknown";
+}
+
+static char * trim(char * str) {
+	char * end;
+
+	str += strspn(str, " \t");
+	end = str + strlen(str);
+
+	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+		*--end = '\0';
+	}
+
+	return str;
+}
+
+/* **** Definitions **** */
+
+static REPL_DEFINITION * findDefinition(REPL * repl, char * name) {
+	int i;
+
+	for (i = 0; i < repl->numDefinitions; ++i) {
+
+		if (!strcmp(repl->definitions[i].name, name)) {
+			return &repl->definitions[i];
+		}
+	}
+
+	return NULL;
+}
+
+static LC_EXPR * bindDefinitions(REPL * repl, LC_EXPR * expr) {
+	/* Bind the definitions that expr uses in one β-redex
+	(((λa.λb.expr) a-value) b-value), so that β-reduction takes care of any
+	name capture. The values are outside all of the lambdas: a free variable
+	in a value was not defined when the value was, and stays free, even if
+	it has been defined since. Each value is in normal form already, so it
+	is not reduced again. */
+	LC_EXPR * result = expr;
+	int i;
+
+	for (i = repl->numDefinitions - 1; i >= 0; --i) {
+
+		if (containsUnboundVariableNamed(repl->ctx, expr, repl->definitions[i].name, NULL)) {
+			result = createLambdaExpr(repl->ctx, repl->definitions[i].name, result);
+		}
+	}
+
+	for (i = 0; i < repl->numDefinitions; ++i) {
+
+		if (containsUnboundVariableNamed(repl->ctx, expr, repl->definitions[i].name, NULL)) {
+			result = createFunctionCall(repl->ctx, result, repl->definitions[i].value);
+		}
+	}
+
+	return result;
+}
+
+static LC_EXPR ** getDefinitionRoots(REPL * repl) {
+	/* A NULL-terminated array of the definitions' values */
+	LC_EXPR ** roots = (LC_EXPR **)countedRealloc(&repl->ctx->mainCounts, NULL, (repl->numDefinitions + 1) * sizeof(LC_EXPR *));
+	int i;
+
+	for (i = 0; i < repl->numDefinitions; ++i) {
+		roots[i] = repl->definitions[i].value;
+	}
+
+	roots[i] = NULL;
+
+	return roots;
+}
+
+static void collectReplGarbage(REPL * repl) {
+	/* Keep only the definitions, and count what is left for :stats */
+	LC_EXPR ** roots = getDefinitionRoots(repl);
+
+	collectGarbage(repl->ctx, roots);
+	countedFree(&repl->ctx->mainCounts, roots);
+	repl->numLiveNodes = getNumMemMgrRecords(repl->ctx);
+}
+
+/* **** Evaluation **** */
+
+static LC_EXPR * evaluate(REPL * repl, char * str, BOOL isStreaming) {
+	/* Parse, bind and reduce str, and record the statistics. If isStreaming,
+	print the normal form as it is computed, and return NULL. */
+	LC_CONTEXT * ctx = repl->ctx;
+	LC_EXPR * expr = parse(ctx, str);
+
+	if (expr == NULL) {
+		return NULL;
+	}
+
+	expr = bindDefinitions(repl, expr);
+
+	const long numBetaReductions = ctx->numBetaReductions;
+	const int numMallocs = ctx->createAndDestroyCounts.numMallocs;
+	const long startTime = getTelemetryClock();
+	LC_EXPR * result = NULL;
+
+	if (isStreaming) {
+		LC_EXPR ** roots = getDefinitionRoots(repl);
+
+		if (!fprintNormalFormStreaming(ctx, stdout, expr, roots, replMaxStreamingSteps)) {
+			printf("\n(Stopped after %ld β-reductions)", replMaxStreamingSteps);
+		}
+
+		printf("\n");
+		countedFree(&ctx->mainCounts, roots);
+	} else {
+		result = betaReduce(ctx, expr, replMaxDepth, repl->strategy);
+	}
+
+	repl->nanoseconds = getTelemetryClock() - startTime;
+	repl->numBetaReductions = ctx->numBetaReductions - numBetaReductions;
+	repl->numAllocations = ctx->createAndDestroyCounts.numMallocs - numMallocs;
+	repl->hasEvaluated = TRUE;
+	repl->evaluationStrategy = isStreaming ? brsNormalOrder : repl->strategy;
+
+	return result;
+}
+
+static void define(REPL * repl, char * str) {
+	/* str is "name = term" */
+	char * equals = strchr(str, '=');
+
+	if (equals == NULL) {
+		printf("Usage: let name = term\n");
+		return;
+	}
+
+	*equals = '\0';
+
+	char * name = trim(str);
+
+	if (*name == '\0' || strlen(name) >= maxStringValueLength || strpbrk(name, " \t()\\.") != NULL) {
+		printf("'%s' is not a valid name\n", name);
+		return;
+	}
+
+	LC_EXPR * value = evaluate(repl, equals + 1, FALSE);
+
+	if (value == NULL) {
+		return;
+	}
+
+	REPL_DEFINITION * definition = findDefinition(repl, name);
+
+	if (definition == NULL) {
+
+		if (repl->numDefinitions == repl->capacity) {
+			repl->capacity = (repl->capacity == 0) ? 16 : 2 * repl->capacity;
+			repl->definitions = (REPL_DEFINITION *)countedRealloc(&repl->ctx->mainCounts, repl->definitions, repl->capacity * sizeof(REPL_DEFINITION));
+		}
+
+		definition = &repl->definitions[repl->numDefinitions++];
+		memset(definition->name, 0, maxStringValueLength);
+		strcpy(definition->name, name);
+	}
+
+	definition->value = value;
+	printf("%s = ", name);
+	fprintExpr(repl->ctx, stdout, value);
+	printf("\n");
+}
+
+/* **** Commands **** */
+
+static void printHelp() {
+	printf("  term                Reduce the term and print its normal form\n");
+	printf("  let name = term     Reduce the term and remember it as name\n");
+	printf("  :strategy [name]    Show or set the reduction strategy\n");
+	printf("  :time               The elapsed time of the last evaluation\n");
+	printf("  :stats              β-reductions, allocations and live nodes of the last evaluation\n");
+	printf("  :stream term        Print the normal form while it is being computed\n");
+	printf("  :defs               List the definitions\n");
+	printf("  :quit               Leave\n");
+}
+
+static void setStrategy(REPL * repl, char * name) {
+	int i;
+
+	if (*name == '\0') {
+		printf("Strategy: %s\nAvailable:", getStrategyName(repl->strategy));
+
+		for (i = 0; i < numStrategies; ++i) {
+			printf(" %s", strategies[i].name);
+		}
+
+		printf("\n");
+		return;
+	}
+
+	for (i = 0; i < numStrategies; ++i) {
+
+		if (!strcmp(strategies[i].name, name)) {
+			repl->strategy = strategies[i].strategy;
+			printf("Strategy: %s\n", name);
+			return;
+		}
+	}
+
+	printf("Unknown strategy '%s'; type :strategy for a list\n", name);
+}
+
+static BOOL runCommand(REPL * repl, char * command) {
+	/* Returns FALSE to leave the loop */
+	char * arg = command + strcspn(command, " \t");
+
+	if (*arg != '\0') {
+		*arg++ = '\0';
+		arg = trim(arg);
+	}
+
+	if (!strcmp(command, ":quit") || !strcmp(command, ":q")) {
+		return FALSE;
+	} else if (!strcmp(command, ":help")) {
+		printHelp();
+	} else if (!strcmp(command, ":strategy")) {
+		setStrategy(repl, arg);
+	} else if (!strcmp(command, ":stream")) {
+		/* Always in normal order */
+		evaluate(repl, arg, TRUE);
+		collectReplGarbage(repl);
+	} else if (!strcmp(command, ":defs")) {
+		int i;
+
+		for (i = 0; i < repl->numDefinitions; ++i) {
+			printf("%s = ", repl->definitions[i].name);
+			fprintExpr(repl->ctx, stdout, repl->definitions[i].value);
+			printf("\n");
+		}
+	} else if (!repl->hasEvaluated && (!strcmp(command, ":time") || !strcmp(command, ":stats"))) {
+		printf("Nothing has been evaluated yet\n");
+	} else if (!strcmp(command, ":time")) {
+		printf("Elapsed: %.3f ms (%s)\n", repl->nanoseconds / 1e6, getStrategyName(repl->evaluationStrategy));
+	} else if (!strcmp(command, ":stats")) {
+		printf("β-reductions: %ld\n", repl->numBetaReductions);
+		printf("Nodes allocated: %d\n", repl->numAllocations);
+		printf("Live nodes after GC: %d (%d definitions)\n", repl->numLiveNodes, repl->numDefinitions);
+		printf("Peak live nodes (this session): %d\n", repl->ctx->peakLiveNodes);
+	} else {
+		printf("Unknown command '%s'; type :help for a list\n", command);
+	}
+
+	return TRUE;
+}
+
+/* **** The loop **** */
+
+void readEvalPrintLoop(BOOL enableDeltaReduction, int numGcThreads) {
+	const BOOL isInteractive = isatty(STDIN_FILENO);
+	REPL repl;
+	char * line = NULL;
+	size_t lineCapacity = 0;
+
+	memset(&repl, 0, sizeof(REPL));
+	repl.ctx = createContext();
+	repl.ctx->enableDeltaReduction = enableDeltaReduction;
+	repl.ctx->numGcThreads = numGcThreads;
+	repl.strategy = brsDefault;
+
+	if (isInteractive) {
+		printf("facility: type :help for help\n");
+	}
+
+	for (;;) {
+
+		if (isInteractive) {
+			printf("λ> ");
+		}
+
+		fflush(stdout);
+
+		if (getline(&line, &lineCapacity, stdin) < 0) {
+			break;
+		}
+
+		char * input = trim(line);
+		LC_EXPR * result = NULL;
+
+		if (*input == '\0') {
+			continue;
+		} else if (*input == ':') {
+
+			if (!runCommand(&repl, input)) {
+				break;
+			}
+
+			continue;
+		} else if (!strncmp(input, "let ", 4)) {
+			define(&repl, input + 4);
+		} else {
+			result = evaluate(&repl, input, FALSE);
+
+			if (result != NULL) {
+				fprintExpr(repl.ctx, stdout, result);
+				printf("\n");
+			}
+		}
+
+		collectReplGarbage(&repl);
+	}
+
+	if (isInteractive) {
+		printf("\n");
+	}
+
+	free(line);
+
+	countedFree(&repl.ctx->mainCounts, repl.definitions);
+
+	freeContext(repl.ctx);
+}
+
+/* **** The End **** */
@@ -0,0 +1,5 @@
+/* facility/src/repl.h */
+
+void readEvalPrintLoop(BOOL enableDeltaReduction, int numGcThreads);
+
+/* **** The End **** */
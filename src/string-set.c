@@ -5,19 +5,15 @@
 #include <string.h>
 
 #include "boolean.h"
-#include "string-set.h"
-
-static int numMallocs = 0;
-static int numFrees = 0;
 
-void printStringSetMemMgrReport() {
-	printf("  String sets: %d mallocs, %d frees", numMallocs, numFrees);
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
 
-	if (numMallocs > numFrees) {
-		printf(" : **** LEAKAGE ****");
-	}
+#include "string-set.h"
 
-	printf("\n");
+void printStringSetMemMgrReport(LC_CONTEXT * ctx) {
+	printMemMgrCounts("String sets", &ctx->stringSetCounts);
 }
 
 BOOL stringSetContains(STRING_SET * set, char * str) {
@@ -32,7 +28,7 @@ BOOL stringSetContains(STRING_SET * set, char * str) {
 	return FALSE;
 }
 
-STRING_SET * addStringToSet(char * str, STRING_SET * set) {
+STRING_SET * addStringToSet(LC_CONTEXT * ctx, char * str, STRING_SET * set) {
 
 	if (stringSetContains(set, str)) {
 		/** return NULL; */
@@ -41,39 +37,39 @@ STRING_SET * addStringToSet(char * str, STRING_SET * set) {
 
 	STRING_SET * newSet = (STRING_SET * )malloc(sizeof(STRING_SET));
 
-	++numMallocs;
+	++ctx->stringSetCounts.numMallocs;
 	newSet->str = str;
 	newSet->next = set;
 
 	return newSet;
 }
 
-STRING_SET * unionOfStringSets(STRING_SET * set1, STRING_SET * set2, BOOL destroySet2) {
+STRING_SET * unionOfStringSets(LC_CONTEXT * ctx, STRING_SET * set1, STRING_SET * set2, BOOL destroySet2) {
 	/* This function can modify set1. */
 	STRING_SET * ss;
 
 	for (ss = set2; ss != NULL; ss = ss->next) {
 
 		if (!stringSetContains(set1, ss->str)) {
-			set1 = addStringToSet(ss->str, set1);
+			set1 = addStringToSet(ctx, ss->str, set1);
 		}
 	}
 
 	if (destroySet2) {
-		freeStringSet(set2);
+		freeStringSet(ctx, set2);
 	}
 
 	return set1;
 }
 
-void freeStringSet(STRING_SET * set) {
+void freeStringSet(LC_CONTEXT * ctx, STRING_SET * set) {
 
 	while (set != NULL) {
 		STRING_SET * next = set->next;
 
 		set->str = NULL;
 		free(set);
-		++numFrees;
+		++ctx->stringSetCounts.numFrees;
 		set = next;
 	}
 }
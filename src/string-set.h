@@ -6,10 +6,10 @@ typedef struct STRING_SET_STRUCT {
 } STRING_SET;
 
 BOOL stringSetContains(STRING_SET * set, char * str);
-STRING_SET * addStringToSet(char * str, STRING_SET * set);
-STRING_SET * unionOfStringSets(STRING_SET * set1, STRING_SET * set2, BOOL destroySet2);
-void freeStringSet(STRING_SET * set);
+STRING_SET * addStringToSet(LC_CONTEXT * ctx, char * str, STRING_SET * set);
+STRING_SET * unionOfStringSets(LC_CONTEXT * ctx, STRING_SET * set1, STRING_SET * set2, BOOL destroySet2);
+void freeStringSet(LC_CONTEXT * ctx, STRING_SET * set);
 
-void printStringSetMemMgrReport();
+void printStringSetMemMgrReport(LC_CONTEXT * ctx);
 
 /* **** The End **** */
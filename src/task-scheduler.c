@@ -0,0 +1,246 @@
+/* facility/src/task-scheduler.c */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "task-scheduler.h"
+
+#define taskDequeCapacity 4096
+
+enum {
+	taskState_Pending,
+	taskState_Running,
+	taskState_Done
+};
+
+struct TASK_DEQUE_STRUCT {
+	pthread_mutex_t mutex;
+	TASK * tasks[taskDequeCapacity];
+	int top; /* Thieves take from the top (the oldest task) */
+	int bottom; /* The owner pushes and pops at the bottom */
+};
+
+static BOOL pushBottom(TASK_DEQUE * deque, TASK * task) {
+	BOOL result = FALSE;
+
+	pthread_mutex_lock(&deque->mutex);
+
+	if (deque->bottom - deque->top < taskDequeCapacity) {
+		deque->tasks[deque->bottom++ % taskDequeCapacity] = task;
+		result = TRUE;
+	}
+
+	pthread_mutex_unlock(&deque->mutex);
+
+	return result;
+}
+
+static TASK * popBottom(TASK_DEQUE * deque) {
+	TASK * task = NULL;
+
+	pthread_mutex_lock(&deque->mutex);
+
+	if (deque->bottom > deque->top) {
+		task = deque->tasks[--deque->bottom % taskDequeCapacity];
+	}
+
+	pthread_mutex_unlock(&deque->mutex);
+
+	return task;
+}
+
+static TASK * popTop(TASK_DEQUE * deque) {
+	TASK * task = NULL;
+
+	pthread_mutex_lock(&deque->mutex);
+
+	if (deque->bottom > deque->top) {
+		task = deque->tasks[deque->top++ % taskDequeCapacity];
+
+		if (deque->top == deque->bottom) {
+			deque->top = deque->bottom = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&deque->mutex);
+
+	return task;
+}
+
+static TASK * findTask(TASK_SCHEDULER * scheduler, int workerIndex) {
+	/* First look in our own deque, then try to steal from the others */
+	const int numDeques = scheduler->numWorkers + 1;
+	TASK * task = popBottom(&scheduler->deques[workerIndex]);
+	int i;
+
+	for (i = 1; task == NULL && i < numDeques; ++i) {
+		task = popTop(&scheduler->deques[(workerIndex + i) % numDeques]);
+	}
+
+	if (task != NULL) {
+		__atomic_sub_fetch(&scheduler->numPendingTasks, 1, __ATOMIC_SEQ_CST);
+	}
+
+	return task;
+}
+
+static void runTask(TASK * task, int workerIndex) {
+	__atomic_store_n(&task->state, taskState_Running, __ATOMIC_RELAXED);
+	task->run(task, workerIndex);
+	__atomic_store_n(&task->state, taskState_Done, __ATOMIC_RELEASE);
+}
+
+struct WORKER_ARGS_STRUCT {
+	TASK_SCHEDULER * scheduler;
+	int workerIndex;
+};
+
+static void * workerLoop(void * arg) {
+	WORKER_ARGS * args = (WORKER_ARGS *)arg;
+	TASK_SCHEDULER * scheduler = args->scheduler;
+	const int workerIndex = args->workerIndex;
+
+	for (;;) {
+		TASK * task = findTask(scheduler, workerIndex);
+
+		if (task != NULL) {
+			runTask(task, workerIndex);
+			continue;
+		}
+
+		/* Sleep until a task is spawned. numIdleWorkers and numPendingTasks
+		are sequentially consistent, so either the spawner sees us as idle
+		and signals, or we see its task before we wait. */
+		pthread_mutex_lock(&scheduler->idleMutex);
+		__atomic_add_fetch(&scheduler->numIdleWorkers, 1, __ATOMIC_SEQ_CST);
+
+		while (!scheduler->shutdown && __atomic_load_n(&scheduler->numPendingTasks, __ATOMIC_SEQ_CST) == 0) {
+			pthread_cond_wait(&scheduler->workAvailable, &scheduler->idleMutex);
+		}
+
+		__atomic_sub_fetch(&scheduler->numIdleWorkers, 1, __ATOMIC_SEQ_CST);
+
+		const BOOL shutdown = scheduler->shutdown;
+
+		pthread_mutex_unlock(&scheduler->idleMutex);
+
+		if (shutdown) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+TASK_SCHEDULER * createTaskScheduler(int numWorkers, MEMMGR_COUNTS * counts) {
+	/* The scheduler's allocations are added to counts, which may be NULL */
+	TASK_SCHEDULER * scheduler = (TASK_SCHEDULER *)countedRealloc(counts, NULL, sizeof(TASK_SCHEDULER));
+	int i;
+
+	if (numWorkers < 1) {
+		numWorkers = 1;
+	}
+
+	scheduler->numWorkers = numWorkers;
+	scheduler->numPendingTasks = 0;
+	scheduler->numIdleWorkers = 0;
+	scheduler->shutdown = FALSE;
+	scheduler->counts = counts;
+	pthread_mutex_init(&scheduler->idleMutex, NULL);
+	pthread_cond_init(&scheduler->workAvailable, NULL);
+	scheduler->deques = (TASK_DEQUE *)countedRealloc(counts, NULL, (numWorkers + 1) * sizeof(TASK_DEQUE));
+
+	for (i = 0; i <= numWorkers; ++i) {
+		pthread_mutex_init(&scheduler->deques[i].mutex, NULL);
+		scheduler->deques[i].top = 0;
+		scheduler->deques[i].bottom = 0;
+	}
+
+	scheduler->threads = (pthread_t *)countedRealloc(counts, NULL, numWorkers * sizeof(pthread_t));
+	scheduler->workerArgs = (WORKER_ARGS *)countedRealloc(counts, NULL, numWorkers * sizeof(WORKER_ARGS));
+
+	for (i = 0; i < numWorkers; ++i) {
+		WORKER_ARGS * args = &scheduler->workerArgs[i];
+
+		args->scheduler = scheduler;
+		args->workerIndex = i;
+		pthread_create(&scheduler->threads[i], NULL, workerLoop, args);
+	}
+
+	return scheduler;
+}
+
+void freeTaskScheduler(TASK_SCHEDULER * scheduler) {
+	int i;
+
+	pthread_mutex_lock(&scheduler->idleMutex);
+	scheduler->shutdown = TRUE;
+	pthread_cond_broadcast(&scheduler->workAvailable);
+	pthread_mutex_unlock(&scheduler->idleMutex);
+
+	for (i = 0; i < scheduler->numWorkers; ++i) {
+		pthread_join(scheduler->threads[i], NULL);
+	}
+
+	for (i = 0; i <= scheduler->numWorkers; ++i) {
+		pthread_mutex_destroy(&scheduler->deques[i].mutex);
+	}
+
+	pthread_cond_destroy(&scheduler->workAvailable);
+	pthread_mutex_destroy(&scheduler->idleMutex);
+	countedFree(scheduler->counts, scheduler->workerArgs);
+	countedFree(scheduler->counts, scheduler->threads);
+	countedFree(scheduler->counts, scheduler->deques);
+	countedFree(scheduler->counts, scheduler);
+}
+
+int getExternalWorkerIndex(TASK_SCHEDULER * scheduler) {
+	/* Threads outside the pool share the last deque */
+	return scheduler->numWorkers;
+}
+
+BOOL spawnTask(TASK_SCHEDULER * scheduler, int workerIndex, TASK * task) {
+	/* Returns FALSE if the deque is full; the caller should then run the
+	task's work itself. */
+	task->state = taskState_Pending;
+
+	if (!pushBottom(&scheduler->deques[workerIndex], task)) {
+		return FALSE;
+	}
+
+	__atomic_add_fetch(&scheduler->numPendingTasks, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&scheduler->numIdleWorkers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&scheduler->idleMutex);
+		pthread_cond_signal(&scheduler->workAvailable);
+		pthread_mutex_unlock(&scheduler->idleMutex);
+	}
+
+	return TRUE;
+}
+
+void joinTask(TASK_SCHEDULER * scheduler, int workerIndex, TASK * task) {
+	/* Run tasks (normally starting with this one, from the bottom of our own
+	deque) until this task is done. */
+
+	while (__atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != taskState_Done) {
+		TASK * other = findTask(scheduler, workerIndex);
+
+		if (other != NULL) {
+			runTask(other, workerIndex);
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+/* **** The End **** */
@@ -0,0 +1,37 @@
+/* facility/src/task-scheduler.h */
+
+/* A fork-join scheduler with one work-stealing deque per worker thread.
+ * A task is spawned onto the deque of the thread that spawns it and is
+ * normally run by that same thread when it joins the task; idle workers steal
+ * the oldest tasks from the other ends of the deques. Threads that do not
+ * belong to the pool (e.g. the main thread) share one extra deque. */
+
+typedef struct TASK_STRUCT {
+	void (*run)(struct TASK_STRUCT * task, int workerIndex);
+	int state; /* See taskState_* in task-scheduler.c */
+} TASK;
+
+typedef struct TASK_DEQUE_STRUCT TASK_DEQUE;
+typedef struct WORKER_ARGS_STRUCT WORKER_ARGS;
+
+typedef struct TASK_SCHEDULER_STRUCT {
+	int numWorkers;
+	pthread_t * threads;
+	WORKER_ARGS * workerArgs;
+	TASK_DEQUE * deques; /* numWorkers + 1: the last is for external threads */
+	int numPendingTasks;
+	int numIdleWorkers;
+	BOOL shutdown;
+	pthread_mutex_t idleMutex;
+	pthread_cond_t workAvailable;
+	MEMMGR_COUNTS * counts; /* May be NULL */
+} TASK_SCHEDULER;
+
+TASK_SCHEDULER * createTaskScheduler(int numWorkers, MEMMGR_COUNTS * counts);
+void freeTaskScheduler(TASK_SCHEDULER * scheduler);
+
+int getExternalWorkerIndex(TASK_SCHEDULER * scheduler);
+BOOL spawnTask(TASK_SCHEDULER * scheduler, int workerIndex, TASK * task);
+void joinTask(TASK_SCHEDULER * scheduler, int workerIndex, TASK * task);
+
+/* **** The End **** */
@@ -0,0 +1,229 @@
+/* facility/src/telemetry.c */
+
+/* Memory telemetry: the registry of the allocation counters of the
+ * subsystems, the peak number of live LC_EXPR nodes, and the number and
+ * duration of garbage collections, split into the mark and sweep phases.
+ * printMemoryTelemetryReport() prints it all as text, and
+ * writeMemoryTelemetryJson() as a JSON object, for monitoring. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "string-set.h"
+#include "telemetry.h"
+
+typedef struct {
+	char * name; /* For JSON */
+	char * description; /* For the text report */
+	size_t countsOffset; /* Of the subsystem's MEMMGR_COUNTS in LC_CONTEXT */
+	size_t allocationSize; /* In bytes, if all allocations are the same size; otherwise 0, and the bytes are counted by countedRealloc() */
+} TELEMETRY_SUBSYSTEM;
+
+static TELEMETRY_SUBSYSTEM subsystems[] = {
+	{ "main", "Main", offsetof(LC_CONTEXT, mainCounts), 0 },
+	{ "memoryManager", "Memory manager itself", offsetof(LC_CONTEXT, memMgrCounts), sizeof(MEMMGR_RECORD) },
+	{ "garbageCollector", "Garbage collector", offsetof(LC_CONTEXT, gcCounts), 0 },
+	{ "createAndDestroy", "Create and destroy", offsetof(LC_CONTEXT, createAndDestroyCounts), sizeof(LC_EXPR) },
+	{ "charSources", "Char sources", offsetof(LC_CONTEXT, charSourceCounts), 0 },
+	{ "stringSets", "String sets", offsetof(LC_CONTEXT, stringSetCounts), sizeof(STRING_SET) },
+	/* A STRING_LIST (de-bruijn.c) has the same layout as a STRING_SET */
+	{ "stringLists", "String lists (de-bruijn.c)", offsetof(LC_CONTEXT, stringListCounts), sizeof(STRING_SET) },
+	{ "interactionNets", "Interaction nets", offsetof(LC_CONTEXT, interactionNetCounts), 0 },
+	{ "combinators", "Combinators", offsetof(LC_CONTEXT, combinatorCounts), 0 },
+	{ "explicitSubstitutions", "Explicit substitutions", offsetof(LC_CONTEXT, explicitSubstitutionCounts), 0 },
+	{ "gMachine", "G-machine", offsetof(LC_CONTEXT, gMachineCounts), 0 },
+	{ "normalizationByEvaluation", "Normalization by evaluation", offsetof(LC_CONTEXT, nbeCounts), 0 },
+	{ "printer", "Printer", offsetof(LC_CONTEXT, printerCounts), 0 },
+	{ "compactExpressions", "Compact expressions", offsetof(LC_CONTEXT, compactExprCounts), 0 },
+	{ "flatExpressions", "Flat expressions", offsetof(LC_CONTEXT, flatExprCounts), 0 },
+	{ "compiler", "Compiler", offsetof(LC_CONTEXT, compilerCounts), 0 },
+	{ "trace", "Trace", offsetof(LC_CONTEXT, traceCounts), 0 },
+	{ "taskScheduler", "Task scheduler", offsetof(LC_CONTEXT, taskSchedulerCounts), 0 }
+};
+
+/* const int numSubsystems = sizeof(subsystems) / sizeof(subsystems[0]); */
+#define numSubsystems ((int)(sizeof(subsystems) / sizeof(subsystems[0])))
+
+static MEMMGR_COUNTS * getSubsystemCounts(LC_CONTEXT * ctx, int i) {
+	return (MEMMGR_COUNTS *)((char *)ctx + subsystems[i].countsOffset);
+}
+
+static long getSubsystemBytesAllocated(LC_CONTEXT * ctx, int i) {
+	MEMMGR_COUNTS * counts = getSubsystemCounts(ctx, i);
+
+	if (subsystems[i].allocationSize > 0) {
+		return counts->numMallocs * (long)subsystems[i].allocationSize;
+	}
+
+	return counts->numBytesAllocated;
+}
+
+static long getSubsystemLiveBytes(LC_CONTEXT * ctx, int i) {
+	MEMMGR_COUNTS * counts = getSubsystemCounts(ctx, i);
+
+	if (subsystems[i].allocationSize > 0) {
+		return (counts->numMallocs - counts->numFrees) * (long)subsystems[i].allocationSize;
+	}
+
+	return counts->numBytesAllocated - counts->numBytesFreed;
+}
+
+static int getNumLiveNodes(LC_CONTEXT * ctx) {
+	return ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees;
+}
+
+/* **** Recording **** */
+
+long getTelemetryClock() {
+	/* In nanoseconds */
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int getPauseHistogramBucket(long nanoseconds) {
+	long microseconds = nanoseconds / 1000;
+	int i = 0;
+
+	for (; microseconds > 0 && i < numPauseHistogramBuckets - 1; microseconds >>= 1) {
+		++i;
+	}
+
+	return i;
+}
+
+void recordCollection(LC_CONTEXT * ctx, long markNanoseconds, long sweepNanoseconds) {
+	GC_TELEMETRY * gc = &ctx->gcTelemetry;
+
+	++gc->numCollections;
+	gc->markNanoseconds += markNanoseconds;
+	gc->sweepNanoseconds += sweepNanoseconds;
+
+	if (markNanoseconds > gc->maxMarkNanoseconds) {
+		gc->maxMarkNanoseconds = markNanoseconds;
+	}
+
+	if (sweepNanoseconds > gc->maxSweepNanoseconds) {
+		gc->maxSweepNanoseconds = sweepNanoseconds;
+	}
+
+	++gc->markPauseHistogram[getPauseHistogramBucket(markNanoseconds)];
+	++gc->sweepPauseHistogram[getPauseHistogramBucket(sweepNanoseconds)];
+}
+
+void mergeMemoryTelemetry(LC_CONTEXT * parent, LC_CONTEXT * child) {
+	/* The child ran at the same time as its parent, and as its siblings
+	(the other tasks of a fork, or the other workers of a batch), so its peak
+	may coincide with theirs: the sum of the peaks is an upper bound on the
+	peak of them all together */
+	GC_TELEMETRY * gc = &parent->gcTelemetry;
+	int i;
+
+	parent->peakLiveNodes += child->peakLiveNodes;
+
+	for (i = 0; i < numSubsystems; ++i) {
+		MEMMGR_COUNTS * dst = getSubsystemCounts(parent, i);
+		MEMMGR_COUNTS * src = getSubsystemCounts(child, i);
+
+		dst->numMallocs += src->numMallocs;
+		dst->numFrees += src->numFrees;
+		dst->numBytesAllocated += src->numBytesAllocated;
+		dst->numBytesFreed += src->numBytesFreed;
+	}
+
+	gc->numCollections += child->gcTelemetry.numCollections;
+	gc->markNanoseconds += child->gcTelemetry.markNanoseconds;
+	gc->sweepNanoseconds += child->gcTelemetry.sweepNanoseconds;
+
+	if (child->gcTelemetry.maxMarkNanoseconds > gc->maxMarkNanoseconds) {
+		gc->maxMarkNanoseconds = child->gcTelemetry.maxMarkNanoseconds;
+	}
+
+	if (child->gcTelemetry.maxSweepNanoseconds > gc->maxSweepNanoseconds) {
+		gc->maxSweepNanoseconds = child->gcTelemetry.maxSweepNanoseconds;
+	}
+
+	for (i = 0; i < numPauseHistogramBuckets; ++i) {
+		gc->markPauseHistogram[i] += child->gcTelemetry.markPauseHistogram[i];
+		gc->sweepPauseHistogram[i] += child->gcTelemetry.sweepPauseHistogram[i];
+	}
+}
+
+/* **** Reporting **** */
+
+void printMemoryTelemetryReport(LC_CONTEXT * ctx) {
+	GC_TELEMETRY * gc = &ctx->gcTelemetry;
+	int i;
+
+	for (i = 0; i < numSubsystems; ++i) {
+		printMemMgrCounts(subsystems[i].description, getSubsystemCounts(ctx, i));
+	}
+
+	printf("  Peak live nodes: %d\n", ctx->peakLiveNodes);
+	printf("  Garbage collections: %d\n", gc->numCollections);
+}
+
+static void writeJsonHistogram(FILE * fp, char * name, int * histogram) {
+	int i;
+
+	fprintf(fp, "\t\t\"%s\": [", name);
+
+	for (i = 0; i < numPauseHistogramBuckets; ++i) {
+		fprintf(fp, (i > 0) ? ", %d" : "%d", histogram[i]);
+	}
+
+	fprintf(fp, "]");
+}
+
+void writeMemoryTelemetryJson(LC_CONTEXT * ctx, FILE * fp) {
+	GC_TELEMETRY * gc = &ctx->gcTelemetry;
+	int i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"peakLiveNodes\": %d,\n", ctx->peakLiveNodes);
+	fprintf(fp, "\t\"peakLiveNodeBytes\": %lu,\n", ctx->peakLiveNodes * (sizeof(LC_EXPR) + sizeof(MEMMGR_RECORD)));
+	fprintf(fp, "\t\"liveNodes\": %d,\n", getNumLiveNodes(ctx));
+	fprintf(fp, "\t\"garbageCollections\": {\n");
+	fprintf(fp, "\t\t\"count\": %d,\n", gc->numCollections);
+	fprintf(fp, "\t\t\"markNanoseconds\": %ld,\n", gc->markNanoseconds);
+	fprintf(fp, "\t\t\"sweepNanoseconds\": %ld,\n", gc->sweepNanoseconds);
+	fprintf(fp, "\t\t\"maxMarkNanoseconds\": %ld,\n", gc->maxMarkNanoseconds);
+	fprintf(fp, "\t\t\"maxSweepNanoseconds\": %ld,\n", gc->maxSweepNanoseconds);
+	fprintf(fp, "\t\t\"pauseHistogramBucketLimitsMicroseconds\": [");
+
+	for (i = 0; i < numPauseHistogramBuckets - 1; ++i) {
+		fprintf(fp, (i > 0) ? ", %ld" : "%ld", 1L << i);
+	}
+
+	fprintf(fp, ", null],\n");
+	writeJsonHistogram(fp, "markPauseHistogram", gc->markPauseHistogram);
+	fprintf(fp, ",\n");
+	writeJsonHistogram(fp, "sweepPauseHistogram", gc->sweepPauseHistogram);
+	fprintf(fp, "\n\t},\n");
+	fprintf(fp, "\t\"subsystems\": {\n");
+
+	for (i = 0; i < numSubsystems; ++i) {
+		MEMMGR_COUNTS * counts = getSubsystemCounts(ctx, i);
+
+		fprintf(fp, "\t\t\"%s\": { \"mallocs\": %d, \"frees\": %d, \"bytesAllocated\": %ld, \"liveBytes\": %ld",
+			subsystems[i].name, counts->numMallocs, counts->numFrees,
+			getSubsystemBytesAllocated(ctx, i), getSubsystemLiveBytes(ctx, i));
+		fprintf(fp, (i < numSubsystems - 1) ? " },\n" : " }\n");
+	}
+
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+}
+
+/* **** The End **** */
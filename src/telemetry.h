@@ -0,0 +1,10 @@
+/* facility/src/telemetry.h */
+
+long getTelemetryClock();
+void recordCollection(LC_CONTEXT * ctx, long markNanoseconds, long sweepNanoseconds);
+void mergeMemoryTelemetry(LC_CONTEXT * parent, LC_CONTEXT * child);
+
+void printMemoryTelemetryReport(LC_CONTEXT * ctx);
+void writeMemoryTelemetryJson(LC_CONTEXT * ctx, FILE * fp);
+
+/* **** The End **** */
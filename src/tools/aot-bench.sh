@@ -0,0 +1,48 @@
+#!/bin/sh
+# facility/src/tools/aot-bench.sh
+
+# Compare the betaReduce interpreter (facility -b) with ahead-of-time
+# compilation (facility -c; see compiler.c) on Church-numeral workloads.
+# The compiled program is built once; the time to run it is what counts.
+#
+# To run: $ make bench-aot
+
+set -e
+
+CC=${CC:-gcc}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# 3 ^ 3; the parity of 2 ^ 5; 2 * 3 * 4 via composition; 3 factorial via the Y combinator
+cat > "$DIR/workloads.txt" <<'WORKLOADS'
+(((\m.\n.(n m) \f.\x.(f (f (f x)))) \f.\x.(f (f (f x)))) g)
+((((\m.\n.(n m) \f.\x.(f (f x))) \f.\x.(f (f (f (f (f x)))))) \b.\x.\y.((b y) x)) \x.\y.x)
+(((\m.\n.\f.(m (n f)) \f.\x.(f (f x))) ((\m.\n.\f.(m (n f)) \f.\x.(f (f (f x)))) \f.\x.(f (f (f (f x)))))) g)
+((\a.(\b.(a (b b)) \b.(a (b b))) \r.\n.(((\b.\x.\y.((b x) y) (\n.((n \z.\x.\y.y) \x.\y.x) n)) \f.\x.(f x)) ((\m.\n.\f.(m (n f)) n) (r (\n.\f.\x.(((n \g.\h.(h (g f))) \u.x) \u.u) n))))) \f.\x.(f (f (f x))))
+WORKLOADS
+
+now() {
+	date +%s%N
+}
+
+i=0
+
+while read -r line; do
+	i=$((i + 1))
+	printf "%s\n" "$line" > "$DIR/line.txt"
+
+	start=$(now)
+	./facility -b "$DIR/line.txt" > "$DIR/interpreted.txt" 2> /dev/null
+	interpreted=$(( ($(now) - start) / 1000 ))
+
+	./facility -c "$DIR/line.c" "$DIR/line.txt"
+	$CC -O2 -o "$DIR/line" "$DIR/line.c"
+
+	start=$(now)
+	"$DIR/line" > "$DIR/compiled.txt"
+	compiled=$(( ($(now) - start) / 1000 ))
+
+	echo "Workload $i: interpreted $interpreted µs, compiled $compiled µs"
+	echo "  Interpreted: $(cut -c1-72 "$DIR/interpreted.txt")"
+	echo "  Compiled:    $(cut -c1-72 "$DIR/compiled.txt")"
+done < "$DIR/workloads.txt"
@@ -0,0 +1,302 @@
+/* facility/src/tools/trace-summary.c */
+
+/* Summarize a reduction trace recorded by facility -r (see trace.c):
+ * the number of events of each type, the lambdas that were applied most
+ * often, and a histogram of the events over the course of the reduction.
+ *
+ * To build: $ make tools/trace-summary
+ * To run: $ tools/trace-summary trace.bin [number-of-lambdas] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../boolean.h"
+
+#include "../types.h"
+#include "../memory-manager.h"
+#include "../context.h"
+
+#include "../trace.h"
+
+/* const int numHistogramBuckets = 20; */
+#define numHistogramBuckets 20
+/* const int histogramBarWidth = 40; */
+#define histogramBarWidth 40
+
+typedef struct {
+	unsigned int redexId; /* Or a hash of the name; 0 if the slot is empty */
+	char name[maxStringValueLength];
+	unsigned int numBetaReductions;
+} LAMBDA_COUNT;
+
+typedef struct {
+	LAMBDA_COUNT * entries;
+	unsigned int capacity; /* A power of 2 */
+	unsigned int size;
+} LAMBDA_COUNT_TABLE;
+
+typedef struct {
+	unsigned int numEvents[teNumEventTypes];
+	unsigned int maxLiveNodes;
+} HISTOGRAM_BUCKET;
+
+static char * eventTypeNames[] = { "β", "η", "α", "δ" };
+
+static LAMBDA_COUNT * findLambdaCount(LAMBDA_COUNT_TABLE * table, unsigned int redexId) {
+	unsigned int i = (redexId * 2654435761U) & (table->capacity - 1);
+
+	while (table->entries[i].redexId != 0 && table->entries[i].redexId != redexId) {
+		i = (i + 1) & (table->capacity - 1);
+	}
+
+	return &table->entries[i];
+}
+
+static unsigned int hashName(char * name) {
+	/* FNV-1a; never 0 */
+	unsigned int h = 2166136261U;
+	int i;
+
+	for (i = 0; i < maxStringValueLength && name[i] != '\0'; ++i) {
+		h = (h ^ (unsigned char)name[i]) * 16777619U;
+	}
+
+	return (h == 0) ? 1 : h;
+}
+
+static void countBetaReduction(LAMBDA_COUNT_TABLE * table, unsigned int key, TRACE_RECORD * record) {
+	unsigned int i;
+
+	if (2 * (table->size + 1) > table->capacity) {
+		LAMBDA_COUNT * oldEntries = table->entries;
+		const unsigned int oldCapacity = table->capacity;
+
+		table->capacity = (oldCapacity == 0) ? 1024 : 2 * oldCapacity;
+		table->entries = (LAMBDA_COUNT *)calloc(table->capacity, sizeof(LAMBDA_COUNT));
+
+		for (i = 0; i < oldCapacity; ++i) {
+
+			if (oldEntries[i].redexId != 0) {
+				*findLambdaCount(table, oldEntries[i].redexId) = oldEntries[i];
+			}
+		}
+
+		free(oldEntries);
+	}
+
+	LAMBDA_COUNT * entry = findLambdaCount(table, key);
+
+	if (entry->redexId == 0) {
+		entry->redexId = key;
+		memcpy(entry->name, record->name, maxStringValueLength);
+		entry->name[maxStringValueLength - 1] = '\0';
+		++table->size;
+	}
+
+	++entry->numBetaReductions;
+}
+
+static int compareLambdaCounts(const void * p1, const void * p2) {
+	/* The most often applied first */
+	const LAMBDA_COUNT * lc1 = (const LAMBDA_COUNT *)p1;
+	const LAMBDA_COUNT * lc2 = (const LAMBDA_COUNT *)p2;
+
+	if (lc1->numBetaReductions != lc2->numBetaReductions) {
+		return (lc1->numBetaReductions > lc2->numBetaReductions) ? -1 : 1;
+	}
+
+	return (lc1->redexId < lc2->redexId) ? -1 : (lc1->redexId > lc2->redexId);
+}
+
+static void printHottestLambdas(LAMBDA_COUNT_TABLE * table, unsigned int numLambdasToShow, char * title, BOOL showIds) {
+	LAMBDA_COUNT * lambdaCounts = (LAMBDA_COUNT *)malloc((table->size + 1) * sizeof(LAMBDA_COUNT));
+	unsigned int n = 0;
+	unsigned int i;
+
+	for (i = 0; i < table->capacity; ++i) {
+
+		if (table->entries[i].redexId != 0) {
+			lambdaCounts[n++] = table->entries[i];
+		}
+	}
+
+	qsort(lambdaCounts, n, sizeof(LAMBDA_COUNT), compareLambdaCounts);
+	printf("\nThe most often applied of %u %s:\n", n, title);
+
+	for (i = 0; i < n && i < numLambdasToShow; ++i) {
+
+		if (showIds) {
+			printf("  %08x ", lambdaCounts[i].redexId);
+		} else {
+			printf("  ");
+		}
+
+		printf("λ%-7s %u\n", lambdaCounts[i].name, lambdaCounts[i].numBetaReductions);
+	}
+
+	free(lambdaCounts);
+}
+
+static TRACE_RECORD * readTraceFile(char * filename, unsigned int * numRecords) {
+	FILE * fp = fopen(filename, "rb");
+	TRACE_HEADER header;
+
+	if (fp == NULL) {
+		fprintf(stderr, "readTraceFile() : Cannot open '%s'\n", filename);
+		return NULL;
+	}
+
+	if (fread(&header, sizeof(TRACE_HEADER), 1, fp) != 1 ||
+		memcmp(header.magic, traceFileMagic, sizeof(header.magic)) ||
+		header.recordSize != sizeof(TRACE_RECORD)) {
+		fprintf(stderr, "readTraceFile() : '%s' is not a trace file from this version of facility\n", filename);
+		fclose(fp);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+
+	const long size = ftell(fp) - (long)sizeof(TRACE_HEADER);
+
+	fseek(fp, sizeof(TRACE_HEADER), SEEK_SET);
+	*numRecords = (unsigned int)(size / sizeof(TRACE_RECORD));
+
+	TRACE_RECORD * records = (TRACE_RECORD *)malloc((*numRecords + 1) * sizeof(TRACE_RECORD));
+
+	if (fread(records, sizeof(TRACE_RECORD), *numRecords, fp) != *numRecords) {
+		fprintf(stderr, "readTraceFile() : Error reading '%s'\n", filename);
+		free(records);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+
+	return records;
+}
+
+int main(int argc, char * argv[]) {
+	unsigned int numRecords = 0;
+	unsigned int numEvents[teNumEventTypes];
+	HISTOGRAM_BUCKET buckets[numHistogramBuckets];
+	LAMBDA_COUNT_TABLE table = { NULL, 0, 0 }; /* By node */
+	LAMBDA_COUNT_TABLE nameTable = { NULL, 0, 0 }; /* By variable name */
+	unsigned int i;
+	int j;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s trace-file [number-of-lambdas]\n", argv[0]);
+		return 1;
+	}
+
+	const unsigned int numLambdasToShow = (argc > 2) ? (unsigned int)atoi(argv[2]) : 10;
+	TRACE_RECORD * records = readTraceFile(argv[1], &numRecords);
+
+	if (records == NULL) {
+		return 1;
+	}
+
+	memset(numEvents, 0, sizeof(numEvents));
+	memset(buckets, 0, sizeof(buckets));
+
+	/* Events from several threads may be interleaved out of order in the
+	file, so the histogram is over the step numbers, not the file order */
+	unsigned int firstStep = (numRecords > 0) ? records[0].step : 0;
+	unsigned int lastStep = firstStep;
+
+	for (i = 0; i < numRecords; ++i) {
+
+		if (records[i].step < firstStep) {
+			firstStep = records[i].step;
+		} else if (records[i].step > lastStep) {
+			lastStep = records[i].step;
+		}
+	}
+
+	const unsigned long stepsPerBucket = ((unsigned long)lastStep - firstStep) / numHistogramBuckets + 1;
+
+	for (i = 0; i < numRecords; ++i) {
+		TRACE_RECORD * record = &records[i];
+		HISTOGRAM_BUCKET * bucket = &buckets[(record->step - firstStep) / stepsPerBucket];
+
+		if (record->type >= teNumEventTypes) {
+			continue;
+		}
+
+		++numEvents[record->type];
+		++bucket->numEvents[record->type];
+
+		if (record->numLiveNodes > bucket->maxLiveNodes) {
+			bucket->maxLiveNodes = record->numLiveNodes;
+		}
+
+		if (record->type == teBeta) {
+			countBetaReduction(&table, record->redexId, record);
+			countBetaReduction(&nameTable, hashName(record->name), record);
+		}
+	}
+
+	printf("%u events:", numRecords);
+
+	for (j = 0; j < teNumEventTypes; ++j) {
+		printf(" %u %s", numEvents[j], eventTypeNames[j]);
+	}
+
+	printf("\n");
+
+	/* The hottest lambdas. Substitution copies lambdas, so each node is
+	usually applied only once or twice; the names tell more. */
+
+	if (table.size > 0) {
+		printHottestLambdas(&table, numLambdasToShow, "lambda nodes", TRUE);
+		printHottestLambdas(&nameTable, numLambdasToShow, "lambda variable names", FALSE);
+		free(table.entries);
+		free(nameTable.entries);
+	}
+
+	/* The histogram */
+
+	unsigned int maxBucketSize = 1;
+
+	for (j = 0; j < numHistogramBuckets; ++j) {
+		unsigned int bucketSize = 0;
+		int k;
+
+		for (k = 0; k < teNumEventTypes; ++k) {
+			bucketSize += buckets[j].numEvents[k];
+		}
+
+		if (bucketSize > maxBucketSize) {
+			maxBucketSize = bucketSize;
+		}
+	}
+
+	printf("\nEvents by step:\n");
+
+	for (j = 0; j < numHistogramBuckets && firstStep + j * stepsPerBucket <= lastStep; ++j) {
+		char bar[histogramBarWidth + 1];
+		unsigned int bucketSize = 0;
+		int k;
+
+		for (k = 0; k < teNumEventTypes; ++k) {
+			bucketSize += buckets[j].numEvents[k];
+		}
+
+		const int barLength = (int)((unsigned long)bucketSize * histogramBarWidth / maxBucketSize);
+
+		memset(bar, '#', barLength);
+		bar[barLength] = '\0';
+		printf("  %10lu %-*s %7u β %7u η %7u α %7u δ, max. %u live nodes\n",
+			firstStep + j * stepsPerBucket, histogramBarWidth, bar,
+			buckets[j].numEvents[teBeta], buckets[j].numEvents[teEta],
+			buckets[j].numEvents[teAlpha], buckets[j].numEvents[teDelta],
+			buckets[j].maxLiveNodes);
+	}
+
+	free(records);
+
+	return 0;
+}
+
+/* **** The End **** */
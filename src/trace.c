@@ -0,0 +1,139 @@
+/* facility/src/trace.c */
+
+/* The reduction trace recorder: each β-, η-, α- and δ-step is logged as a
+ * fixed-size TRACE_RECORD. With a file, records are collected in a buffer
+ * and written out in big chunks; without one, the buffer is a ring that
+ * holds the latest records, for post-mortems.
+ *
+ * Tracing is enabled by setting ctx->trace; child contexts share it, so a
+ * recorder has a mutex. When ctx->trace is NULL, each step costs only the
+ * test of the pointer. Node IDs are derived from node addresses: they are
+ * unique among the nodes alive at the same time, but may be reused. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "boolean.h"
+
+#include "types.h"
+#include "memory-manager.h"
+#include "context.h"
+
+#include "trace.h"
+
+struct TRACE_RECORDER_STRUCT {
+	TRACE_RECORD * records;
+	int capacity;
+	int size;
+	int start; /* The index of the oldest record, once a ring has wrapped */
+	unsigned int numEvents;
+	FILE * fp; /* May be NULL */
+	MEMMGR_COUNTS * counts; /* May be NULL */
+	pthread_mutex_t mutex;
+};
+
+TRACE_RECORDER * createTraceRecorder(int capacity, FILE * fp, MEMMGR_COUNTS * counts) {
+	/* If fp is not NULL, the trace header is written to it now. The
+	recorder's allocations are added to counts, which may be NULL. */
+	TRACE_RECORDER * recorder = (TRACE_RECORDER *)countedRealloc(counts, NULL, sizeof(TRACE_RECORDER));
+
+	recorder->records = (TRACE_RECORD *)countedRealloc(counts, NULL, capacity * sizeof(TRACE_RECORD));
+	recorder->capacity = capacity;
+	recorder->size = 0;
+	recorder->start = 0;
+	recorder->numEvents = 0;
+	recorder->fp = fp;
+	recorder->counts = counts;
+	pthread_mutex_init(&recorder->mutex, NULL);
+
+	if (fp != NULL) {
+		TRACE_HEADER header;
+
+		memset(&header, 0, sizeof(TRACE_HEADER));
+		memcpy(header.magic, traceFileMagic, sizeof(header.magic));
+		header.recordSize = sizeof(TRACE_RECORD);
+		fwrite(&header, sizeof(TRACE_HEADER), 1, fp);
+	}
+
+	return recorder;
+}
+
+void flushTraceRecorder(TRACE_RECORDER * recorder) {
+	/* Only for a recorder with a file */
+
+	if (recorder->fp != NULL && recorder->size > 0) {
+		fwrite(recorder->records, sizeof(TRACE_RECORD), recorder->size, recorder->fp);
+		recorder->size = 0;
+	}
+}
+
+void freeTraceRecorder(TRACE_RECORDER * recorder) {
+	/* Does not close the file */
+	flushTraceRecorder(recorder);
+	pthread_mutex_destroy(&recorder->mutex);
+	countedFree(recorder->counts, recorder->records);
+	countedFree(recorder->counts, recorder);
+}
+
+void writeTraceRecords(TRACE_RECORDER * recorder, FILE * fp) {
+	/* Write the contents of a ring, oldest first, as a trace file */
+	TRACE_HEADER header;
+	int i;
+
+	memset(&header, 0, sizeof(TRACE_HEADER));
+	memcpy(header.magic, traceFileMagic, sizeof(header.magic));
+	header.recordSize = sizeof(TRACE_RECORD);
+	fwrite(&header, sizeof(TRACE_HEADER), 1, fp);
+
+	for (i = 0; i < recorder->size; ++i) {
+		fwrite(&recorder->records[(recorder->start + i) % recorder->capacity], sizeof(TRACE_RECORD), 1, fp);
+	}
+}
+
+unsigned int getNumTraceEvents(TRACE_RECORDER * recorder) {
+	return recorder->numEvents;
+}
+
+static unsigned int getNodeId(LC_EXPR * expr) {
+	/* Nodes are at least 16-byte aligned */
+	return (expr == NULL) ? 0 : (unsigned int)((unsigned long)expr >> 4);
+}
+
+void recordTraceEvent(LC_CONTEXT * ctx, TraceEventType type, LC_EXPR * redex, LC_EXPR * arg) {
+	/* The caller has checked that ctx->trace is not NULL */
+	TRACE_RECORDER * recorder = ctx->trace;
+	TRACE_RECORD record;
+
+	memset(&record, 0, sizeof(TRACE_RECORD));
+	record.type = (unsigned char)type;
+	record.strategy = (unsigned char)ctx->traceStrategy;
+	record.workerIndex = (unsigned short)ctx->workerIndex;
+	record.redexId = getNodeId(redex);
+	record.argId = getNodeId(arg);
+	record.numLiveNodes = (unsigned int)(ctx->createAndDestroyCounts.numMallocs - ctx->createAndDestroyCounts.numFrees);
+
+	if (redex->type == lcExpressionType_LambdaExpr) {
+		memcpy(record.name, redex->name, maxStringValueLength);
+	}
+
+	pthread_mutex_lock(&recorder->mutex);
+	record.step = recorder->numEvents++;
+
+	if (recorder->size < recorder->capacity) {
+		recorder->records[recorder->size++] = record;
+	} else {
+		/* A full ring: overwrite the oldest record */
+		recorder->records[recorder->start] = record;
+		recorder->start = (recorder->start + 1) % recorder->capacity;
+	}
+
+	if (recorder->fp != NULL && recorder->size == recorder->capacity) {
+		flushTraceRecorder(recorder);
+	}
+
+	pthread_mutex_unlock(&recorder->mutex);
+}
+
+/* **** The End **** */
@@ -0,0 +1,44 @@
+/* facility/src/trace.h */
+
+/* The reduction trace recorder; see trace.c. A trace file is a TRACE_HEADER
+ * followed by TRACE_RECORDs, in the byte order of the machine that wrote it;
+ * see tools/trace-summary.c */
+
+/* const char * traceFileMagic = "LCTRACE1"; */
+#define traceFileMagic "LCTRACE1"
+
+typedef enum {
+	teBeta, /* A lambda applied to an argument */
+	teEta, /* λx.(f x) reduced to f */
+	teAlpha, /* A bound variable renamed to avoid capture */
+	teDelta, /* A primitive operator applied; see delta-reduction.c */
+	teNumEventTypes
+} TraceEventType;
+
+typedef struct {
+	char magic[8]; /* traceFileMagic, without the terminating null */
+	unsigned int recordSize; /* sizeof(TRACE_RECORD) */
+	unsigned int reserved;
+} TRACE_HEADER;
+
+typedef struct {
+	unsigned int step; /* The number of events recorded before this one */
+	unsigned char type; /* A TraceEventType */
+	unsigned char strategy; /* A BetaReductionStrategy */
+	unsigned short workerIndex; /* 0xFFFF for a thread outside the pool */
+	unsigned int redexId; /* The lambda (or the call, for η and δ) */
+	unsigned int argId; /* The argument of a β-redex; otherwise 0 */
+	unsigned int numLiveNodes; /* In the heap of the recording context */
+	char name[maxStringValueLength]; /* The lambda's variable, if any */
+} TRACE_RECORD; /* 32 bytes */
+
+typedef struct TRACE_RECORDER_STRUCT TRACE_RECORDER;
+
+TRACE_RECORDER * createTraceRecorder(int capacity, FILE * fp, MEMMGR_COUNTS * counts);
+void freeTraceRecorder(TRACE_RECORDER * recorder);
+void flushTraceRecorder(TRACE_RECORDER * recorder);
+void writeTraceRecords(TRACE_RECORDER * recorder, FILE * fp);
+unsigned int getNumTraceEvents(TRACE_RECORDER * recorder);
+void recordTraceEvent(LC_CONTEXT * ctx, TraceEventType type, LC_EXPR * redex, LC_EXPR * arg);
+
+/* **** The End **** */
@@ -7,12 +7,16 @@
 
 /* Forward declarations of some structs */
 
+typedef struct LC_CONTEXT_STRUCT LC_CONTEXT; /* See context.h */
+
 typedef struct LC_EXPR_STRUCT {
-	int mark; /* For use by a mark-and-sweep garbage collector */
+	unsigned char mark; /* For use by a mark-and-sweep garbage collector */
+	unsigned char closedness; /* An lcClosedness value, computed when first needed */
 	int type;
 	char name[maxStringValueLength]; /* Used for Variable and LambdaExpr */
-	struct LC_EXPR_STRUCT * expr; /* Used for LambdaExpr and FunctionCall */
-	struct LC_EXPR_STRUCT * expr2; /* Used for FunctionCall */
+	struct LC_EXPR_STRUCT * expr; /* Used for LambdaExpr, FunctionCall and Iteration */
+	struct LC_EXPR_STRUCT * expr2; /* Used for FunctionCall and Iteration */
+	long value; /* Used for IntegerLiteral and Iteration */
 } LC_EXPR; /* A Lambda calculus expression */
 
 /* Enums */
@@ -20,7 +24,15 @@ typedef struct LC_EXPR_STRUCT {
 enum {
 	lcExpressionType_Variable,
 	lcExpressionType_LambdaExpr,
-	lcExpressionType_FunctionCall
+	lcExpressionType_FunctionCall,
+	lcExpressionType_IntegerLiteral, /* Only when δ-reduction is enabled */
+	lcExpressionType_Iteration /* (f (f ... (f x))): expr applied value times to expr2; see createIteration() */
+};
+
+enum {
+	lcClosedness_Unknown, /* Not yet computed; see isClosedExpr() */
+	lcClosedness_Closed, /* No free variables */
+	lcClosedness_Open
 };
 
 /* **** The End **** */